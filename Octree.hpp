@@ -23,12 +23,39 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <atomic> // query statistics.
 #include <cassert>
+#include <chrono> // autoTune.
 #include <cmath>
+#include <cstddef> // offsetof.
+#include <cstdio> // remove.
 #include <cstring> // memset.
+#include <fstream>
 #include <limits>
+#include <memory> // SharedOctree.
+#include <mutex>
+#include <string>
+#include <utility>
 #include <vector>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 // needed for gtest access to protected/private members ...
 namespace
 {
@@ -84,6 +111,567 @@ inline float get(const PointT& p)
 	return traits::access<PointT, D>::get(p);
 }
 
+/** \brief point with the coordinates read from StridedPoints, which is also the type of the queries. **/
+struct StridedPoint
+{
+public:
+	StridedPoint(float x = 0.0f, float y = 0.0f, float z = 0.0f)
+	    : x(x)
+	    , y(y)
+	    , z(z)
+	{
+	}
+	float x, y, z;
+};
+
+/** \brief view of points in a foreign buffer without copying them, e.g., PCL point clouds, PointCloud2 messages or
+ * plain float arrays.
+ *
+ * The i-th point starts at data + i * stride bytes and its coordinates are floats at the given byte offsets, which
+ * need not be aligned. The view is used as container of StridedPoint, i.e., Octree<StridedPoint, StridedPoints>, and
+ * every access reads the three coordinates. The buffer must stay valid as long as the octree is used, since
+ * OctreeParams::copyPoints only copies the view. OctreeParams::reorderPoints copies the coordinates once into the
+ * octree for the vectorized leaf scans.
+ */
+class StridedPoints
+{
+public:
+	typedef StridedPoint value_type;
+
+	StridedPoints(const void* data = 0,
+	              uint32_t size = 0,
+	              uint32_t stride = 3 * sizeof(float),
+	              uint32_t xOffset = 0,
+	              uint32_t yOffset = sizeof(float),
+	              uint32_t zOffset = 2 * sizeof(float))
+	    : data_(static_cast<const char*>(data))
+	    , size_(size)
+	    , stride_(stride)
+	{
+		offsets_[0] = xOffset;
+		offsets_[1] = yOffset;
+		offsets_[2] = zOffset;
+	}
+
+	uint32_t size() const
+	{
+		return size_;
+	}
+
+	StridedPoint operator[](uint32_t i) const
+	{
+		const char* p = data_ + uint64_t(i) * stride_;
+		StridedPoint point;
+		std::memcpy(&point.x, p + offsets_[0], sizeof(float));
+		std::memcpy(&point.y, p + offsets_[1], sizeof(float));
+		std::memcpy(&point.z, p + offsets_[2], sizeof(float));
+		return point;
+	}
+
+protected:
+	const char* data_;
+	uint32_t size_;
+	uint32_t stride_; // bytes between consecutive points.
+	uint32_t offsets_[3]; // byte offsets of x, y and z inside a point.
+};
+
+/** \brief distance policies of the neighbor queries, which are template arguments of the queries.
+ *
+ * compute(p, q) and norm(x, y, z) determine the distance of two points and the norm of a difference vector, which are
+ * compared against sqr(radius); sqrt is the inverse of sqr. Hence, the L2Distance reports squared distances. A
+ * user-supplied policy needs the same static methods and the octants are pruned correctly for all p-norms.
+ */
+template <typename PointT>
+struct L1Distance
+{
+	static inline float compute(const PointT& p, const PointT& q)
+	{
+		return norm(get<0>(p) - get<0>(q), get<1>(p) - get<1>(q), get<2>(p) - get<2>(q));
+	}
+
+	static inline float norm(float x, float y, float z)
+	{
+		return std::abs(x) + std::abs(y) + std::abs(z);
+	}
+
+	static inline float sqr(float r)
+	{
+		return r;
+	}
+
+	static inline float sqrt(float r)
+	{
+		return r;
+	}
+};
+
+template <typename PointT>
+struct L2Distance
+{
+	static inline float compute(const PointT& p, const PointT& q)
+	{
+		return norm(get<0>(p) - get<0>(q), get<1>(p) - get<1>(q), get<2>(p) - get<2>(q));
+	}
+
+	static inline float norm(float x, float y, float z)
+	{
+		return x * x + y * y + z * z;
+	}
+
+	static inline float sqr(float r)
+	{
+		return r * r;
+	}
+
+	static inline float sqrt(float r)
+	{
+		return std::sqrt(r);
+	}
+};
+
+template <typename PointT>
+struct MaxDistance
+{
+	static inline float compute(const PointT& p, const PointT& q)
+	{
+		return norm(get<0>(p) - get<0>(q), get<1>(p) - get<1>(q), get<2>(p) - get<2>(q));
+	}
+
+	static inline float norm(float x, float y, float z)
+	{
+		return std::max(std::abs(x), std::max(std::abs(y), std::abs(z)));
+	}
+
+	static inline float sqr(float r)
+	{
+		return r;
+	}
+
+	static inline float sqrt(float r)
+	{
+		return r;
+	}
+};
+
+/** \brief vectorized kernels for scanning the reordered points of an octant, which are selected at compile time.
+ *
+ * Depending on the available instruction set, the kernels test 16 (AVX-512), 8 (AVX2) or 4 (NEON) points at once.
+ * Without any of them, the kernels fall back to a plain loop.
+ */
+namespace simd
+{
+/** @return number of set bits. **/
+inline uint32_t bitCount(uint32_t v)
+{
+	v = v - ((v >> 1) & 0x55555555);
+	v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+	return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+/** \brief report all points (xs[i], ys[i], zs[i]) with squared distance to (qx, qy, qz) smaller than sqrRadius.
+ *
+ * For each point inside the search ball, indexes[i] is written to resultIndices and the squared distance to
+ * distances, if distances is not null. Both arrays must provide space for size elements.
+ *
+ * @return number of reported points.
+ */
+inline uint32_t radiusScan(const float* xs,
+                           const float* ys,
+                           const float* zs,
+                           const uint32_t* indexes,
+                           uint32_t size,
+                           float qx,
+                           float qy,
+                           float qz,
+                           float sqrRadius,
+                           uint32_t* resultIndices,
+                           float* distances)
+{
+	uint32_t i = 0, n = 0;
+#if defined(__AVX512F__)
+	const __m512 vqx = _mm512_set1_ps(qx), vqy = _mm512_set1_ps(qy), vqz = _mm512_set1_ps(qz);
+	const __m512 vsqrRadius = _mm512_set1_ps(sqrRadius);
+	for (; i < size; i += 16)
+	{
+		// masked loads also handle the remaining points.
+		const __mmask16 valid = (size - i >= 16) ? __mmask16(0xFFFF) : __mmask16((1u << (size - i)) - 1);
+		__m512 x = _mm512_sub_ps(vqx, _mm512_maskz_loadu_ps(valid, xs + i));
+		__m512 y = _mm512_sub_ps(vqy, _mm512_maskz_loadu_ps(valid, ys + i));
+		__m512 z = _mm512_sub_ps(vqz, _mm512_maskz_loadu_ps(valid, zs + i));
+		__m512 dist = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, x), _mm512_mul_ps(y, y)), _mm512_mul_ps(z, z));
+		__mmask16 inside = _mm512_mask_cmp_ps_mask(valid, dist, vsqrRadius, _CMP_LT_OQ);
+
+		_mm512_mask_compressstoreu_epi32(resultIndices + n, inside, _mm512_maskz_loadu_epi32(valid, indexes + i));
+		if (distances != 0)
+			_mm512_mask_compressstoreu_ps(distances + n, inside, dist);
+		n += bitCount(inside);
+	}
+#elif defined(__AVX2__)
+	const __m256 vqx = _mm256_set1_ps(qx), vqy = _mm256_set1_ps(qy), vqz = _mm256_set1_ps(qz);
+	const __m256 vsqrRadius = _mm256_set1_ps(sqrRadius);
+	float dist[8];
+	for (; i + 8 <= size; i += 8)
+	{
+		__m256 x = _mm256_sub_ps(vqx, _mm256_loadu_ps(xs + i));
+		__m256 y = _mm256_sub_ps(vqy, _mm256_loadu_ps(ys + i));
+		__m256 z = _mm256_sub_ps(vqz, _mm256_loadu_ps(zs + i));
+		__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+		uint32_t inside = _mm256_movemask_ps(_mm256_cmp_ps(d, vsqrRadius, _CMP_LT_OQ));
+		if (inside == 0)
+			continue;
+
+		// branchless compaction: always write, but only advance for points inside the ball.
+		_mm256_storeu_ps(dist, d);
+		for (uint32_t j = 0; j < 8; ++j)
+		{
+			resultIndices[n] = indexes[i + j];
+			if (distances != 0)
+				distances[n] = dist[j];
+			n += (inside >> j) & 1;
+		}
+	}
+#elif defined(__ARM_NEON)
+	const float32x4_t vqx = vdupq_n_f32(qx), vqy = vdupq_n_f32(qy), vqz = vdupq_n_f32(qz);
+	const float32x4_t vsqrRadius = vdupq_n_f32(sqrRadius);
+	float dist[4];
+	uint32_t inside[4];
+	for (; i + 4 <= size; i += 4)
+	{
+		float32x4_t x = vsubq_f32(vqx, vld1q_f32(xs + i));
+		float32x4_t y = vsubq_f32(vqy, vld1q_f32(ys + i));
+		float32x4_t z = vsubq_f32(vqz, vld1q_f32(zs + i));
+		float32x4_t d = vaddq_f32(vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y)), vmulq_f32(z, z));
+		vst1q_u32(inside, vcltq_f32(d, vsqrRadius));
+		vst1q_f32(dist, d);
+
+		for (uint32_t j = 0; j < 4; ++j)
+		{
+			resultIndices[n] = indexes[i + j];
+			if (distances != 0)
+				distances[n] = dist[j];
+			n += inside[j] & 1;
+		}
+	}
+#endif
+	for (; i < size; ++i)
+	{
+		float x = qx - xs[i], y = qy - ys[i], z = qz - zs[i];
+		float dist = x * x + y * y + z * z;
+		if (dist < sqrRadius)
+		{
+			resultIndices[n] = indexes[i];
+			if (distances != 0)
+				distances[n] = dist;
+			n += 1;
+		}
+	}
+
+	return n;
+}
+
+/** \brief determine the nearest point (xs[i], ys[i], zs[i]) to (qx, qy, qz) with sqrMinDistance < distance < sqrMaxDistance.
+ *
+ * If such a point exists, sqrMaxDistance is set to its squared distance. If several points have the same distance,
+ * the first one is reported.
+ *
+ * @return position of the nearest point, or size if no point was found.
+ */
+inline uint32_t nearestScan(const float* xs,
+                            const float* ys,
+                            const float* zs,
+                            uint32_t size,
+                            float qx,
+                            float qy,
+                            float qz,
+                            float sqrMinDistance,
+                            float& sqrMaxDistance)
+{
+	uint32_t i = 0, best = size;
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__ARM_NEON)
+	// every lane keeps its own nearest point, that are merged afterwards.
+#if defined(__AVX512F__)
+	const uint32_t W = 16;
+	float laneDist[W];
+	int32_t lanePos[W];
+	const __m512 vqx = _mm512_set1_ps(qx), vqy = _mm512_set1_ps(qy), vqz = _mm512_set1_ps(qz);
+	const __m512 vsqrMinDistance = _mm512_set1_ps(sqrMinDistance);
+	__m512 vbest = _mm512_set1_ps(sqrMaxDistance);
+	__m512i vpos = _mm512_set1_epi32(-1);
+	__m512i vcur = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	const __m512i vstep = _mm512_set1_epi32(16);
+	for (; i + W <= size; i += W)
+	{
+		__m512 x = _mm512_sub_ps(vqx, _mm512_loadu_ps(xs + i));
+		__m512 y = _mm512_sub_ps(vqy, _mm512_loadu_ps(ys + i));
+		__m512 z = _mm512_sub_ps(vqz, _mm512_loadu_ps(zs + i));
+		__m512 d = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, x), _mm512_mul_ps(y, y)), _mm512_mul_ps(z, z));
+		__mmask16 better = _mm512_cmp_ps_mask(d, vsqrMinDistance, _CMP_GT_OQ) & _mm512_cmp_ps_mask(d, vbest, _CMP_LT_OQ);
+		vbest = _mm512_mask_blend_ps(better, vbest, d);
+		vpos = _mm512_mask_blend_epi32(better, vpos, vcur);
+		vcur = _mm512_add_epi32(vcur, vstep);
+	}
+	_mm512_storeu_ps(laneDist, vbest);
+	_mm512_storeu_si512(lanePos, vpos);
+#elif defined(__AVX2__)
+	const uint32_t W = 8;
+	float laneDist[W];
+	int32_t lanePos[W];
+	const __m256 vqx = _mm256_set1_ps(qx), vqy = _mm256_set1_ps(qy), vqz = _mm256_set1_ps(qz);
+	const __m256 vsqrMinDistance = _mm256_set1_ps(sqrMinDistance);
+	__m256 vbest = _mm256_set1_ps(sqrMaxDistance);
+	__m256i vpos = _mm256_set1_epi32(-1);
+	__m256i vcur = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256i vstep = _mm256_set1_epi32(8);
+	for (; i + W <= size; i += W)
+	{
+		__m256 x = _mm256_sub_ps(vqx, _mm256_loadu_ps(xs + i));
+		__m256 y = _mm256_sub_ps(vqy, _mm256_loadu_ps(ys + i));
+		__m256 z = _mm256_sub_ps(vqz, _mm256_loadu_ps(zs + i));
+		__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+		__m256 better = _mm256_and_ps(_mm256_cmp_ps(d, vsqrMinDistance, _CMP_GT_OQ), _mm256_cmp_ps(d, vbest, _CMP_LT_OQ));
+		vbest = _mm256_blendv_ps(vbest, d, better);
+		vpos = _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(vpos), _mm256_castsi256_ps(vcur), better));
+		vcur = _mm256_add_epi32(vcur, vstep);
+	}
+	_mm256_storeu_ps(laneDist, vbest);
+	_mm256_storeu_si256(reinterpret_cast<__m256i*>(lanePos), vpos);
+#else
+	const uint32_t W = 4;
+	float laneDist[W];
+	int32_t lanePos[W];
+	const float32x4_t vqx = vdupq_n_f32(qx), vqy = vdupq_n_f32(qy), vqz = vdupq_n_f32(qz);
+	const float32x4_t vsqrMinDistance = vdupq_n_f32(sqrMinDistance);
+	float32x4_t vbest = vdupq_n_f32(sqrMaxDistance);
+	int32x4_t vpos = vdupq_n_s32(-1);
+	const int32_t initialPos[4] = { 0, 1, 2, 3 };
+	int32x4_t vcur = vld1q_s32(initialPos);
+	const int32x4_t vstep = vdupq_n_s32(4);
+	for (; i + W <= size; i += W)
+	{
+		float32x4_t x = vsubq_f32(vqx, vld1q_f32(xs + i));
+		float32x4_t y = vsubq_f32(vqy, vld1q_f32(ys + i));
+		float32x4_t z = vsubq_f32(vqz, vld1q_f32(zs + i));
+		float32x4_t d = vaddq_f32(vaddq_f32(vmulq_f32(x, x), vmulq_f32(y, y)), vmulq_f32(z, z));
+		uint32x4_t better = vandq_u32(vcgtq_f32(d, vsqrMinDistance), vcltq_f32(d, vbest));
+		vbest = vbslq_f32(better, d, vbest);
+		vpos = vbslq_s32(better, vcur, vpos);
+		vcur = vaddq_s32(vcur, vstep);
+	}
+	vst1q_f32(laneDist, vbest);
+	vst1q_s32(lanePos, vpos);
+#endif
+	for (uint32_t j = 0; j < W; ++j)
+	{
+		if (lanePos[j] < 0)
+			continue;
+		if (laneDist[j] < sqrMaxDistance || (laneDist[j] == sqrMaxDistance && uint32_t(lanePos[j]) < best))
+		{
+			sqrMaxDistance = laneDist[j];
+			best = lanePos[j];
+		}
+	}
+#endif
+	for (; i < size; ++i)
+	{
+		float x = qx - xs[i], y = qy - ys[i], z = qz - zs[i];
+		float dist = x * x + y * y + z * z;
+		if (dist > sqrMinDistance && dist < sqrMaxDistance)
+		{
+			sqrMaxDistance = dist;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+/** \brief scans of the reordered points with the given distance policy like radiusScan and nearestScan.
+ *
+ * The scans are resolved at compile time, i.e., the L2Distance uses the vectorized kernels and all other distance
+ * policies a plain loop.
+ */
+template <typename Distance>
+struct Scan
+{
+	static inline uint32_t radius(const float* xs,
+	                              const float* ys,
+	                              const float* zs,
+	                              const uint32_t* indexes,
+	                              uint32_t size,
+	                              float qx,
+	                              float qy,
+	                              float qz,
+	                              float sqrRadius,
+	                              uint32_t* resultIndices,
+	                              float* distances)
+	{
+		uint32_t n = 0;
+		for (uint32_t i = 0; i < size; ++i)
+		{
+			float dist = Distance::norm(qx - xs[i], qy - ys[i], qz - zs[i]);
+			if (dist < sqrRadius)
+			{
+				resultIndices[n] = indexes[i];
+				if (distances != 0)
+					distances[n] = dist;
+				n += 1;
+			}
+		}
+
+		return n;
+	}
+
+	static inline uint32_t nearest(const float* xs,
+	                               const float* ys,
+	                               const float* zs,
+	                               uint32_t size,
+	                               float qx,
+	                               float qy,
+	                               float qz,
+	                               float sqrMinDistance,
+	                               float& sqrMaxDistance)
+	{
+		uint32_t best = size;
+		for (uint32_t i = 0; i < size; ++i)
+		{
+			float dist = Distance::norm(qx - xs[i], qy - ys[i], qz - zs[i]);
+			if (dist > sqrMinDistance && dist < sqrMaxDistance)
+			{
+				sqrMaxDistance = dist;
+				best = i;
+			}
+		}
+
+		return best;
+	}
+};
+
+template <typename PointT>
+struct Scan<L2Distance<PointT> >
+{
+	static inline uint32_t radius(const float* xs,
+	                              const float* ys,
+	                              const float* zs,
+	                              const uint32_t* indexes,
+	                              uint32_t size,
+	                              float qx,
+	                              float qy,
+	                              float qz,
+	                              float sqrRadius,
+	                              uint32_t* resultIndices,
+	                              float* distances)
+	{
+		return radiusScan(xs, ys, zs, indexes, size, qx, qy, qz, sqrRadius, resultIndices, distances);
+	}
+
+	static inline uint32_t nearest(const float* xs,
+	                               const float* ys,
+	                               const float* zs,
+	                               uint32_t size,
+	                               float qx,
+	                               float qy,
+	                               float qz,
+	                               float sqrMinDistance,
+	                               float& sqrMaxDistance)
+	{
+		return nearestScan(xs, ys, zs, size, qx, qy, qz, sqrMinDistance, sqrMaxDistance);
+	}
+};
+} // namespace simd
+
+/** @return maximal number of threads used by parallel queries, i.e., 1 without OpenMP. **/
+inline int32_t maxThreads()
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+/** @return index of the calling thread inside a parallel region. **/
+inline int32_t threadIndex()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+/** @return the lower 21 bits of v spread such that two zero bits are between consecutive bits. **/
+inline uint64_t spreadBits(uint64_t v)
+{
+	v = (v | v << 32) & 0x1F00000000FFFFull;
+	v = (v | v << 16) & 0x1F0000FF0000FFull;
+	v = (v | v << 8) & 0x100F00F00F00F00Full;
+	v = (v | v << 4) & 0x10C30C30C30C30C3ull;
+	v = (v | v << 2) & 0x1249249249249249ull;
+	return v;
+}
+
+/** \brief stable LSD radix sort of keys smaller than 2^bits with 11 bits per pass, which permutes values accordingly.
+ *
+ * With parallel, each pass is distributed over all OpenMP threads, which histogram and scatter consecutive chunks.
+ * Passes over digits shared by all keys are skipped.
+ */
+inline void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, uint32_t bits, bool parallel)
+{
+	const uint32_t N = keys.size();
+	const int32_t numThreads = parallel ? maxThreads() : 1;
+	const uint32_t chunkSize = (N + numThreads - 1) / numThreads;
+	std::vector<uint64_t> tmpKeys(N);
+	std::vector<uint32_t> tmpValues(N);
+	const uint32_t radix = 1 << 11;
+	std::vector<uint32_t> histograms(radix * numThreads);
+
+	for (uint32_t shift = 0; shift < bits; shift += 11)
+	{
+		std::fill(histograms.begin(), histograms.end(), 0);
+#pragma omp parallel for schedule(static, 1) num_threads(numThreads)
+		for (int32_t t = 0; t < numThreads; ++t)
+		{
+			uint32_t* histogram = &histograms[radix * t];
+			const uint32_t last = std::min(N, (t + 1) * chunkSize);
+			for (uint32_t i = t * chunkSize; i < last; ++i)
+				histogram[(keys[i] >> shift) & (radix - 1)] += 1;
+		}
+
+		// offsets of the chunks ordered by digit and thread.
+		uint32_t offset = 0;
+		bool skip = false;
+		for (uint32_t d = 0; d < radix; ++d)
+		{
+			const uint32_t first = offset;
+			for (int32_t t = 0; t < numThreads; ++t)
+			{
+				const uint32_t count = histograms[radix * t + d];
+				histograms[radix * t + d] = offset;
+				offset += count;
+			}
+			if (offset - first == N)
+				skip = true;
+		}
+		if (skip)
+			continue;
+
+#pragma omp parallel for schedule(static, 1) num_threads(numThreads)
+		for (int32_t t = 0; t < numThreads; ++t)
+		{
+			uint32_t* histogram = &histograms[radix * t];
+			const uint32_t last = std::min(N, (t + 1) * chunkSize);
+			for (uint32_t i = t * chunkSize; i < last; ++i)
+			{
+				const uint32_t pos = histogram[(keys[i] >> shift) & (radix - 1)]++;
+				tmpKeys[pos] = keys[i];
+				tmpValues[pos] = values[i];
+			}
+		}
+		keys.swap(tmpKeys);
+		values.swap(tmpValues);
+	}
+}
+
 struct OctreeParams
 {
 public:
@@ -91,13 +679,153 @@ public:
 	    : bucketSize(bucketSize)
 	    , copyPoints(copyPoints)
 	    , minExtent(minExtent)
+	    , parallelBuild(false)
+	    , parallelThreshold(65536)
+	    , reorderPoints(false)
+	    , mortonBuild(false)
+	    , levelOfDetail(false)
+	    , quantizePoints(false)
 	{
 	}
 	uint32_t bucketSize;
 	bool copyPoints;
 	float minExtent;
+	bool parallelBuild; // build subtrees with OpenMP tasks; the resulting octree is identical to the serial one.
+	uint32_t parallelThreshold; // minimal number of points in an octant to build its subtree in a separate task.
+	bool reorderPoints; // keep an internal copy of the coordinates in successor order for linear scans of octants.
+	bool mortonBuild; // build by radix sorting Morton keys instead of relinking per level; pays off for large clouds.
+	bool levelOfDetail; // keep the centroid of each octant for Octree::levelOfDetail.
+	// keep the leaf-sorted coordinates as 16-bit offsets to the leaf centers instead of the float copy of reorderPoints,
+	// i.e., 6 instead of 12 bytes per point. Only radius queries scan them and check the points near the search sphere
+	// exactly; all other queries use the original points like without reorderPoints.
+	bool quantizePoints;
+
+	/** \brief parameters with bucketSize and minExtent chosen by the traversal cost of radius queries of (a subset of
+   * at most 1024) sampleQueries on octrees of the points, where all other parameters are taken from base.
+   *
+   * The cost weights the visited octants, overlap tests and tested points of QueryStats, which are determined by
+   * Octree::radiusQueryCost without UNIBN_OCTREE_STATS; thus, the same input always gives the same parameters. With
+   * timeTies, the candidates within 5% of the lowest cost are compared by the time of their queries instead.
+   *
+   * First the bucket size is selected with minExtent = 0 and afterwards a minimal extent of a fraction of the radius
+   * is tried, which stops the subdivision in dense regions. Thus, leafs in dense regions can contain more than
+   * bucketSize points, while leafs in sparse regions still contain at most bucketSize points. The points are given
+   * as a container of octree points, i.e., Octree<ContainerT::value_type, ContainerT>.
+   *
+   * The points are not sampled, since the bucket size depends on their density; thus, an octree of all points is built
+   * for each of the ten candidates (and again for the timed ones), i.e., tuning costs about ten initializations.
+   **/
+	template <typename ContainerT>
+	static OctreeParams autoTune(const ContainerT& points,
+	                             const ContainerT& sampleQueries,
+	                             float radius,
+	                             const OctreeParams& base = OctreeParams(),
+	                             bool timeTies = false);
+};
+
+/** \brief relaxation and budget of approximate nearest neighbor queries, see Octree::findNeighbor. **/
+struct ApproximateParams
+{
+public:
+	ApproximateParams(float epsilon = 0.0f,
+	                  uint32_t maxLeafs = std::numeric_limits<uint32_t>::max(),
+	                  uint32_t maxPoints = std::numeric_limits<uint32_t>::max())
+	    : epsilon(epsilon)
+	    , maxLeafs(maxLeafs)
+	    , maxPoints(maxPoints)
+	{
+	}
+	float epsilon; // reported neighbors are at most (1 + epsilon) times farther away than the exact neighbors.
+	uint32_t maxLeafs; // maximal number of scanned leafs.
+	uint32_t maxPoints; // maximal number of scanned points; a leaf is only scanned if all its points fit the budget.
 };
 
+/** \brief aggregated points inside an octant, see Octree::aggregate. **/
+struct OctantAggregate
+{
+	float x, y, z; // centroid of the points.
+	uint32_t size; // number of points.
+	uint32_t first; // index of the first point in the successor list.
+	uint32_t nearest; // index of the point nearest to the centroid.
+};
+
+/** \brief single point or representative of the points of an octant, see Octree::levelOfDetail. **/
+struct LodSample
+{
+	float x, y, z; // coordinates of the point or centroid of the points.
+	uint32_t size; // number of represented points.
+	uint32_t index; // index of the point or of the first point of the octant in the successor list.
+};
+
+/** \brief half-space of all points p with nx * p.x + ny * p.y + nz * p.z <= d, see Octree::convexSearch. **/
+struct Halfspace
+{
+	float nx, ny, nz;
+	float d;
+};
+
+// query statistics are only collected if UNIBN_OCTREE_STATS is defined before including Octree.hpp; otherwise the
+// counting is removed by the compiler.
+#ifdef UNIBN_OCTREE_STATS
+static const bool collectQueryStats = true;
+#else
+static const bool collectQueryStats = false;
+#endif
+
+/** \brief traversal counters of radius and nearest neighbor queries, see Octree::queryStats. **/
+struct QueryStats
+{
+public:
+	QueryStats()
+	    : queries(0)
+	    , octantsVisited(0)
+	    , overlapTests(0)
+	    , containedOctants(0)
+	    , pointsTested(0)
+	    , results(0)
+	{
+	}
+
+	QueryStats& operator+=(const QueryStats& other)
+	{
+		queries += other.queries;
+		octantsVisited += other.octantsVisited;
+		overlapTests += other.overlapTests;
+		containedOctants += other.containedOctants;
+		pointsTested += other.pointsTested;
+		results += other.results;
+		return *this;
+	}
+
+	uint64_t queries; // number of queries.
+	uint64_t octantsVisited; // octants entered by the traversal.
+	uint64_t overlapTests; // tests of search balls against octants.
+	uint64_t containedOctants; // octants completely inside the search ball, whose points are reported without tests.
+	uint64_t pointsTested; // points of leafs, whose distance to the query was determined.
+	uint64_t results; // reported neighbors.
+};
+
+/** \brief shape of an octree for tuning the OctreeParams, see Octree::shape. **/
+struct OctreeShape
+{
+	std::vector<uint32_t> octantsPerDepth; // number of octants at each depth, where the root has depth 0.
+	std::vector<uint32_t> leafsPerDepth; // number of leafs at each depth.
+	// number of leafs by occupancy relative to bucketSize: bin i < 8 counts leafs with i/8 < size/bucketSize <= (i+1)/8
+	// and bin 8 counts leafs with more than bucketSize points, which could not be split due to minExtent.
+	std::vector<uint32_t> leafOccupancy;
+	uint32_t numLeafs;
+	uint32_t maxLeafSize;
+	float meanLeafSize;
+	uint64_t bytes; // heap memory of octants, successors, (quantized) coordinates and indexes.
+	uint64_t mappedBytes; // size of the mapped file of Octree::openMapped.
+};
+
+template <typename PointT, typename ContainerT>
+class OctreePartition;
+
+template <typename PointT, typename ContainerT>
+class OctreeBuilder;
+
 /** \brief Index-based Octree implementation offering different queries and insertion/removal of points.
  *
  * The index-based Octree uses a successor relation and a startIndex in each Octant to improve runtime
@@ -106,8 +834,17 @@ public:
  * that we can reorganize the points such that we get an continuous single connect list that we can use to
  * store in each octant the start of this list.
  *
+ * All octants are stored in a single contiguous array, where the children of an octant are stored consecutively.
+ * Instead of eight child pointers, each octant only stores a child mask and the index of its first child.
+ *
+ * With OctreeParams::reorderPoints, the octree additionally stores the coordinates of all points in the order of
+ * the successor list as separate x, y, z arrays together with the permutation to the original indexes. Thus, the
+ * points of an octant form a continuous range, which can be scanned linearly.
+ *
  * Special about the implementation is that it allows to search for neighbors with arbitrary p-norms, which
  * distinguishes it from most other Octree implementations.
+ * The norm is a template argument of the queries, e.g., radiusNeighbors<L1Distance<PointT> >(query, radius, result),
+ * where L2Distance is the default. The distance policies are resolved at compile time.
  *
  * We decided to implement the Octree using a template for points and containers. The container must have an
  * operator[], which allows to access the points, and a size() member function, which allows to get the size of the
@@ -120,7 +857,10 @@ public:
  *    J. Behley, V. Steinhage, A.B. Cremers. Efficient Radius Neighbor Search in Three-dimensional Point Clouds,
  *    Proc. of the IEEE International Conference on Robotics and Automation (ICRA), 2015.
  *
- * In future, we might add also other neighbor queries and implement the removal and adding of points.
+ * A built octree can be saved and memory-mapped by openMapped, which answers queries directly from the mapped file.
+ *
+ * Points can be inserted and removed incrementally, which splits overfull leafs, merges underfull octants, and grows
+ * the root if necessary.
  *
  * \version 0.1-icra
  *
@@ -130,21 +870,102 @@ public:
 template <typename PointT, typename ContainerT = std::vector<PointT>>
 class Octree
 {
+	friend class OctreePartition<PointT, ContainerT>;
+	template <typename P, typename C>
+	friend class OctreeBuilder;
+
 public:
 	Octree();
 	~Octree();
 
-	/** \brief initialize octree with all points **/
+	/** \brief initialize octree with all points
+   *
+   * The memory of the octants, successors and coordinates of a previous initialization is reused, i.e., rebuilding the
+   * octree for successive point clouds of similar size does not allocate memory.
+   **/
 	void initialize(const ContainerT& pts, const OctreeParams& params = OctreeParams());
 
 	/** \brief initialize octree only from pts that are inside indexes. **/
 	void initialize(const ContainerT& pts, const std::vector<uint32_t>& indexes, const OctreeParams& params = OctreeParams());
 
-	/** \brief remove all data inside the octree. **/
+	/** \brief remove all data inside the octree and release the memory of octants, successors and coordinates. **/
 	void clear();
 
+	/** \brief write the octants and the reordered points to a file, which can be memory-mapped by openMapped.
+   *
+   * The little-endian file format is versioned and contains the octants, the point coordinates in the order of
+   * OctreeParams::reorderPoints, the original indexes of the points and, with OctreeParams::levelOfDetail, the
+   * centroids of the octants. The reordered points are determined for saving if the octree was not built with
+   * reorderPoints.
+   *
+   * @return true, if the file was successfully written; false otherwise, e.g., for an already mapped octree.
+   **/
+	bool save(const std::string& path) const;
+
+	/** \brief map an octree written by save without copying it, which allows several processes to share the file.
+   *
+   * Queries are answered directly from the mapped file and report the original indexes of the saved points. A mapped
+   * octree has no point container and is read-only, i.e., insert, remove and aggregate are not available; levelOfDetail
+   * is available, if the file contains centroids. Without mmap, the file is read into memory.
+   *
+   * @return true, if the file was successfully mapped; false otherwise and the octree is empty.
+   **/
+	bool openMapped(const std::string& path);
+
+	/** \brief insert the points [first, last) of pts without rebuilding the octree.
+   *
+   * pts must contain the already inserted points at unchanged indexes, e.g., the container given to initialize with
+   * appended points. Without OctreeParams::copyPoints, pts replaces the previous container and must stay valid as long
+   * as the octree is used; removed points keep their indexes, i.e., the container can not shrink and the successor list
+   * is sized by the largest index. Leafs with more than bucketSize points are split and the root grows to cover points
+   * outside of it. Points with non-finite coordinates are ignored.
+   *
+   * The octants are updated locally, but the copies of OctreeParams::reorderPoints and levelOfDetail are recomputed
+   * for all points, i.e., updates need O(N) time with these options; thus, insert points in batches.
+   **/
+	void insert(const ContainerT& pts, uint32_t first, uint32_t last);
+
+	/** \brief remove the points with given indexes, which merges octants with at most bucketSize points.
+   *
+   * The container given to initialize or insert must still contain the points at their indexes. As for insert, the
+   * copies of the points are recomputed with OctreeParams::reorderPoints and levelOfDetail.
+   *
+   * @return number of removed points; indexes not inside the octree are ignored.
+   **/
+	uint32_t remove(const std::vector<uint32_t>& indexes);
+
+	/** \brief partition of all points into the octants at the specified depth, see OctreePartition. **/
+	OctreePartition<PointT, ContainerT> partition(int depth) const;
+
+	/** \brief indices of all points in each part of partition(depth), which is kept for radiusSearchLimitInOneOctant.
+   *
+   * Prefer partition(), which is thread-safe and allows to use several partitions at the same time.
+   **/
 	bool getOctantIndicesAtSpecifiedDepth(int depth, std::vector<std::vector<uint32_t>>& indicesList);
 
+	/** \brief indices of all points in each part of partition(depth) in a single array.
+   *
+   * The indices of the k-th part are indices[offsets[k]] to indices[offsets[k + 1] - 1], which avoids an allocation
+   * per part. With OctreeParams::reorderPoints, the parts are consecutive in the leaf-sorted indices, which are copied
+   * with a single bulk copy; visitOctantsAtSpecifiedDepth passes them without any copy.
+   **/
+	bool getOctantIndicesAtSpecifiedDepth(int depth, std::vector<uint32_t>& indices, std::vector<uint32_t>& offsets);
+
+	/** \brief call visitor(part, indices, count) for each part of partition(depth) as soon as it is discovered.
+   *
+   * Parts are numbered as in partition(depth). The visitor, e.g., a lambda, is invoked concurrently from OpenMP tasks
+   * and therefore must be thread-safe; indices is only valid during the call. Thus, the processing of the first parts
+   * starts while the remaining parts are still collected. With OctreeParams::reorderPoints, indices refers directly to
+   * the leaf-sorted indices without copying them.
+   *
+   * @return number of visited parts.
+   **/
+	template <typename VisitorT>
+	uint32_t visitOctantsAtSpecifiedDepth(int depth, VisitorT&& visitor) const;
+
+	/** \brief radius neighbor query limited to the octantIndex-th part of the last getOctantIndicesAtSpecifiedDepth.
+   * @return true, if the search ball overlaps no other part, see OctreePartition::radiusNeighbors.
+   **/
 	bool radiusSearchLimitInOneOctant(int octantIndex, const PointT& query, float radius, std::vector<uint32_t>& resultIndices) const;
 
 	bool radiusSearchLimitInOneOctant(int octantIndex,
@@ -156,26 +977,320 @@ public:
 	/** \brief radius neighbor queries where radius determines the maximal radius of reported indices of points in
    * resultIndices **/
 
+	template <typename Distance = L2Distance<PointT> >
 	void radiusNeighbors(const PointT& query, float radius, std::vector<uint32_t>& resultIndices) const;
 
 	/** \brief radius neighbor queries with explicit (squared) distance computation. **/
 
+	template <typename Distance = L2Distance<PointT> >
 	void radiusNeighbors(const PointT& query, float radius, std::vector<uint32_t>& resultIndices, std::vector<float>& distances) const;
 
-	/** \brief nearest neighbor queries. Using minDistance >= 0, we explicitly disallow self-matches.
-   * @return index of nearest neighbor n with Distance::compute(query, n) > minDistance and otherwise -1.
+	/** \brief radius neighbor queries calling visitor(index, sqrDistance) for each neighbor without storing any results.
+   *
+   * The visitor, e.g., a lambda or a functor with bool operator()(uint32_t index, float sqrDistance), returns false to
+   * stop the search, which allows to count or accumulate neighbors without allocations.
+   *
+   * @return true, if all neighbors were visited; false, if the visitor stopped the search.
    **/
 
+	template <typename Distance = L2Distance<PointT>, typename VisitorT>
+	bool radiusNeighbors(const PointT& query, float radius, VisitorT&& visitor) const;
+
+	/** \brief radius neighbor queries into caller-supplied arrays with space for capacity elements.
+   *
+   * sqrDistances may be null. If more than capacity neighbors exist, the search stops as soon as the arrays are full
+   * and truncated is set to true.
+   *
+   * @return number of reported neighbors.
+   **/
+
+	template <typename Distance = L2Distance<PointT> >
+	uint32_t radiusNeighbors(const PointT& query,
+	                         float radius,
+	                         uint32_t* resultIndices,
+	                         float* sqrDistances,
+	                         uint32_t capacity,
+	                         bool& truncated) const;
+
+	/** \brief radius neighbor queries for all points in queries, which are distributed over all OpenMP threads.
+   *
+   * The results are stored in compressed sparse row layout, i.e., the indices of the i-th query are
+   * resultIndices[offsets[i]], ..., resultIndices[offsets[i + 1] - 1]. The queries are processed in order of their
+   * Morton codes such that subsequent queries of a thread mostly visit the same octants.
+   **/
+
+	template <typename Distance = L2Distance<PointT>, typename QueryContainerT>
+	void radiusNeighborsBatch(const QueryContainerT& queries, float radius, std::vector<uint64_t>& offsets, std::vector<uint32_t>& resultIndices) const;
+
+	/** \brief batched radius neighbor queries with explicit (squared) distance computation. **/
+
+	template <typename Distance = L2Distance<PointT>, typename QueryContainerT>
+	void radiusNeighborsBatch(const QueryContainerT& queries,
+	                          float radius,
+	                          std::vector<uint64_t>& offsets,
+	                          std::vector<uint32_t>& resultIndices,
+	                          std::vector<float>& distances) const;
+
+	/** \brief nearest neighbor queries. Using minDistance >= 0, we explicitly disallow self-matches.
+   * @return index of nearest neighbor n with Distance::compute(query, n) > minDistance and otherwise -1.
+   **/
+
+	template <typename Distance = L2Distance<PointT> >
 	int32_t findNeighbor(const PointT& query, float minDistance = -1) const;
 
+	/** \brief nearest neighbor queries for all points in queries, e.g., the correspondences of ICP, which are
+   * distributed over all OpenMP threads.
+   *
+   * The queries are processed in order of their Morton codes. Each search starts with the distance bound given by
+   * the previous neighbor (via the triangle inequality) at the deepest octant on the path of the previous query, which
+   * contains the search ball, instead of the root. The index of the nearest neighbor of the i-th query is stored in
+   * resultIndices[i] (-1 if none) and its Distance::compute in sqrDistances[i] (infinity if none), which may be null.
+   **/
+
+	template <typename Distance = L2Distance<PointT>, typename QueryContainerT>
+	void findNeighbors(const QueryContainerT& queries, int32_t* resultIndices, float* sqrDistances = 0, float minDistance = -1) const;
+
+	/** \brief k nearest neighbor queries. Using minDistance >= 0, we explicitly disallow self-matches.
+   *
+   * Reports up to k indices sorted by increasing distance in resultIndices and the corresponding squared
+   * distances, i.e., Distance::compute, in sqrDistances. Less than k indices are only reported if the octree contains
+   * less than k points with distance > minDistance.
+   **/
+
+	template <typename Distance = L2Distance<PointT> >
+	void knnNeighbors(const PointT& query,
+	                  uint32_t k,
+	                  std::vector<uint32_t>& resultIndices,
+	                  std::vector<float>& sqrDistances,
+	                  float minDistance = -1) const;
+
+	/** \brief k nearest neighbor queries limited to the neighbors with Distance::compute < radius^2.
+   *
+   * Reports up to k indices of the radius neighbors sorted by increasing distance like knnNeighbors. The search is
+   * bounded by the smaller of radius and the distance of the current k-th neighbor; thus, its cost depends on k and
+   * not on the number of points inside the radius as radiusNeighbors followed by a partial sort.
+   **/
+
+	template <typename Distance = L2Distance<PointT> >
+	void radiusKnn(const PointT& query,
+	               float radius,
+	               uint32_t k,
+	               std::vector<uint32_t>& resultIndices,
+	               std::vector<float>& sqrDistances,
+	               float minDistance = -1) const;
+
+	/** \brief approximate nearest neighbor queries, which prune all octants farther away than the distance of the
+   * current neighbor divided by (1 + epsilon) and stop when the budget of scanned leafs or points is exhausted.
+   *
+   * exact is set to true, if the result is guaranteed to be the exact nearest neighbor, i.e., neither the relaxation
+   * pruned an octant nor was the budget exhausted.
+   * @return index of the approximate nearest neighbor and -1, if no point was found within the budget.
+   **/
+
+	template <typename Distance = L2Distance<PointT> >
+	int32_t findNeighbor(const PointT& query, const ApproximateParams& approx, bool& exact, float minDistance = -1) const;
+
+	/** \brief approximate k nearest neighbor queries with the same relaxation and budget as findNeighbor. **/
+
+	template <typename Distance = L2Distance<PointT> >
+	void knnNeighbors(const PointT& query,
+	                  uint32_t k,
+	                  std::vector<uint32_t>& resultIndices,
+	                  std::vector<float>& sqrDistances,
+	                  const ApproximateParams& approx,
+	                  bool& exact,
+	                  float minDistance = -1) const;
+
+	/** \brief batched k nearest neighbor queries for all points in queries.
+   *
+   * The results of the i-th query are written to resultIndices[i * k], ..., resultIndices[i * k + k - 1] and
+   * accordingly to sqrDistances, which both must be preallocated by the caller with queries.size() * k elements.
+   * Unused entries are filled with std::numeric_limits<uint32_t>::max() and infinity. sqrDistances may be null.
+   **/
+
+	template <typename Distance = L2Distance<PointT>, typename QueryContainerT>
+	void knnNeighbors(const QueryContainerT& queries, uint32_t k, uint32_t* resultIndices, float* sqrDistances, float minDistance = -1) const;
+
+	/** \brief indices of all points p with min <= p <= max in each coordinate.
+   *
+   * Octants completely inside of the box report all their points at once and only the points of leafs overlapping
+   * the border of the box are tested.
+   **/
+	void boxSearch(const PointT& min, const PointT& max, std::vector<uint32_t>& resultIndices) const;
+
+	/** \brief indices of all points inside the convex polyhedron given by the intersection of the half-spaces.
+   *
+   * For instance, a view frustum or an oriented box are given by the half-spaces of their six faces. Each half-space
+   * is only tested for the octants intersecting its plane and octants inside of all half-spaces report all their
+   * points at once.
+   *
+   * @return false, if more than 32 half-spaces are given; resultIndices is then empty.
+   **/
+	bool convexSearch(const std::vector<Halfspace>& halfspaces, std::vector<uint32_t>& resultIndices) const;
+
+	/** \brief first point along the ray, i.e., the point with distance at most radius to the ray from origin in
+   * direction (which does not need to be normalized) with the smallest distance along the ray up to maxDistance.
+   *
+   * The octants are traversed front-to-back by the parameter at which the ray enters the octants enlarged by radius,
+   * which allows to stop as soon as the remaining octants are entered behind the current hit.
+   *
+   * @return true, if a point was hit; its index and distance along the ray are then stored in hitIndex and
+   * hitDistance.
+   **/
+	bool rayCast(const PointT& origin,
+	             const PointT& direction,
+	             float radius,
+	             uint32_t& hitIndex,
+	             float& hitDistance,
+	             float maxDistance = std::numeric_limits<float>::infinity()) const;
+
+	/** \brief first hits of a bundle of rays from a single origin, which are distributed over all OpenMP threads.
+   *
+   * The hit of the i-th ray is written to hitIndices[i] and hitDistances[i], which both must be preallocated by the
+   * caller with directions.size() elements. Missed rays get std::numeric_limits<uint32_t>::max() and infinity.
+   * hitDistances may be null.
+   **/
+	template <typename QueryContainerT>
+	void rayCast(const PointT& origin,
+	             const QueryContainerT& directions,
+	             float radius,
+	             uint32_t* hitIndices,
+	             float* hitDistances,
+	             float maxDistance = std::numeric_limits<float>::infinity()) const;
+
+	/** \brief all points with distance at most radius to the ray up to maxDistance sorted by their distance along the
+   * ray, which is stored in rayDistances.
+   **/
+	void rayPoints(const PointT& origin,
+	               const PointT& direction,
+	               float radius,
+	               std::vector<uint32_t>& resultIndices,
+	               std::vector<float>& rayDistances,
+	               float maxDistance = std::numeric_limits<float>::infinity()) const;
+
+	/** \brief all pairs (i, j) of points i of this octree and j of other with Distance::compute(i, j) < radius^2.
+   *
+   * The dual-tree traversal descends simultaneously into both octrees, prunes pairs of octants farther apart than
+   * radius and reports pairs of octants, which are completely within radius, at once. The visitor provides
+   *   bool operator()(uint32_t index, uint32_t otherIndex, float sqrDistance)
+   * for single pairs and
+   *   bool operator()(const uint32_t* indices, uint32_t size, const uint32_t* otherIndices, uint32_t otherSize)
+   * for all pairs of points of two octants, which stay valid only during the call. Both return false to stop the
+   * join. For a self-join with this as other, every pair is reported in both orders including the pairs (i, i).
+   *
+   * @return true, if all pairs were visited; false, if the visitor stopped the join.
+   **/
+	template <typename Distance = L2Distance<PointT>, typename VisitorT>
+	bool radiusJoin(const Octree& other, float radius, VisitorT&& visitor) const;
+
+	/** \brief all pairs of the radius join, which is distributed over all OpenMP threads by pairs of octants near the
+   * roots. The pairs are reported in the same order independent of the number of threads.
+   **/
+	template <typename Distance = L2Distance<PointT> >
+	void radiusJoin(const Octree& other, float radius, std::vector<std::pair<uint32_t, uint32_t> >& pairs) const;
+
+	/** \brief aggregate the points of all octants at the specified depth, where the root has depth 0.
+   *
+   * Leafs above the depth are subdivided virtually, i.e., each aggregate covers the points of a cell with the extent of
+   * the octants at the specified depth, where points on the splitting planes belong to the lower cell as in the
+   * construction. The point sums of all octants are determined in a single bottom-up pass over the octants; determining
+   * the nearest points to the centroids needs another scan of the points.
+   *
+   * A mapped octree (see openMapped) has no point container and reports no aggregates.
+   **/
+	void aggregate(int depth, std::vector<OctantAggregate>& aggregates, bool findNearest = true) const;
+
+	/** @return smallest depth, where octants have at most the given extent. **/
+	int depthForExtent(float extent) const;
+
+	/** \brief voxel grid downsampling, which reports for each octant with at most the given extent the index of the
+   * point nearest to the centroid of its points. A mapped octree reports no points like aggregate.
+   **/
+	void downsample(float extent, std::vector<uint32_t>& resultIndices) const;
+
+	/** \brief level of detail query, which represents far octants by their centroids and near leafs by their points.
+   *
+   * An octant with extent e at distance d to the viewpoint is represented by its centroid if e <= error * d, i.e.,
+   * error bounds the angular size of the octant as seen from the viewpoint. For a perspective camera with a focal
+   * length of f pixels, error = p / f bounds the screen-space error to about p pixels. Octants are refined in order of
+   * decreasing e / d until at most maxSamples samples are reported; thus, the budget is spent on the nearest octants.
+   *
+   * @return false, if the octree is empty or was not built with OctreeParams::levelOfDetail, or if the mapped file
+   * contains no centroids.
+   **/
+	bool levelOfDetail(const PointT& viewpoint,
+	                   float error,
+	                   std::vector<LodSample>& samples,
+	                   uint32_t maxSamples = std::numeric_limits<uint32_t>::max()) const;
+
+	/** \brief counters of radiusNeighbors, radiusNeighborsBatch, findNeighbor and radiusSearchLimitInOneOctant summed
+   * over the accumulators of all threads, which are only collected with UNIBN_OCTREE_STATS and zero otherwise.
+   * Threads are distinguished by their OpenMP thread number. The counters are incremented atomically, such that
+   * queries of other threads, e.g., std::thread, are also counted correctly but share the counters of a thread number.
+   **/
+	QueryStats queryStats() const;
+
+	/** \brief reset the counters of all threads, which must not run concurrently to queries. **/
+	void resetQueryStats();
+
+	/** \brief counters, which radiusNeighbors would collect for the queries, determined by the same traversal without
+   * distance computations; thus, they are also available without UNIBN_OCTREE_STATS. Only the results of leafs are not
+   * counted, i.e., results only contains the points of contained octants.
+   **/
+	template <typename Distance = L2Distance<PointT> >
+	QueryStats radiusQueryCost(const std::vector<PointT>& queries, float radius) const;
+
+	/** @return depth histogram, leaf occupancy and memory usage of the octree. **/
+	OctreeShape shape() const;
+
 protected:
+	/** \brief counter, which is incremented with relaxed atomics, since threads may share a ThreadStats. **/
+	class StatCounter
+	{
+	public:
+		StatCounter()
+		    : value_(0)
+		{
+		}
+
+		void operator+=(uint64_t n)
+		{
+			value_.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		uint64_t load() const
+		{
+			return value_.load(std::memory_order_relaxed);
+		}
+
+		void reset()
+		{
+			value_.store(0, std::memory_order_relaxed);
+		}
+
+	protected:
+		std::atomic<uint64_t> value_;
+	};
+
+	/** \brief query counters of a thread number. The vector storage is not aligned to cache lines, therefore the
+   * counters are padded to two cache lines, such that counters of different threads never share a cache line.
+   **/
+	struct ThreadStats
+	{
+		StatCounter queries, octantsVisited, overlapTests, containedOctants, pointsTested, results;
+		char padding[128 - 6 * sizeof(StatCounter)];
+	};
+
+	/** @return counters of the calling thread. **/
+	ThreadStats& threadStats() const
+	{
+		return threadStats_[threadIndex() % threadStats_.size()];
+	}
+
 	class Octant
 	{
 	public:
 		Octant();
-		~Octant();
-
-		bool isLeaf;
 
 		// bounding box of the octant needed for overlap and contains tests...
 		float x, y, z; // center
@@ -183,8 +1298,12 @@ protected:
 
 		uint32_t start, end; // start and end in succ_
 		uint32_t size; // number of points
+		uint32_t offset; // position of start in the reordered points (only with OctreeParams::reorderPoints).
 
-		Octant* child[8];
+		uint32_t firstChild; // index of first child in octants_; children are stored consecutively.
+		uint8_t childMask; // i-th bit is set, if i-th child exists.
+		bool isLeaf;
+		uint8_t reserved[2]; // explicit padding, which is zero in saved files.
 	};
 
 	// not copyable, not assignable ...
@@ -197,24 +1316,343 @@ protected:
    * The method reorders the index such that all points are correctly linked to successors belonging
    * to the same octant.
    *
+   * \param octants         array of octants, where the children are appended
+   * \param octantIdx       index of the already allocated octant in octants
    * \param x,y,z           center coordinates of octant
    * \param extent          extent of octant
    * \param startIdx        first index of points inside octant
    * \param endIdx          last index of points inside octant
    * \param size            number of points in octant
-   *
-   * \return  octant with children nodes.
    */
-	Octant* createOctant(float x, float y, float z, float extent, uint32_t startIdx, uint32_t endIdx, uint32_t size);
+	void createOctant(std::vector<Octant>& octants,
+	                  uint32_t octantIdx,
+	                  float x,
+	                  float y,
+	                  float z,
+	                  float extent,
+	                  uint32_t startIdx,
+	                  uint32_t endIdx,
+	                  uint32_t size);
+
+	/** \brief append the subtree built in subtree to octants, where subtree[0] becomes octants[octantIdx]. **/
+	static void appendSubtree(std::vector<Octant>& octants, uint32_t octantIdx, const std::vector<Octant>& subtree);
+
+	/** \brief remove all data, but keep the memory of octants, successors and coordinates for the next initialize. **/
+	void reset();
+
+	/** @return number of octants to reserve for size points, which is about 5 * size / bucketSize for uniformly
+   * distributed points.
+   **/
+	uint32_t estimateOctants(uint32_t size) const
+	{
+		return 6 * (size / std::max(params_.bucketSize, 1u)) + 1;
+	}
+
+	/** \brief allocate the root octant and build the octree for the linked points from startIdx to endIdx. **/
+	void createRoot(const float min[3], const float max[3], uint32_t startIdx, uint32_t endIdx, uint32_t size);
+
+	/** \brief maximal number of levels of the Morton keys, i.e., 3 bits per level fit into 63 bits. **/
+	static const uint32_t mortonLevels = 21;
+
+	/** \brief build the octree for the linked points from startIdx inside the root octant by sorting the points by
+   * their Morton keys, see OctreeParams::mortonBuild.
+   **/
+	void createMortonRoot(float x, float y, float z, float extent, uint32_t startIdx, uint32_t size);
+
+	/** \brief Morton keys with the child codes of the first levels octants containing the points chain[0], ...,
+   * chain[size - 1], which are determined exactly like in createOctant. At most mortonBlockSize points are processed
+   * at once.
+   **/
+	void mortonKeys(const uint32_t* chain,
+	                uint32_t size,
+	                float x,
+	                float y,
+	                float z,
+	                float extent,
+	                uint32_t levels,
+	                uint64_t* keys) const;
+
+	static const uint32_t mortonBlockSize = 32;
+
+	/** \brief creation of an octant for the points chain[ranks[first]], ..., chain[ranks[last - 1]] sorted by their
+   * Morton keys with the given levels, where ranks are the positions in the successor list chain. Octants below the
+   * levels of the keys are created by createOctant.
+   **/
+	void createMortonOctant(std::vector<Octant>& octants,
+	                        uint32_t octantIdx,
+	                        float x,
+	                        float y,
+	                        float z,
+	                        float extent,
+	                        const std::vector<uint64_t>& keys,
+	                        std::vector<uint32_t>& ranks,
+	                        const std::vector<uint32_t>& chain,
+	                        uint32_t first,
+	                        uint32_t last,
+	                        uint32_t level,
+	                        uint32_t levels);
+
+	/** \brief determine the offsets of all octants and copy the points in order of the successor list. **/
+	void reorderPoints();
+
+	/** \brief reorderPoints for the given copy of the octants, which stores x, y and z arrays in coordinates. **/
+	void reorderPoints(std::vector<Octant>& octants, std::vector<float>& coordinates, std::vector<uint32_t>& indexes) const;
+
+	/** \brief determine the offsets of the octants in the successor order, i.e., Octant::offset. **/
+	static void assignOffsets(std::vector<Octant>& octants);
+
+	/** \brief compute the centroids of all octants for OctreeParams::levelOfDetail. **/
+	void computeCentroids();
+
+	/** \brief quantize the coordinates relative to their leafs in successor order for OctreeParams::quantizePoints. **/
+	void quantizePoints();
+
+	/** \brief update the reordered or quantized points and centroids after the octants changed. **/
+	void updatePoints();
+
+	/** \brief radius search in the quantized points of a leaf, which only determines the exact distances of points
+   * near the search sphere and of all reported points, if distances is not null.
+   **/
+	template <typename Distance>
+	void quantizedRadiusNeighbors(const Octant* octant,
+	                              const PointT& query,
+	                              float radius,
+	                              float sqrRadius,
+	                              std::vector<uint32_t>& resultIndices,
+	                              std::vector<float>* distances) const;
+
+	static const int32_t quantizationLevels = 32767; // quantized offsets are in [-levels, levels] times extent / levels.
+
+	/** \brief header of the file format of save, which is followed by the 64 byte aligned sections in any order.
+   *
+   * The sections are mapped without conversion; thus, the format is fixed to little-endian byte order, IEEE 754 floats
+   * and the 40 byte layout of Octant: x, y, z, extent (float32), start, end, size, offset, firstChild (uint32),
+   * childMask, isLeaf (uint8) and two zero bytes. The layout is checked at compile time and octantSize records it.
+   **/
+	struct FileHeader
+	{
+		char magic[8]; // "UNIBNOCT"
+		uint32_t version;
+		uint32_t byteOrder; // 0x01020304 in little-endian byte order.
+		uint32_t octantSize; // sizeof(Octant) of the writer.
+		uint32_t bucketSize;
+		float minExtent;
+		uint32_t numOctants;
+		uint32_t numPoints;
+		uint32_t reserved;
+		uint64_t octantsOffset; // all octants, where the root is the first octant.
+		uint64_t coordinatesOffset; // x, y and z coordinates with numPoints values each.
+		uint64_t indexesOffset; // original indexes of the points.
+		uint64_t fileSize;
+		uint64_t centroidsOffset; // since version 2: x, y, z centroid of each octant or 0, see OctreeParams::levelOfDetail.
+	};
+
+	static_assert(sizeof(FileHeader) == 80, "FileHeader must not contain padding.");
+	static_assert(std::numeric_limits<float>::is_iec559 && sizeof(bool) == 1, "file format needs IEEE 754 and 1 byte bool.");
+	static_assert(sizeof(Octant) == 40 && offsetof(Octant, start) == 16 && offsetof(Octant, firstChild) == 32 &&
+	                  offsetof(Octant, childMask) == 36 && offsetof(Octant, isLeaf) == 37,
+	              "Octant layout differs from the file format.");
+
+	/** \brief check the header and octants of the mapped file and set up the octree. **/
+	bool attachMapping();
+
+	static bool littleEndian();
+
+	/** \brief insert a single point inside the root, which insert grows beforehand; path is only used as buffer for the
+   * visited octants.
+   **/
+	void insertPoint(uint32_t idx, std::vector<uint32_t>& path);
+
+	/** @return true, if the point was found and removed; path is only used as buffer for the visited octants. **/
+	bool removePoint(uint32_t idx, std::vector<uint32_t>& path);
+
+	/** \brief sort indexes of points by the Morton codes of the points. **/
+	void sortIndexesByMortonCode(std::vector<uint32_t>& indexes) const;
+
+	/** \brief enlarge the root until it contains p. **/
+	void growRoot(const PointT& p);
+
+	/** @return true, if the point idx is inside octant; path contains then all octants to its leaf. **/
+	bool findLeaf(uint32_t octantIdx, const PointT& p, uint32_t idx, std::vector<uint32_t>& path, uint32_t& pred) const;
+
+	/** @return point linking to the start of the last octant in path, or max. uint32_t if there is none. **/
+	uint32_t predecessor(const std::vector<uint32_t>& path) const;
+
+	/** \brief link point idx behind end, which is inside the last octant of path. **/
+	void linkBehind(const std::vector<uint32_t>& path, uint32_t idx, uint32_t end);
 
-	void getOctantChild(Octant* node, int depth, int targetDepth, std::vector<Octant*>& octantList);
+	/** \brief link the only point of the new leaf childIdx in order of the children of the last octant in path.
+   *
+   * The leaf is appended to path and pred must be the predecessor of the octant if childIdx is its first child.
+   **/
+	void linkChild(std::vector<uint32_t>& path, uint32_t childIdx, uint32_t pred);
+
+	/** \brief split the leaf at the end of path and link its new start and end to the remaining points. **/
+	void splitLeaf(const std::vector<uint32_t>& path);
+
+	/** \brief allocate the children of octant again including a new leaf with code containing only point idx. **/
+	uint32_t addChild(uint32_t octantIdx, uint32_t code, uint32_t idx);
+
+	/** \brief allocate the children of octant again without the child childIdx. **/
+	void removeChild(uint32_t octantIdx, uint32_t childIdx);
+
+	/** \brief turn the first octant in path with at most bucketSize points into a leaf. **/
+	void mergeOctants(const std::vector<uint32_t>& path);
+
+	/** \brief drop all unreachable octants, which keeps the order of the construction. **/
+	void compactOctants();
+
+	void copyChildren(std::vector<Octant>& octants, uint32_t octantIdx) const;
+
+	/** \brief sums of the coordinates of the points of each octant, which are indexed like octants_. **/
+	void octantSums(std::vector<double>& sums) const;
+
+	/** @return extent of octant relative to its distance to the viewpoint; infinity, if the viewpoint is inside. **/
+	float relativeExtent(const PointT& viewpoint, const Octant* octant) const;
+
+	/** \brief collect the octants at depth below octant and the leafs above with their number of subdivisions. **/
+	void collectAggregates(const Octant* octant, int octantDepth, int depth, std::vector<std::pair<const Octant*, uint32_t> >& items) const;
+
+	/** \brief aggregates of the cells of a leaf, which is levels times subdivided; indexes and cells are buffers. **/
+	void aggregateLeaf(const Octant* octant,
+	                   uint32_t levels,
+	                   bool findNearest,
+	                   std::vector<OctantAggregate>& aggregates,
+	                   std::vector<uint32_t>& indexes,
+	                   std::vector<std::pair<uint64_t, uint32_t> >& cells) const;
+
+	/** @return i-th child of octant, or 0 if the child does not exist. **/
+	const Octant* child(const Octant* octant, uint32_t i) const;
+
+	/** @return number of set bits of a child mask. **/
+	static uint32_t bitCount(uint32_t mask);
+
+	/** @return Morton code of the child of an octant with center (x, y, z), which contains p. Points on a splitting
+   * plane belong to the lower child; createOctant, insert and remove all follow this rule.
+   **/
+	static uint32_t childCode(float x, float y, float z, const PointT& p);
+
+	/** \brief indices of all points inside octant. **/
+	void getIndices(const Octant* octant, std::vector<uint32_t>& indices) const;
+
+	/** \brief append the indices of all points inside octant. **/
+	void appendIndices(const Octant* octant, std::vector<uint32_t>& indices) const;
+
+	/** \brief copy the indices of all points inside octant to indices, which has space for octant->size elements. **/
+	void copyIndices(const Octant* octant, uint32_t* indices) const;
+
+	/** \brief visit the parts below octant at octantDepth, see visitOctantsAtSpecifiedDepth. **/
+	template <typename VisitorT>
+	void visitOctantsAtSpecifiedDepth(const Octant* octant, int octantDepth, int depth, uint32_t& part, VisitorT* visitor) const;
+
+	void boxSearch(const Octant* octant, const float min[3], const float max[3], std::vector<uint32_t>& resultIndices) const;
+
+	/** \brief active contains a bit for each half-space, whose plane may intersect the octant. **/
+	void convexSearch(const Octant* octant, const Halfspace* halfspaces, uint32_t active, std::vector<uint32_t>& resultIndices) const;
+
+	/** \brief state of an approximate search, see ApproximateParams. **/
+	struct ApproximateState
+	{
+		ApproximateState(const ApproximateParams& params)
+		    : scale(1.0f / (1.0f + std::max(params.epsilon, 0.0f)))
+		    , remainingLeafs(params.maxLeafs)
+		    , remainingPoints(params.maxPoints)
+		    , relaxed(false)
+		    , exhausted(false)
+		{
+		}
+
+		/** @return true, if the leaf with the given number of points fits into the remaining budget. **/
+		bool visit(uint32_t size)
+		{
+			if (remainingLeafs == 0 || size > remainingPoints)
+			{
+				exhausted = true;
+				return false;
+			}
+			remainingLeafs -= 1;
+			remainingPoints -= size;
+			return true;
+		}
+
+		float scale; // 1 / (1 + epsilon).
+		uint32_t remainingLeafs, remainingPoints;
+		bool relaxed; // an octant was pruned only due to the relaxation.
+		bool exhausted;
+	};
+
+	/** \brief overlap test with the search radius, which is shrunk for approximate searches. **/
+	template <typename Distance>
+	bool overlaps(const PointT& query, float radius, const Octant* octant, ApproximateState* approx) const;
+
+	/** \brief inside test with the search radius, which is shrunk for approximate searches. **/
+	bool inside(const PointT& query, float radius, const Octant* octant, ApproximateState* approx) const;
+
+	/** @return true, if search finished, otherwise false. **/
+
+	template <typename Distance>
+	bool findNeighbor(const Octant* octant,
+	                  const PointT& query,
+	                  float minDistance,
+	                  float& maxDistance,
+	                  int32_t& resultIndex,
+	                  ApproximateState* approx = 0) const;
+
+	template <typename Distance, typename QueryContainerT>
+	void radiusNeighborsBatch(const QueryContainerT& queries,
+	                          float radius,
+	                          std::vector<uint64_t>& offsets,
+	                          std::vector<uint32_t>& resultIndices,
+	                          std::vector<float>* distances) const;
+
+	/** @return Morton code of (x, y, z) quantized with 21 bits per axis inside the root octant. **/
+	uint64_t mortonCode(float x, float y, float z) const;
+
+	/** \brief determine the order of the queries by increasing Morton code. **/
+	template <typename QueryContainerT>
+	void sortByMortonCode(const QueryContainerT& queries, std::vector<uint32_t>& order) const;
+
+	/** \brief nearest neighbors of the queries order[first], ..., order[last - 1], where each search starts from the
+   * octant of the previous query. **/
+	template <typename Distance, typename QueryContainerT>
+	void findNeighbors(const QueryContainerT& queries,
+	                   const std::vector<uint32_t>& order,
+	                   uint32_t first,
+	                   uint32_t last,
+	                   int32_t* resultIndices,
+	                   float* sqrDistances,
+	                   float minDistance) const;
+
+	typedef std::pair<float, uint32_t> KnnEntry; // (squared distance, index), max-heap ordered.
 
 	/** @return true, if search finished, otherwise false. **/
 
-	bool findNeighbor(const Octant* octant, const PointT& query, float minDistance, float& maxDistance, int32_t& resultIndex) const;
+	template <typename Distance>
+	bool knnNeighbors(const Octant* octant,
+	                  const PointT& query,
+	                  uint32_t k,
+	                  float sqrMinDistance,
+	                  float sqrMaxDistance,
+	                  float& maxDistance,
+	                  std::vector<KnnEntry>& heap,
+	                  ApproximateState* approx = 0) const;
 
+	/** \brief insert candidate into the bounded max-heap of the k nearest neighbors found so far. **/
+
+	static void insertNeighbor(std::vector<KnnEntry>& heap, uint32_t k, float sqrDistance, uint32_t index);
+
+	/** \brief squared Euclidean distance using only the access traits of the points. **/
+
+	static float sqrDistance(const PointT& p, const PointT& q);
+
+	/** \brief squared Euclidean norm of the difference vector (x, y, z). **/
+
+	static float sqrDistance(float x, float y, float z);
+
+	template <typename Distance>
 	void radiusNeighbors(const Octant* octant, const PointT& query, float radius, float sqrRadius, std::vector<uint32_t>& resultIndices) const;
 
+	template <typename Distance>
 	void radiusNeighbors(const Octant* octant,
 	                     const PointT& query,
 	                     float radius,
@@ -222,6 +1660,134 @@ protected:
 	                     std::vector<uint32_t>& resultIndices,
 	                     std::vector<float>& distances) const;
 
+	/** \brief count the traversal of radiusNeighbors below octant, see radiusQueryCost. **/
+	template <typename Distance>
+	void radiusQueryCost(const Octant* octant, const PointT& query, float radius, float sqrRadius, QueryStats& stats) const;
+
+	/** @return true, if all neighbors were visited; false, if the visitor stopped the search. **/
+
+	template <typename Distance, typename VisitorT>
+	bool visitRadiusNeighbors(const Octant* octant, const PointT& query, float radius, float sqrRadius, VisitorT& visitor) const;
+
+	/** \brief ray with normalized direction and precomputed inverse direction. **/
+	struct Ray
+	{
+		bool set(const PointT& origin, const PointT& direction, float radius, float maxDistance);
+
+		float origin[3];
+		float direction[3];
+		float invDirection[3];
+		float radius, sqrRadius;
+		float maxDistance;
+	};
+
+	/** \brief interval of the ray inside the octant enlarged by the radius of the ray, which contains the distances
+   * along the ray of all points of the octant near the ray.
+   **/
+	bool rayInterval(const Octant* octant, const Ray& ray, float& tEnter, float& tExit) const;
+
+	/** \brief test if the point is near the ray and determine its distance t along the ray. **/
+	bool rayTest(const Ray& ray, float x, float y, float z, float& t) const;
+
+	void rayCast(const Octant* octant, const Ray& ray, uint32_t& hitIndex, float& hitDistance) const;
+
+	void rayPoints(const Octant* octant, const Ray& ray, std::vector<std::pair<float, uint32_t> >& hits) const;
+
+	/** @return -1, if the octants are farther apart than the radius, 1, if all their points are within the radius,
+   * and 0 otherwise.
+   **/
+	template <typename Distance>
+	static int32_t joinTest(const Octant* octant, const Octant* otherOctant, float sqrRadius);
+
+	/** @return indices of all points inside the octant, which are copied into buffer if not stored consecutively. **/
+	const uint32_t* octantIndices(const Octant* octant, std::vector<uint32_t>& buffer) const;
+
+	/** \brief buffers for the indices and coordinates of the points of both octants in radiusJoin. **/
+	struct JoinBuffers
+	{
+		std::vector<uint32_t> indices[2];
+		std::vector<float> xs[2], ys[2], zs[2];
+	};
+
+	/** \brief indices and coordinates of the points of a leaf in radiusJoin. **/
+	struct LeafPoints
+	{
+		const uint32_t* indices;
+		const float *xs, *ys, *zs;
+	};
+
+	/** \brief indices and coordinates of all points inside the octant, which are copied into the i-th buffers if they
+   * are not stored consecutively.
+   **/
+	LeafPoints gatherPoints(const Octant* octant, JoinBuffers& buffers, uint32_t i) const;
+
+	template <typename Distance, typename VisitorT>
+	bool radiusJoin(const Octant* octant,
+	                const Octree& other,
+	                const Octant* otherOctant,
+	                float sqrRadius,
+	                VisitorT& visitor,
+	                JoinBuffers& buffers) const;
+
+	/** \brief visitor collecting all pairs of radiusJoin. **/
+	struct JoinPairsVisitor
+	{
+		JoinPairsVisitor(std::vector<std::pair<uint32_t, uint32_t> >& pairs)
+		    : pairs(pairs)
+		{
+		}
+
+		bool operator()(uint32_t index, uint32_t otherIndex, float)
+		{
+			pairs.push_back(std::make_pair(index, otherIndex));
+			return true;
+		}
+
+		bool operator()(const uint32_t* indices, uint32_t size, const uint32_t* otherIndices, uint32_t otherSize)
+		{
+			// reserving exactly the required size would defeat the geometric growth of the vector.
+			const uint64_t required = pairs.size() + uint64_t(size) * otherSize;
+			if (required > pairs.capacity())
+				pairs.reserve(std::max<uint64_t>(required, 2 * pairs.capacity()));
+			for (uint32_t i = 0; i < size; ++i)
+			{
+				for (uint32_t j = 0; j < otherSize; ++j)
+					pairs.push_back(std::make_pair(indices[i], otherIndices[j]));
+			}
+			return true;
+		}
+
+		std::vector<std::pair<uint32_t, uint32_t> >& pairs;
+	};
+
+	/** \brief visitor writing the neighbors into arrays with fixed capacity. **/
+	struct BufferVisitor
+	{
+		BufferVisitor(uint32_t* indices, float* sqrDistances, uint32_t capacity)
+		    : indices(indices)
+		    , sqrDistances(sqrDistances)
+		    , capacity(capacity)
+		    , size(0)
+		{
+		}
+
+		bool operator()(uint32_t index, float sqrDistance)
+		{
+			if (size == capacity)
+				return false;
+			indices[size] = index;
+			if (sqrDistances != 0)
+				sqrDistances[size] = sqrDistance;
+			size += 1;
+			return true;
+		}
+
+		uint32_t* indices;
+		float* sqrDistances;
+		uint32_t capacity;
+		uint32_t size;
+	};
+
 	/** \brief test if search ball S(q,r) overlaps with octant
    *
    * @param query   query point
@@ -231,6 +1797,7 @@ protected:
    * @return true, if search ball overlaps with octant, false otherwise.
    */
 
+	template <typename Distance>
 	static bool overlaps(const PointT& query, float radius, float sqRadius, const Octant* o);
 
 	/** \brief test if search ball S(q,r) contains octant
@@ -242,6 +1809,7 @@ protected:
    * @return true, if search ball overlaps with octant, false otherwise.
    */
 
+	template <typename Distance>
 	static bool contains(const PointT& query, float sqRadius, const Octant* octant);
 
 	/** \brief test if search ball S(q,r) is completely inside octant.
@@ -256,55 +1824,298 @@ protected:
 	static bool inside(const PointT& query, float radius, const Octant* octant);
 
 	OctreeParams params_;
-	Octant* root_;
+	const Octant* root_; // first element of octants_ or 0, if octree is empty.
 	const ContainerT* data_;
 
+	std::vector<Octant> octants_; // all octants in one array; root_ is always the first one.
 	std::vector<uint32_t> successors_; // single connected list of next point indices...
-	std::vector<Octant*> octantList_;
+
+	// with OctreeParams::reorderPoints: coordinates in order of successors_ and their original indexes, which point
+	// into coordinates_ and indexes_ or into the mapped file.
+	const float *xs_, *ys_, *zs_;
+	const uint32_t* permutation_;
+	std::vector<float> coordinates_;
+	std::vector<uint32_t> indexes_;
+	// with OctreeParams::quantizePoints: x, y, z offsets of each point in successor order, which replace coordinates_
+	// and are permuted by permutation_.
+	std::vector<int16_t> quantized_;
+	// with OctreeParams::levelOfDetail: x, y, z centroid of each octant, which point into centroidCoordinates_ or into
+	// the mapped file.
+	const float* centroids_;
+	std::vector<float> centroidCoordinates_;
+
+	const char* mapping_; // file mapped by openMapped or 0.
+	uint64_t mappingSize_;
+	std::vector<uint64_t> fileBuffer_; // file contents, if mmap is not available.
+	OctreePartition<PointT, ContainerT> partition_; // partition of getOctantIndicesAtSpecifiedDepth.
+	mutable std::vector<ThreadStats> threadStats_; // query counters of each thread, only with UNIBN_OCTREE_STATS.
 	friend class ::OctreeTest;
 };
 
-template <typename PointT, typename ContainerT>
-Octree<PointT, ContainerT>::Octant::Octant()
-    : isLeaf(true)
-    , x(0.0f)
-    , y(0.0f)
-    , z(0.0f)
-    , extent(0.0f)
-    , start(0)
-    , end(0)
-    , size(0)
+/** \brief Immutable partition of the points of an octree into disjoint octants at a specified depth.
+ *
+ * Each part is either an octant at the specified depth or a leaf above it, such that every point belongs to exactly
+ * one part. All methods are const and therefore a partition can be used concurrently, e.g., to process all parts in
+ * parallel. A partition refers to its octree and is only valid as long as the octree is not changed.
+ */
+template <typename PointT, typename ContainerT = std::vector<PointT>>
+class OctreePartition
 {
-	memset(&child, 0, 8 * sizeof(Octant*));
-}
+public:
+	OctreePartition();
 
-template <typename PointT, typename ContainerT>
-Octree<PointT, ContainerT>::Octant::~Octant()
-{
-	for (uint32_t i = 0; i < 8; ++i)
-		delete child[i];
-}
+	/** @return number of parts. **/
+	uint32_t size() const;
 
-template <typename PointT, typename ContainerT>
-Octree<PointT, ContainerT>::Octree()
-    : root_(0)
-    , data_(0)
-{
-}
+	/** @return depth of the parts, where the root has depth 0. **/
+	int depth() const;
 
-template <typename PointT, typename ContainerT>
-Octree<PointT, ContainerT>::~Octree()
-{
-	delete root_;
-	if (params_.copyPoints)
-		delete data_;
-}
+	/** @return number of points inside the part. **/
+	uint32_t pointCount(uint32_t part) const;
 
-template <typename PointT, typename ContainerT>
-void Octree<PointT, ContainerT>::initialize(const ContainerT& pts, const OctreeParams& params)
-{
+	/** \brief indices of all points inside the part. **/
+	void indices(uint32_t part, std::vector<uint32_t>& indices) const;
+
+	/** \brief radius neighbor query limited to the points of the part.
+   *
+   * Only the parts overlapped by the search ball are visited to check if the query can be answered by the points of
+   * the part alone, which needs O(depth) overlap tests for search balls smaller than the parts.
+   *
+   * @return true, if the search ball overlaps no other part and resultIndices contains all radius neighbors;
+   *         false, otherwise and resultIndices is empty.
+   **/
+	template <typename Distance = L2Distance<PointT> >
+	bool radiusNeighbors(uint32_t part, const PointT& query, float radius, std::vector<uint32_t>& resultIndices) const;
+
+	/** \brief limited radius neighbor query with explicit (squared) distance computation. **/
+	template <typename Distance = L2Distance<PointT> >
+	bool radiusNeighbors(uint32_t part, const PointT& query, float radius, std::vector<uint32_t>& resultIndices, std::vector<float>& distances) const;
+
+protected:
+	typedef Octree<PointT, ContainerT> OctreeT;
+	typedef typename OctreeT::Octant Octant;
+
+	OctreePartition(const OctreeT* octree, int depth);
+
+	void collectParts(const Octant* octant, int depth);
+
+	/** @return true, if the search ball can be answered by the points of the part alone. **/
+	template <typename Distance>
+	bool isLimitedTo(uint32_t part, const PointT& query, float radius) const;
+
+	/** @return true, if the search ball overlaps a part below octant at octantDepth, which is not the given part. **/
+	template <typename Distance>
+	bool overlapsOtherPart(const Octant* octant, int octantDepth, const PointT& query, float radius, float sqrRadius, const Octant* part) const;
+
+	const OctreeT* octree_;
+	int depth_;
+	std::vector<const Octant*> parts_;
+
+	friend class Octree<PointT, ContainerT>;
+};
+
+/** \brief Double-buffered octree, which answers queries from many threads while a new octree is built.
+ *
+ * Readers obtain an immutable snapshot of the current octree, which stays valid as long as it is held. A rebuild
+ * creates the new octree off to the side and publishes it atomically; thus, readers are never blocked by a rebuild.
+ * When the last snapshot of a previous octree is dropped, the octree is handed back under a mutex and reused by the
+ * next rebuild, which avoids allocations for successive rebuilds (see Octree::initialize).
+ *
+ * Without OctreeParams::copyPoints, the points of an octree must stay valid as long as snapshots of it are held.
+ */
+template <typename PointT, typename ContainerT = std::vector<PointT>>
+class SharedOctree
+{
+public:
+	typedef Octree<PointT, ContainerT> OctreeT;
+	typedef std::shared_ptr<const OctreeT> Snapshot;
+
+	SharedOctree();
+
+	/** @return current octree, which is never null, but empty before the first rebuild. **/
+	Snapshot snapshot() const;
+
+	/** \brief build a new octree for the points and publish it, while snapshots of the old octree stay valid. **/
+	void rebuild(const ContainerT& pts, const OctreeParams& params = OctreeParams());
+
+	/** \brief build a new octree for the points inside indexes and publish it. **/
+	void rebuild(const ContainerT& pts, const std::vector<uint32_t>& indexes, const OctreeParams& params = OctreeParams());
+
+protected:
+	// not copyable, not assignable ...
+	SharedOctree(const SharedOctree&);
+	SharedOctree& operator=(const SharedOctree&);
+
+	/** \brief octree without snapshots, which is kept for the next rebuild. It is shared with the deleters of the
+   * snapshots, since snapshots may outlive the SharedOctree.
+   **/
+	struct Spare
+	{
+		Spare()
+		    : octree(0)
+		{
+		}
+
+		~Spare()
+		{
+			delete octree;
+		}
+
+		std::mutex mutex; // orders the release of the last snapshot before the reuse of the octree.
+		OctreeT* octree; // unused octree or 0.
+	};
+
+	/** \brief deleter of a published octree, which keeps the octree as spare or deletes it if there is a spare. **/
+	struct Recycle
+	{
+		void operator()(OctreeT* octree) const;
+
+		std::shared_ptr<Spare> spare;
+	};
+
+	/** @return octree for the next rebuild, which is the spare octree if there is one. **/
+	OctreeT* acquire();
+
+	/** \brief make octree the current octree, whose snapshots hand it back to the spare when released. **/
+	void publish(OctreeT* octree);
+
+	std::shared_ptr<const OctreeT> current_; // only accessed by the atomic functions for shared_ptr.
+	std::shared_ptr<Spare> spare_;
+	std::mutex rebuildMutex_; // serializes rebuilds; readers never lock it.
+};
+
+/** \brief Out-of-core construction of an octree from points given in chunks, which is written in the file format of
+ * Octree::save and can be queried by Octree::openMapped.
+ *
+ * All added points are spilled to a temporary file. On build, the points of an octant with more than
+ * maxPointsInMemory points are distributed to temporary files of its children and each subtree with at most
+ * maxPointsInMemory points is built in memory. Thus, only the octants and maxPointsInMemory points are kept in memory,
+ * while every point is read and written once for each distributed level. The resulting file can be opened by
+ * Octree::openMapped and contains the same octants (except for the unused child fields of leafs) and reordered points
+ * as the file written by Octree::save for the octree of all added points; the order and padding of the sections differ.
+ *
+ * Points are indexed by their position in the sequence of all added chunks. The file contains no centroids, i.e.,
+ * OctreeParams::levelOfDetail is ignored and Octree::levelOfDetail is not available for it.
+ */
+template <typename PointT, typename ContainerT = std::vector<PointT>>
+class OctreeBuilder
+{
+public:
+	/** \brief builder of the file at path; the temporary files are stored next to it. **/
+	OctreeBuilder(const std::string& path, const OctreeParams& params = OctreeParams(), uint32_t maxPointsInMemory = 1 << 24);
+	~OctreeBuilder();
+
+	/** \brief use the given bounding box for the root instead of the bounding box of all added points.
+   *
+   * Must be called before adding points; points outside of the bounding box are ignored.
+   **/
+	void setBounds(const float min[3], const float max[3]);
+
+	/** \brief append all points of pts, where points with non-finite coordinates are ignored.
+   * @return true, if the points were successfully written to the temporary file.
+   **/
+	bool add(const ContainerT& pts);
+
+	/** @return number of added points including the ignored points, i.e., the index of the next added point. **/
+	uint32_t size() const;
+
+	/** \brief build the octree of all added points and write it to the file, which empties the builder.
+   * @return true, if the file was successfully written.
+   **/
+	bool build();
+
+protected:
+	struct Record
+	{
+		float x, y, z;
+		uint32_t index;
+	};
+
+	typedef Octree<Record, std::vector<Record> > RecordOctree;
+	typedef typename RecordOctree::Octant Octant;
+	typedef typename RecordOctree::FileHeader FileHeader;
+
+	// not copyable, not assignable ...
+	OctreeBuilder(OctreeBuilder&);
+	OctreeBuilder& operator=(const OctreeBuilder&);
+
+	/** \brief build the octant octantIdx from the points of the given temporary file, which start at offset. **/
+	bool buildOctant(uint32_t file, uint32_t size, uint32_t octantIdx, float x, float y, float z, float extent, uint32_t offset);
+
+	/** \brief build the subtree of octant octantIdx in memory from records, which start at offset. **/
+	bool buildSubtree(std::vector<Record>& records, uint32_t octantIdx, float x, float y, float z, float extent, uint32_t offset);
+
+	/** \brief write n reordered points starting at offset to the coordinates and indexes of the file. **/
+	bool writePoints(const float* xs, const float* ys, const float* zs, const uint32_t* indexes, uint32_t n, uint32_t offset);
+
+	/** \brief remove all temporary files. **/
+	void removeSpills();
+
+	std::string spillPath(uint32_t file) const;
+
+	std::string path_;
+	OctreeParams params_;
+	uint32_t maxPointsInMemory_;
+
+	bool userBounds_;
+	float min_[3], max_[3];
+	uint32_t numAdded_; // index of the next added point.
+	uint32_t numPoints_; // number of points in the first temporary file.
+
+	std::ofstream spill_; // first temporary file with all added points.
+	uint32_t numSpills_; // number of used temporary files.
+	std::ofstream out_;
+	uint64_t coordinatesOffset_;
+	uint64_t indexesOffset_;
+	std::vector<Octant> octants_;
+};
+
+template <typename PointT, typename ContainerT>
+Octree<PointT, ContainerT>::Octant::Octant()
+    : x(0.0f)
+    , y(0.0f)
+    , z(0.0f)
+    , extent(0.0f)
+    , start(0)
+    , end(0)
+    , size(0)
+    , offset(0)
+    , firstChild(0)
+    , childMask(0)
+    , isLeaf(true)
+{
+	reserved[0] = reserved[1] = 0;
+}
+
+template <typename PointT, typename ContainerT>
+Octree<PointT, ContainerT>::Octree()
+    : root_(0)
+    , data_(0)
+    , xs_(0)
+    , ys_(0)
+    , zs_(0)
+    , permutation_(0)
+    , centroids_(0)
+    , mapping_(0)
+    , mappingSize_(0)
+    , threadStats_(collectQueryStats ? maxThreads() : 0)
+{
+}
+
+template <typename PointT, typename ContainerT>
+Octree<PointT, ContainerT>::~Octree()
+{
 	clear();
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::initialize(const ContainerT& pts, const OctreeParams& params)
+{
+	reset();
 	params_ = params;
+	// the quantized offsets replace the float copy of reorderPoints.
+	if (params_.quantizePoints)
+		params_.reorderPoints = false;
 
 	if (params_.copyPoints)
 		data_ = new ContainerT(pts);
@@ -312,58 +2123,47 @@ void Octree<PointT, ContainerT>::initialize(const ContainerT& pts, const OctreeP
 		data_ = &pts;
 
 	const uint32_t N = pts.size();
-	successors_ = std::vector<uint32_t>(N);
+	successors_.resize(N);
 
 	// determine axis-aligned bounding box.
-	float min[3], max[3];
-	min[0] = get<0>(pts[0]);
-	min[1] = get<1>(pts[0]);
-	min[2] = get<2>(pts[0]);
-	max[0] = min[0];
-	max[1] = min[1];
-	max[2] = min[2];
+	float minX = get<0>(pts[0]), minY = get<1>(pts[0]), minZ = get<2>(pts[0]);
+	float maxX = minX, maxY = minY, maxZ = minZ;
 
-	for (uint32_t i = 0; i < N; ++i)
+#pragma omp parallel for reduction(min : minX, minY, minZ) reduction(max : maxX, maxY, maxZ) if (params_.parallelBuild)
+	for (int32_t i = 0; i < int32_t(N); ++i)
 	{
 		// initially each element links simply to the following element.
 		successors_[i] = i + 1;
 
 		const PointT& p = pts[i];
 
-		if (get<0>(p) < min[0])
-			min[0] = get<0>(p);
-		if (get<1>(p) < min[1])
-			min[1] = get<1>(p);
-		if (get<2>(p) < min[2])
-			min[2] = get<2>(p);
-		if (get<0>(p) > max[0])
-			max[0] = get<0>(p);
-		if (get<1>(p) > max[1])
-			max[1] = get<1>(p);
-		if (get<2>(p) > max[2])
-			max[2] = get<2>(p);
-	}
-
-	float ctr[3] = { min[0], min[1], min[2] };
-
-	float maxextent = 0.5f * (max[0] - min[0]);
-	ctr[0] += maxextent;
-	for (uint32_t i = 1; i < 3; ++i)
-	{
-		float extent = 0.5f * (max[i] - min[i]);
-		ctr[i] += extent;
-		if (extent > maxextent)
-			maxextent = extent;
+		if (get<0>(p) < minX)
+			minX = get<0>(p);
+		if (get<1>(p) < minY)
+			minY = get<1>(p);
+		if (get<2>(p) < minZ)
+			minZ = get<2>(p);
+		if (get<0>(p) > maxX)
+			maxX = get<0>(p);
+		if (get<1>(p) > maxY)
+			maxY = get<1>(p);
+		if (get<2>(p) > maxZ)
+			maxZ = get<2>(p);
 	}
 
-	root_ = createOctant(ctr[0], ctr[1], ctr[2], maxextent, 0, N - 1, N);
+	const float min[3] = { minX, minY, minZ };
+	const float max[3] = { maxX, maxY, maxZ };
+	createRoot(min, max, 0, N - 1, N);
 }
 
 template <typename PointT, typename ContainerT>
 void Octree<PointT, ContainerT>::initialize(const ContainerT& pts, const std::vector<uint32_t>& indexes, const OctreeParams& params)
 {
-	clear();
+	reset();
 	params_ = params;
+	// the quantized offsets replace the float copy of reorderPoints.
+	if (params_.quantizePoints)
+		params_.reorderPoints = false;
 
 	if (params_.copyPoints)
 		data_ = new ContainerT(pts);
@@ -371,45 +2171,88 @@ void Octree<PointT, ContainerT>::initialize(const ContainerT& pts, const std::ve
 		data_ = &pts;
 
 	const uint32_t N = pts.size();
-	successors_ = std::vector<uint32_t>(N);
+	successors_.assign(N, 0);
 
 	if (indexes.size() == 0)
 		return;
 
 	// determine axis-aligned bounding box.
-	uint32_t lastIdx = indexes[0];
-	float min[3], max[3];
-	min[0] = get<0>(pts[lastIdx]);
-	min[1] = get<1>(pts[lastIdx]);
-	min[2] = get<2>(pts[lastIdx]);
-	max[0] = min[0];
-	max[1] = min[1];
-	max[2] = min[2];
+	const uint32_t M = indexes.size();
+	const uint32_t lastIdx = indexes[M - 1];
+	float minX = get<0>(pts[indexes[0]]), minY = get<1>(pts[indexes[0]]), minZ = get<2>(pts[indexes[0]]);
+	float maxX = minX, maxY = minY, maxZ = minZ;
 
-	for (uint32_t i = 1; i < indexes.size(); ++i)
+#pragma omp parallel for reduction(min : minX, minY, minZ) reduction(max : maxX, maxY, maxZ) if (params_.parallelBuild)
+	for (int32_t i = 1; i < int32_t(M); ++i)
 	{
 		uint32_t idx = indexes[i];
 		// initially each element links simply to the following element.
-		successors_[lastIdx] = idx;
+		successors_[indexes[i - 1]] = idx;
 
 		const PointT& p = pts[idx];
 
-		if (get<0>(p) < min[0])
-			min[0] = get<0>(p);
-		if (get<1>(p) < min[1])
-			min[1] = get<1>(p);
-		if (get<2>(p) < min[2])
-			min[2] = get<2>(p);
-		if (get<0>(p) > max[0])
-			max[0] = get<0>(p);
-		if (get<1>(p) > max[1])
-			max[1] = get<1>(p);
-		if (get<2>(p) > max[2])
-			max[2] = get<2>(p);
+		if (get<0>(p) < minX)
+			minX = get<0>(p);
+		if (get<1>(p) < minY)
+			minY = get<1>(p);
+		if (get<2>(p) < minZ)
+			minZ = get<2>(p);
+		if (get<0>(p) > maxX)
+			maxX = get<0>(p);
+		if (get<1>(p) > maxY)
+			maxY = get<1>(p);
+		if (get<2>(p) > maxZ)
+			maxZ = get<2>(p);
+	}
+
+	const float min[3] = { minX, minY, minZ };
+	const float max[3] = { maxX, maxY, maxZ };
+	createRoot(min, max, indexes[0], lastIdx, M);
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::clear()
+{
+	reset();
+	std::vector<Octant>().swap(octants_); // releases all octants at once.
+	std::vector<uint32_t>().swap(successors_);
+	std::vector<float>().swap(coordinates_);
+	std::vector<uint32_t>().swap(indexes_);
+	std::vector<int16_t>().swap(quantized_);
+	std::vector<float>().swap(centroidCoordinates_);
+}
 
-		lastIdx = idx;
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::reset()
+{
+	if (params_.copyPoints)
+		delete data_;
+	root_ = 0;
+	data_ = 0;
+	octants_.clear();
+	successors_.clear();
+	coordinates_.clear();
+	indexes_.clear();
+	quantized_.clear();
+	centroidCoordinates_.clear();
+	xs_ = ys_ = zs_ = 0;
+	permutation_ = 0;
+	centroids_ = 0;
+
+	if (mapping_ != 0)
+	{
+#if defined(__unix__) || defined(__APPLE__)
+		munmap(const_cast<char*>(mapping_), mappingSize_);
+#endif
+		std::vector<uint64_t>().swap(fileBuffer_);
+		mapping_ = 0;
+		mappingSize_ = 0;
 	}
+}
 
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::createRoot(const float min[3], const float max[3], uint32_t startIdx, uint32_t endIdx, uint32_t size)
+{
 	float ctr[3] = { min[0], min[1], min[2] };
 
 	float maxextent = 0.5f * (max[0] - min[0]);
@@ -422,510 +2265,4403 @@ void Octree<PointT, ContainerT>::initialize(const ContainerT& pts, const std::ve
 			maxextent = extent;
 	}
 
-	root_ = createOctant(ctr[0], ctr[1], ctr[2], maxextent, indexes[0], lastIdx, indexes.size());
+	octants_.reserve(estimateOctants(size));
+	octants_.resize(1);
+	if (params_.mortonBuild)
+	{
+		createMortonRoot(ctr[0], ctr[1], ctr[2], maxextent, startIdx, size);
+	}
+	else
+	{
+#pragma omp parallel if (params_.parallelBuild && size > params_.parallelThreshold)
+#pragma omp single
+		createOctant(octants_, 0, ctr[0], ctr[1], ctr[2], maxextent, startIdx, endIdx, size);
+	}
+	root_ = &octants_[0];
+
+	updatePoints();
 }
 
 template <typename PointT, typename ContainerT>
-void Octree<PointT, ContainerT>::clear()
+void Octree<PointT, ContainerT>::reorderPoints()
 {
-	delete root_;
-	if (params_.copyPoints)
-		delete data_;
-	root_ = 0;
-	data_ = 0;
-	successors_.clear();
+	reorderPoints(octants_, coordinates_, indexes_);
+
+	const uint32_t N = root_->size;
+	xs_ = &coordinates_[0];
+	ys_ = xs_ + N;
+	zs_ = ys_ + N;
+	permutation_ = &indexes_[0];
 }
 
 template <typename PointT, typename ContainerT>
-bool Octree<PointT, ContainerT>::getOctantIndicesAtSpecifiedDepth(int depth, std::vector<std::vector<uint32_t>>& indicesList)
+void Octree<PointT, ContainerT>::reorderPoints(std::vector<Octant>& octants,
+                                               std::vector<float>& coordinates,
+                                               std::vector<uint32_t>& indexes) const
 {
-	if (depth < 1 || !root_)
-	{
-		return false;
-	}
-	octantList_.clear();
-	indicesList.clear();
-	getOctantChild(root_, 1, depth, octantList_);
-	indicesList.resize(octantList_.size());
-#pragma omp parallel for
-	for (int k = 0; k < octantList_.size(); ++k)
+	const uint32_t N = octants[0].size;
+	coordinates.resize(3 * N);
+	indexes.resize(N);
+	float* xs = &coordinates[0];
+	float* ys = xs + N;
+	float* zs = ys + N;
+	assignOffsets(octants);
+
+	// leafs cover disjoint ranges; therefore we can copy the points of each leaf independently.
+	const ContainerT& points = *data_;
+#pragma omp parallel for if (params_.parallelBuild)
+	for (int32_t i = 0; i < int32_t(octants.size()); ++i)
 	{
-		Octant* node = octantList_[k];
-		if (!node || node->size < 1)
-		{
+		const Octant& octant = octants[i];
+		if (!octant.isLeaf)
 			continue;
-		}
-		std::vector<uint32_t>& indices = indicesList[k];
-		indices.reserve(node->size);
-		uint32_t idx = node->start;
-		for (uint32_t i = 0; i < node->size; ++i)
+
+		uint32_t idx = octant.start;
+		for (uint32_t k = octant.offset; k < octant.offset + octant.size; ++k)
 		{
-			indices.push_back(idx);
+			const PointT& p = points[idx];
+			xs[k] = get<0>(p);
+			ys[k] = get<1>(p);
+			zs[k] = get<2>(p);
+			indexes[k] = idx;
 			idx = successors_[idx];
 		}
 	}
-
-	return !indicesList.empty();
 }
 
 template <typename PointT, typename ContainerT>
-
-bool Octree<PointT, ContainerT>::radiusSearchLimitInOneOctant(int octantIndex, const PointT& query, float radius, std::vector<uint32_t>& resultIndices) const
+void Octree<PointT, ContainerT>::assignOffsets(std::vector<Octant>& octants)
 {
-	resultIndices.clear();
-	if (octantList_.size() < (octantIndex + 1))
-	{
-		return false;
-	}
-	if (!inside(query, radius, octantList_[octantIndex]))
+	// children are always stored behind their parent, thus a single pass determines the offsets in the point list.
+	octants[0].offset = 0;
+	for (uint32_t i = 0; i < octants.size(); ++i)
 	{
-		float sqrRadius = radius * radius;
-		for (int i = 0; i < octantList_.size(); ++i)
+		const Octant& octant = octants[i];
+		if (octant.isLeaf)
+			continue;
+
+		uint32_t offset = octant.offset;
+		const uint32_t lastChild = octant.firstChild + bitCount(octant.childMask);
+		for (uint32_t c = octant.firstChild; c < lastChild; ++c)
 		{
-			if (i != octantIndex && overlaps(query, radius, sqrRadius, octantList_[i]))
-			{
-				return false;
-			}
+			octants[c].offset = offset;
+			offset += octants[c].size;
 		}
 	}
-	radiusNeighbors(octantList_[octantIndex], query, radius, radius * radius, resultIndices);
-	return true;
 }
 
 template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::updatePoints()
+{
+	if (params_.reorderPoints)
+		reorderPoints();
+	else if (params_.quantizePoints)
+		quantizePoints();
+	if (params_.levelOfDetail)
+		computeCentroids();
+}
 
-bool Octree<PointT, ContainerT>::radiusSearchLimitInOneOctant(int octantIndex,
-                                                              const PointT& query,
-                                                              float radius,
-                                                              std::vector<uint32_t>& resultIndices,
-                                                              std::vector<float>& distances) const
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::quantizePoints()
 {
-	resultIndices.clear();
-	distances.clear();
-	if (octantList_.size() < (octantIndex + 1))
-	{
-		return false;
-	}
-	if (!inside(query, radius, octantList_[octantIndex]))
+	const uint32_t N = root_->size;
+	quantized_.resize(3 * N);
+	indexes_.resize(N);
+	assignOffsets(octants_);
+
+	const ContainerT& points = *data_;
+#pragma omp parallel for if (params_.parallelBuild)
+	for (int32_t i = 0; i < int32_t(octants_.size()); ++i)
 	{
-		float sqrRadius = radius * radius;
-		for (int i = 0; i < octantList_.size(); ++i)
+		const Octant& octant = octants_[i];
+		if (!octant.isLeaf)
+			continue;
+
+		// points are inside their leaf up to rounding, which is covered by clamping.
+		const float scale = (octant.extent > 0.0f) ? quantizationLevels / octant.extent : 0.0f;
+		const float center[3] = { octant.x, octant.y, octant.z };
+		uint32_t idx = octant.start;
+		for (uint32_t k = octant.offset; k < octant.offset + octant.size; ++k)
 		{
-			if (i != octantIndex && overlaps(query, radius, sqrRadius, octantList_[i]))
+			const PointT& p = points[idx];
+			const float coordinates[3] = { get<0>(p), get<1>(p), get<2>(p) };
+			for (uint32_t a = 0; a < 3; ++a)
 			{
-				return false;
+				const float q = std::floor((coordinates[a] - center[a]) * scale + 0.5f);
+				quantized_[3 * k + a] = int16_t(std::max(-float(quantizationLevels), std::min(float(quantizationLevels), q)));
 			}
+			indexes_[k] = idx;
+			idx = successors_[idx];
 		}
 	}
-	radiusNeighbors(octantList_[octantIndex], query, radius, radius * radius, resultIndices, distances);
-	return true;
+	permutation_ = &indexes_[0];
 }
 
 template <typename PointT, typename ContainerT>
-void Octree<PointT, ContainerT>::getOctantChild(Octant* node, int depth, int targetDepth, std::vector<Octant*>& octantList)
+template <typename Distance>
+void Octree<PointT, ContainerT>::quantizedRadiusNeighbors(const Octant* octant,
+                                                          const PointT& query,
+                                                          float radius,
+                                                          float sqrRadius,
+                                                          std::vector<uint32_t>& resultIndices,
+                                                          std::vector<float>* distances) const
 {
-	for (int i = 0; i < 8; ++i)
+	// decoded points differ by at most half a step per axis, i.e., 1.5 steps in all norms, and the rounding errors are
+	// far below the relative margin. Points inside the inner sphere are neighbors and outside the outer sphere not.
+	const float step = octant->extent / quantizationLevels;
+	const float qx = get<0>(query) - octant->x, qy = get<1>(query) - octant->y, qz = get<2>(query) - octant->z;
+	const float margin = 1.5f * step + 1e-5f * (std::abs(qx) + std::abs(qy) + std::abs(qz) + 3.0f * octant->extent);
+	const float sqrInner = (distances == 0 && radius > margin) ? Distance::sqr(radius - margin) : -1.0f;
+	const float sqrOuter = Distance::sqr(radius + margin);
+
+	const ContainerT& points = *data_;
+	const int16_t* quantized = &quantized_[3 * octant->offset];
+	const uint32_t* indexes = permutation_ + octant->offset;
+	for (uint32_t k = 0; k < octant->size; ++k)
 	{
-		if (!node->child[i])
-		{
+		const float dist =
+		    Distance::norm(qx - step * quantized[3 * k], qy - step * quantized[3 * k + 1], qz - step * quantized[3 * k + 2]);
+		if (!(dist < sqrOuter))
 			continue;
-		}
-		if (depth == targetDepth)
+		if (dist < sqrInner)
 		{
-			if (node->child[i]->size > 0)
-			{
-				octantList.push_back(node->child[i]);
-			}
+			resultIndices.push_back(indexes[k]);
+			continue;
 		}
-		else
+
+		const float exact = Distance::compute(query, points[indexes[k]]);
+		if (exact < sqrRadius)
 		{
-			getOctantChild(node->child[i], depth + 1, targetDepth, octantList);
+			resultIndices.push_back(indexes[k]);
+			if (distances != 0)
+				distances->push_back(exact);
 		}
 	}
-	return;
 }
 
 template <typename PointT, typename ContainerT>
-typename Octree<PointT, ContainerT>::Octant* Octree<PointT, ContainerT>::createOctant(float x,
-                                                                                      float y,
-                                                                                      float z,
-                                                                                      float extent,
-                                                                                      uint32_t startIdx,
-                                                                                      uint32_t endIdx,
-                                                                                      uint32_t size)
+void Octree<PointT, ContainerT>::computeCentroids()
 {
-	// For a leaf we don't have to change anything; points are already correctly linked or correctly reordered.
-	Octant* octant = new Octant;
+	std::vector<double> sums;
+	octantSums(sums);
 
-	octant->isLeaf = true;
+	centroidCoordinates_.resize(sums.size());
+	for (uint32_t i = 0; i < octants_.size(); ++i)
+	{
+		for (uint32_t d = 0; d < 3; ++d)
+			centroidCoordinates_[3 * i + d] = sums[3 * i + d] / octants_[i].size;
+	}
+	centroids_ = &centroidCoordinates_[0];
+}
 
-	octant->x = x;
-	octant->y = y;
-	octant->z = z;
-	octant->extent = extent;
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::save(const std::string& path) const
+{
+	if (mapping_ != 0 || !littleEndian())
+		return false;
 
-	octant->start = startIdx;
-	octant->end = endIdx;
-	octant->size = size;
+	std::vector<Octant> octants;
+	std::vector<float> coordinates;
+	std::vector<uint32_t> indexes;
+	const uint32_t numPoints = (root_ != 0) ? root_->size : 0;
+	if (root_ != 0 && !params_.reorderPoints)
+	{
+		octants = octants_;
+		reorderPoints(octants, coordinates, indexes);
+	}
+	const std::vector<Octant>& savedOctants = params_.reorderPoints ? octants_ : octants;
+
+	FileHeader header;
+	std::memset(&header, 0, sizeof(FileHeader));
+	std::memcpy(header.magic, "UNIBNOCT", 8);
+	header.version = 2;
+	header.byteOrder = 0x01020304;
+	header.octantSize = sizeof(Octant);
+	header.bucketSize = params_.bucketSize;
+	header.minExtent = params_.minExtent;
+	header.numOctants = savedOctants.size();
+	header.numPoints = numPoints;
+	header.octantsOffset = (sizeof(FileHeader) + 63) & ~uint64_t(63);
+	header.coordinatesOffset = (header.octantsOffset + uint64_t(header.numOctants) * sizeof(Octant) + 63) & ~uint64_t(63);
+	header.indexesOffset = (header.coordinatesOffset + 3 * uint64_t(numPoints) * sizeof(float) + 63) & ~uint64_t(63);
+	header.fileSize = header.indexesOffset + uint64_t(numPoints) * sizeof(uint32_t);
+	if (centroids_ != 0)
+	{
+		header.centroidsOffset = (header.fileSize + 63) & ~uint64_t(63);
+		header.fileSize = header.centroidsOffset + 3 * uint64_t(header.numOctants) * sizeof(float);
+	}
 
-	static const float factor[] = { -0.5f, 0.5f };
+	std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out.is_open())
+		return false;
 
-	// subdivide subset of points and re-link points according to Morton codes
-	if (size > params_.bucketSize && extent > 2 * params_.minExtent)
+	const char padding[64] = { 0 };
+	out.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+	out.write(padding, header.octantsOffset - sizeof(FileHeader));
+	if (header.numOctants > 0)
+		out.write(reinterpret_cast<const char*>(&savedOctants[0]), uint64_t(header.numOctants) * sizeof(Octant));
+	out.write(padding, header.coordinatesOffset - header.octantsOffset - uint64_t(header.numOctants) * sizeof(Octant));
+	if (numPoints > 0)
 	{
-		octant->isLeaf = false;
+		// the x, y and z arrays are always stored consecutively.
+		out.write(reinterpret_cast<const char*>(params_.reorderPoints ? xs_ : &coordinates[0]), 3 * uint64_t(numPoints) * sizeof(float));
+		out.write(padding, header.indexesOffset - header.coordinatesOffset - 3 * uint64_t(numPoints) * sizeof(float));
+		out.write(reinterpret_cast<const char*>(params_.reorderPoints ? permutation_ : &indexes[0]), uint64_t(numPoints) * sizeof(uint32_t));
+	}
+	if (centroids_ != 0)
+	{
+		// the saved octants have the same order as octants_.
+		out.write(padding, header.centroidsOffset - header.indexesOffset - uint64_t(numPoints) * sizeof(uint32_t));
+		out.write(reinterpret_cast<const char*>(centroids_), 3 * uint64_t(header.numOctants) * sizeof(float));
+	}
+	out.close();
 
-		const ContainerT& points = *data_;
-		std::vector<uint32_t> childStarts(8, 0);
-		std::vector<uint32_t> childEnds(8, 0);
-		std::vector<uint32_t> childSizes(8, 0);
+	return out.good();
+}
 
-		// re-link disjoint child subsets...
-		uint32_t idx = startIdx;
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::openMapped(const std::string& path)
+{
+	clear();
 
-		for (uint32_t i = 0; i < size; ++i)
-		{
-			const PointT& p = points[idx];
+#if defined(__unix__) || defined(__APPLE__)
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
 
-			// determine Morton code for each point...
-			uint32_t mortonCode = 0;
-			if (get<0>(p) > x)
-				mortonCode |= 1;
-			if (get<1>(p) > y)
-				mortonCode |= 2;
-			if (get<2>(p) > z)
-				mortonCode |= 4;
+	struct stat status;
+	void* mapping = MAP_FAILED;
+	if (fstat(fd, &status) == 0 && status.st_size > 0)
+		mapping = mmap(0, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd); // the mapping stays valid without the file descriptor.
+	if (mapping == MAP_FAILED)
+		return false;
 
-			// set child starts and update successors...
-			if (childSizes[mortonCode] == 0)
-				childStarts[mortonCode] = idx;
-			else
-				successors_[childEnds[mortonCode]] = idx;
-			childSizes[mortonCode] += 1;
+	mapping_ = static_cast<const char*>(mapping);
+	mappingSize_ = status.st_size;
+#else
+	std::ifstream in(path.c_str(), std::ios::binary | std::ios::ate);
+	if (!in.is_open())
+		return false;
 
-			childEnds[mortonCode] = idx;
-			idx = successors_[idx];
-		}
+	const uint64_t size = in.tellg();
+	fileBuffer_.resize((size + 7) / 8 + 1);
+	in.seekg(0);
+	in.read(reinterpret_cast<char*>(&fileBuffer_[0]), size);
+	if (!in)
+	{
+		std::vector<uint64_t>().swap(fileBuffer_);
+		return false;
+	}
 
-		// now, we can create the child nodes...
-		float childExtent = 0.5f * extent;
-		bool firsttime = true;
-		uint32_t lastChildIdx = 0;
-		for (uint32_t i = 0; i < 8; ++i)
-		{
-			if (childSizes[i] == 0)
-				continue;
+	mapping_ = reinterpret_cast<const char*>(&fileBuffer_[0]);
+	mappingSize_ = size;
+#endif
+
+	if (!attachMapping())
+	{
+		clear();
+		return false;
+	}
 
-			float childX = x + factor[(i & 1) > 0] * extent;
-			float childY = y + factor[(i & 2) > 0] * extent;
-			float childZ = z + factor[(i & 4) > 0] * extent;
+	return true;
+}
 
-			octant->child[i] = createOctant(childX, childY, childZ, childExtent, childStarts[i], childEnds[i], childSizes[i]);
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::attachMapping()
+{
+	if (mappingSize_ < sizeof(FileHeader) || !littleEndian())
+		return false;
 
-			if (firsttime)
-				octant->start = octant->child[i]->start;
-			else
-				successors_[octant->child[lastChildIdx]->end] =
-				    octant->child[i]->start; // we have to ensure that also the child ends link to the next child start.
+	const FileHeader& header = *reinterpret_cast<const FileHeader*>(mapping_);
+	if (std::memcmp(header.magic, "UNIBNOCT", 8) != 0 || header.version < 1 || header.version > 2 ||
+	    header.byteOrder != 0x01020304)
+		return false;
+	// files of version 1 have no centroids and the shorter header, whose padding is not read.
+	const uint64_t centroidsOffset = (header.version >= 2) ? header.centroidsOffset : 0;
+	if (centroidsOffset != 0 && (centroidsOffset % 64 != 0 || centroidsOffset < sizeof(FileHeader) ||
+	                             centroidsOffset + 3 * uint64_t(header.numOctants) * sizeof(float) > header.fileSize))
+		return false;
+	if (header.octantSize != sizeof(Octant) || header.fileSize > mappingSize_)
+		return false;
+	if (header.octantsOffset % 64 != 0 || header.coordinatesOffset % 64 != 0 || header.indexesOffset % 64 != 0)
+		return false;
+	if (header.octantsOffset < sizeof(FileHeader) || header.coordinatesOffset < sizeof(FileHeader) ||
+	    header.indexesOffset < sizeof(FileHeader))
+		return false;
+	if (header.octantsOffset + uint64_t(header.numOctants) * sizeof(Octant) > header.fileSize ||
+	    header.coordinatesOffset + 3 * uint64_t(header.numPoints) * sizeof(float) > header.fileSize ||
+	    header.indexesOffset + uint64_t(header.numPoints) * sizeof(uint32_t) > header.fileSize)
+		return false;
 
-			lastChildIdx = i;
-			octant->end = octant->child[i]->end;
-			firsttime = false;
-		}
+	// children and point ranges must be inside the file, such that queries never access memory outside of it.
+	const Octant* octants = reinterpret_cast<const Octant*>(mapping_ + header.octantsOffset);
+	for (uint32_t i = 0; i < header.numOctants; ++i)
+	{
+		const Octant& octant = octants[i];
+		if (uint64_t(octant.offset) + octant.size > header.numPoints)
+			return false;
+		if (!octant.isLeaf && (octant.firstChild <= i || uint64_t(octant.firstChild) + bitCount(octant.childMask) > header.numOctants))
+			return false;
+	}
+	if (header.numOctants > 0 && octants[0].size != header.numPoints)
+		return false;
+
+	params_ = OctreeParams(header.bucketSize, false, header.minExtent);
+	params_.reorderPoints = true;
+	root_ = (header.numOctants > 0) ? octants : 0;
+	xs_ = reinterpret_cast<const float*>(mapping_ + header.coordinatesOffset);
+	ys_ = xs_ + header.numPoints;
+	zs_ = ys_ + header.numPoints;
+	permutation_ = reinterpret_cast<const uint32_t*>(mapping_ + header.indexesOffset);
+	if (centroidsOffset != 0)
+	{
+		params_.levelOfDetail = true;
+		centroids_ = reinterpret_cast<const float*>(mapping_ + centroidsOffset);
 	}
 
-	return octant;
+	return true;
 }
 
 template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::littleEndian()
+{
+	const uint32_t one = 1;
+	return *reinterpret_cast<const char*>(&one) == 1;
+}
 
-void Octree<PointT, ContainerT>::radiusNeighbors(const Octant* octant, const PointT& query, float radius, float sqrRadius, std::vector<uint32_t>& resultIndices)
-    const
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::insert(const ContainerT& pts, uint32_t first, uint32_t last)
 {
-	const ContainerT& points = *data_;
+	if (mapping_ != 0)
+		return;
 
-	// if search ball S(q,r) contains octant, simply add point indexes.
-	if (contains(query, sqrRadius, octant))
+	if (root_ == 0)
 	{
-		uint32_t idx = octant->start;
-		for (uint32_t i = 0; i < octant->size; ++i)
+		// initialize takes all points, i.e., the non-finite points are removed here.
+		std::vector<uint32_t> indexes;
+		for (uint32_t i = first; i < last; ++i)
 		{
-			resultIndices.push_back(idx);
-			idx = successors_[idx];
+			const PointT& p = pts[i];
+			if (std::isfinite(get<0>(p)) && std::isfinite(get<1>(p)) && std::isfinite(get<2>(p)))
+				indexes.push_back(i);
 		}
-
-		return; // early pruning.
+		initialize(pts, indexes, params_);
+		return;
 	}
 
-	if (octant->isLeaf)
+	if (params_.copyPoints)
 	{
-		uint32_t idx = octant->start;
-		for (uint32_t i = 0; i < octant->size; ++i)
-		{
-			//const PointT& p = points[idx];
-			//float dist = Distance::compute(query, p);
-			PointT tmp = query - points[idx];
-			float dist = get<0>(tmp) * get<0>(tmp) + get<1>(tmp) * get<1>(tmp) + get<2>(tmp) * get<2>(tmp);
-			if (dist < sqrRadius)
-				resultIndices.push_back(idx);
-			idx = successors_[idx];
-		}
-
-		return;
+		delete data_;
+		data_ = new ContainerT(pts);
 	}
+	else
+		data_ = &pts;
 
-	// check whether child nodes are in range.
-	for (uint32_t c = 0; c < 8; ++c)
+	if (successors_.size() < pts.size())
+		successors_.resize(pts.size());
+
+	std::vector<uint32_t> indexes;
+	indexes.reserve(last - first);
+	for (uint32_t i = first; i < last; ++i)
 	{
-		if (octant->child[c] == 0)
-			continue;
-		if (!overlaps(query, radius, sqrRadius, octant->child[c]))
+		const PointT& p = pts[i];
+		if (!std::isfinite(get<0>(p)) || !std::isfinite(get<1>(p)) || !std::isfinite(get<2>(p)))
 			continue;
-		radiusNeighbors(octant->child[c], query, radius, sqrRadius, resultIndices);
+		growRoot(p);
+		indexes.push_back(i);
 	}
+
+	// subsequent points in Morton order mostly descend to the same octants.
+	sortIndexesByMortonCode(indexes);
+	std::vector<uint32_t> path;
+	for (uint32_t i = 0; i < indexes.size(); ++i)
+		insertPoint(indexes[i], path);
+
+	compactOctants();
+	updatePoints();
 }
 
 template <typename PointT, typename ContainerT>
-
-void Octree<PointT, ContainerT>::radiusNeighbors(const Octant* octant,
-                                                 const PointT& query,
-                                                 float radius,
-                                                 float sqrRadius,
-                                                 std::vector<uint32_t>& resultIndices,
-                                                 std::vector<float>& distances) const
+uint32_t Octree<PointT, ContainerT>::remove(const std::vector<uint32_t>& indexes)
 {
-	const ContainerT& points = *data_;
+	if (root_ == 0 || mapping_ != 0)
+		return 0;
 
-	// if search ball S(q,r) contains octant, simply add point indexes and compute squared distances.
-	if (contains(query, sqrRadius, octant))
+	std::vector<uint32_t> sorted;
+	sorted.reserve(indexes.size());
+	for (uint32_t i = 0; i < indexes.size(); ++i)
 	{
-		uint32_t idx = octant->start;
-		for (uint32_t i = 0; i < octant->size; ++i)
-		{
-			resultIndices.push_back(idx);
-			//distances.push_back(Distance::compute(query, points[idx]));
-			PointT tmp = query - points[idx];
-			float dist = get<0>(tmp) * get<0>(tmp) + get<1>(tmp) * get<1>(tmp) + get<2>(tmp) * get<2>(tmp);
-			distances.push_back(dist);
-			idx = successors_[idx];
-		}
-
-		return; // early pruning.
+		if (indexes[i] < successors_.size())
+			sorted.push_back(indexes[i]);
 	}
+	sortIndexesByMortonCode(sorted);
 
-	if (octant->isLeaf)
+	uint32_t removed = 0;
+	std::vector<uint32_t> path;
+	for (uint32_t i = 0; i < sorted.size() && root_ != 0; ++i)
 	{
-		uint32_t idx = octant->start;
-		for (uint32_t i = 0; i < octant->size; ++i)
-		{
-			//const PointT& p = points[idx];
-			//float dist = Distance::compute(query, p);
-			PointT tmp = query - points[idx];
-			float dist = get<0>(tmp) * get<0>(tmp) + get<1>(tmp) * get<1>(tmp) + get<2>(tmp) * get<2>(tmp);
-			if (dist < sqrRadius)
-			{
-				resultIndices.push_back(idx);
-				distances.push_back(dist);
-			}
-			idx = successors_[idx];
-		}
-
-		return;
+		if (removePoint(sorted[i], path))
+			removed += 1;
 	}
 
-	// check whether child nodes are in range.
-	for (uint32_t c = 0; c < 8; ++c)
+	if (root_ != 0)
 	{
-		if (octant->child[c] == 0)
-			continue;
-		if (!overlaps(query, radius, sqrRadius, octant->child[c]))
-			continue;
-		radiusNeighbors(octant->child[c], query, radius, sqrRadius, resultIndices, distances);
+		compactOctants();
+		updatePoints();
+	}
+	else
+	{
+		coordinates_.clear();
+		indexes_.clear();
+		quantized_.clear();
+		centroidCoordinates_.clear();
+		xs_ = ys_ = zs_ = 0;
+		permutation_ = 0;
+		centroids_ = 0;
 	}
+
+	return removed;
 }
 
 template <typename PointT, typename ContainerT>
-
-void Octree<PointT, ContainerT>::radiusNeighbors(const PointT& query, float radius, std::vector<uint32_t>& resultIndices) const
+void Octree<PointT, ContainerT>::insertPoint(uint32_t idx, std::vector<uint32_t>& path)
 {
-	resultIndices.clear();
-	if (root_ == 0)
-		return;
+	const PointT& p = (*data_)[idx];
 
-	float sqrRadius = radius * radius; // "squared" radius
-	radiusNeighbors(root_, query, radius, sqrRadius, resultIndices);
-}
+	path.clear();
+	path.push_back(0);
+	bool newLeaf = false;
+	while (!octants_[path.back()].isLeaf)
+	{
+		const Octant& octant = octants_[path.back()];
+		const uint32_t code = childCode(octant.x, octant.y, octant.z, p);
 
-template <typename PointT, typename ContainerT>
+		if ((octant.childMask & (1 << code)) == 0)
+		{
+			// the point becomes the only point of a new leaf, which is linked in order of the children.
+			uint32_t pred = std::numeric_limits<uint32_t>::max();
+			if ((octant.childMask & ((1 << code) - 1)) == 0)
+				pred = predecessor(path);
+			linkChild(path, addChild(path.back(), code, idx), pred);
+			newLeaf = true;
+			break;
+		}
 
-void Octree<PointT, ContainerT>::radiusNeighbors(const PointT& query, float radius, std::vector<uint32_t>& resultIndices, std::vector<float>& distances) const
-{
-	resultIndices.clear();
-	distances.clear();
-	if (root_ == 0)
-		return;
+		path.push_back(octant.firstChild + bitCount(octant.childMask & ((1 << code) - 1)));
+	}
+
+	if (!newLeaf)
+	{
+		linkBehind(path, idx, octants_[path.back()].end);
+		const Octant& leaf = octants_[path.back()];
+		if (leaf.size > params_.bucketSize && leaf.extent > 2 * params_.minExtent)
+			splitLeaf(path);
+	}
 
-	float sqrRadius = radius * radius; // "squared" radius
-	radiusNeighbors(root_, query, radius, sqrRadius, resultIndices, distances);
+	// a grown root might contain less than bucketSize points.
+	mergeOctants(path);
 }
 
 template <typename PointT, typename ContainerT>
-
-bool Octree<PointT, ContainerT>::overlaps(const PointT& query, float radius, float sqRadius, const Octant* o)
+bool Octree<PointT, ContainerT>::removePoint(uint32_t idx, std::vector<uint32_t>& path)
 {
-	// we exploit the symmetry to reduce the test to testing if its inside the Minkowski sum around the positive quadrant.
-	float x = get<0>(query) - o->x;
-	float y = get<1>(query) - o->y;
-	float z = get<2>(query) - o->z;
-
-	x = std::abs(x);
-	y = std::abs(y);
-	z = std::abs(z);
-
-	float maxdist = radius + o->extent;
-
-	// Completely outside, since q' is outside the relevant area.
-	if (x > maxdist || y > maxdist || z > maxdist)
+	path.clear();
+	uint32_t pred = std::numeric_limits<uint32_t>::max();
+	if (!findLeaf(0, (*data_)[idx], idx, path, pred))
 		return false;
 
-	int32_t num_less_extent = (x < o->extent) + (y < o->extent) + (z < o->extent);
+	if (pred == std::numeric_limits<uint32_t>::max())
+		pred = predecessor(path);
 
-	// Checking different cases:
+	// unlink the point; the octants starting or ending with the point start with its successor or end with its
+	// predecessor, which are both inside the octants.
+	const uint32_t next = successors_[idx];
+	if (pred != std::numeric_limits<uint32_t>::max())
+		successors_[pred] = next;
 
-	// a. inside the surface region of the octant.
-	if (num_less_extent > 1)
+	uint32_t numOccupied = 0;
+	for (uint32_t i = 0; i < path.size(); ++i)
+	{
+		Octant& octant = octants_[path[i]];
+		octant.size -= 1;
+		if (octant.size == 0)
+			continue;
+		numOccupied = i + 1;
+		if (octant.start == idx)
+			octant.start = next;
+		if (octant.end == idx)
+			octant.end = pred;
+	}
+
+	if (numOccupied == 0)
+	{
+		// the octree contains no points anymore.
+		std::vector<Octant>().swap(octants_);
+		root_ = 0;
 		return true;
+	}
 
-	// b. checking the corner region && edge region.
-	x = std::max(x - o->extent, 0.0f);
-	y = std::max(y - o->extent, 0.0f);
-	z = std::max(z - o->extent, 0.0f);
+	if (numOccupied < path.size())
+	{
+		removeChild(path[numOccupied - 1], path[numOccupied]);
+		path.resize(numOccupied);
+	}
+	mergeOctants(path);
 
-	return ((x * x + y * y + z * z) < sqRadius);
+	return true;
 }
 
 template <typename PointT, typename ContainerT>
-
-bool Octree<PointT, ContainerT>::contains(const PointT& query, float sqRadius, const Octant* o)
+void Octree<PointT, ContainerT>::sortIndexesByMortonCode(std::vector<uint32_t>& indexes) const
 {
-	// we exploit the symmetry to reduce the test to test
-	// whether the farthest corner is inside the search ball.
-	float x = get<0>(query) - o->x;
-	float y = get<1>(query) - o->y;
-	float z = get<2>(query) - o->z;
-
-	x = std::abs(x);
-	y = std::abs(y);
-	z = std::abs(z);
-	// reminder: (x, y, z) - (-e, -e, -e) = (x, y, z) + (e, e, e)
-	x += o->extent;
-	y += o->extent;
-	z += o->extent;
+	const ContainerT& points = *data_;
+	std::vector<std::pair<uint64_t, uint32_t> > codes(indexes.size());
+	for (uint32_t i = 0; i < indexes.size(); ++i)
+	{
+		const PointT& p = points[indexes[i]];
+		codes[i] = std::make_pair(mortonCode(get<0>(p), get<1>(p), get<2>(p)), indexes[i]);
+	}
+	std::sort(codes.begin(), codes.end());
 
-	return ((x * x + y * y + z * z) < sqRadius);
+	for (uint32_t i = 0; i < indexes.size(); ++i)
+		indexes[i] = codes[i].second;
 }
 
 template <typename PointT, typename ContainerT>
-
-int32_t Octree<PointT, ContainerT>::findNeighbor(const PointT& query, float minDistance) const
+void Octree<PointT, ContainerT>::growRoot(const PointT& p)
 {
-	float maxDistance = std::numeric_limits<float>::infinity();
-	int32_t resultIndex = -1;
-	if (root_ == 0)
-		return resultIndex;
+	while (true)
+	{
+		Octant& root = octants_[0];
+		const float dx = get<0>(p) - root.x, dy = get<1>(p) - root.y, dz = get<2>(p) - root.z;
+		if (std::abs(dx) <= root.extent && std::abs(dy) <= root.extent && std::abs(dz) <= root.extent)
+			return;
 
-	findNeighbor(root_, query, minDistance, maxDistance, resultIndex);
+		if (root.isLeaf)
+		{
+			// without children, we can simply enlarge the root as in createRoot.
+			const float min[3] = { std::min(root.x - root.extent, get<0>(p)), std::min(root.y - root.extent, get<1>(p)),
+				                   std::min(root.z - root.extent, get<2>(p)) };
+			const float max[3] = { std::max(root.x + root.extent, get<0>(p)), std::max(root.y + root.extent, get<1>(p)),
+				                   std::max(root.z + root.extent, get<2>(p)) };
+			float extent = 0.0f;
+			for (uint32_t i = 0; i < 3; ++i)
+				extent = std::max(extent, 0.5f * (max[i] - min[i]));
+			root.x = min[0] + 0.5f * (max[0] - min[0]);
+			root.y = min[1] + 0.5f * (max[1] - min[1]);
+			root.z = min[2] + 0.5f * (max[2] - min[2]);
+			root.extent = extent;
+			return;
+		}
 
-	return resultIndex;
+		// the old root becomes a child of a root with twice the extent, which is shifted towards p. The splitting planes
+		// are moved a few ulps beyond the boundary of the old root; thus, childCode assigns all of its points, which are
+		// only up to rounding inside of its boundary, to the old root.
+		const Octant oldRoot = root;
+		const float magnitude = std::max(std::abs(oldRoot.x), std::max(std::abs(oldRoot.y), std::abs(oldRoot.z)));
+		const float margin = 8.0f * std::numeric_limits<float>::epsilon() * (oldRoot.extent + magnitude);
+		const float shift = oldRoot.extent + margin;
+		uint32_t code = 0;
+		root.x = oldRoot.x + (dx < 0 ? -shift : shift);
+		root.y = oldRoot.y + (dy < 0 ? -shift : shift);
+		root.z = oldRoot.z + (dz < 0 ? -shift : shift);
+		if (dx < 0)
+			code |= 1;
+		if (dy < 0)
+			code |= 2;
+		if (dz < 0)
+			code |= 4;
+		root.extent = 2.0f * oldRoot.extent + margin;
+		root.childMask = (1 << code);
+		root.firstChild = octants_.size();
+		octants_.push_back(oldRoot);
+		// the octants might be reallocated, but mortonCode uses the root before compactOctants.
+		root_ = &octants_[0];
+	}
 }
 
 template <typename PointT, typename ContainerT>
-
-bool Octree<PointT, ContainerT>::findNeighbor(const Octant* octant, const PointT& query, float minDistance, float& maxDistance, int32_t& resultIndex) const
+bool Octree<PointT, ContainerT>::findLeaf(
+    uint32_t octantIdx, const PointT& p, uint32_t idx, std::vector<uint32_t>& path, uint32_t& pred) const
 {
-	const ContainerT& points = *data_;
-	// 1. first descend to leaf and check in leafs points.
-	if (octant->isLeaf)
-	{
-		uint32_t idx = octant->start;
-		float sqrMaxDistance = maxDistance * maxDistance;
-		float sqrMinDistance = (minDistance < 0) ? minDistance : minDistance * minDistance;
+	const Octant& octant = octants_[octantIdx];
+	path.push_back(octantIdx);
 
-		for (uint32_t i = 0; i < octant->size; ++i)
+	if (octant.isLeaf)
+	{
+		uint32_t prev = std::numeric_limits<uint32_t>::max();
+		uint32_t j = octant.start;
+		for (uint32_t i = 0; i < octant.size; ++i)
 		{
-			//const PointT& p = points[idx];
-			//float dist = Distance::compute(query, p);
-			PointT tmp = query - points[idx];
-			float dist = get<0>(tmp) * get<0>(tmp) + get<1>(tmp) * get<1>(tmp) + get<2>(tmp) * get<2>(tmp);
-			if (dist > sqrMinDistance && dist < sqrMaxDistance)
+			if (j == idx)
 			{
-				resultIndex = idx;
-				sqrMaxDistance = dist;
+				pred = prev;
+				return true;
 			}
-			idx = successors_[idx];
+			prev = j;
+			j = successors_[j];
 		}
-
-		maxDistance = std::sqrt(sqrMaxDistance);
-		return inside(query, maxDistance, octant);
 	}
-
-	// determine Morton code for each point...
-	uint32_t mortonCode = 0;
-	if (get<0>(query) > octant->x)
-		mortonCode |= 1;
-	if (get<1>(query) > octant->y)
-		mortonCode |= 2;
-	if (get<2>(query) > octant->z)
-		mortonCode |= 4;
-
-	if (octant->child[mortonCode] != 0)
+	else
 	{
-		if (findNeighbor(octant->child[mortonCode], query, minDistance, maxDistance, resultIndex))
-			return true;
+		// the point can only be in the child selected by the same rule as in createOctant.
+		const uint32_t code = childCode(octant.x, octant.y, octant.z, p);
+		if ((octant.childMask & (1 << code)) != 0)
+		{
+			const uint32_t childIdx = octant.firstChild + bitCount(octant.childMask & ((1 << code) - 1));
+			if (findLeaf(childIdx, p, idx, path, pred))
+				return true;
+		}
 	}
 
-	// 2. if current best point completely inside, just return.
-	float sqrMaxDistance = maxDistance * maxDistance;
+	path.pop_back();
+	return false;
+}
 
-	// 3. check adjacent octants for overlap and check these if necessary.
-	for (uint32_t c = 0; c < 8; ++c)
+template <typename PointT, typename ContainerT>
+uint32_t Octree<PointT, ContainerT>::predecessor(const std::vector<uint32_t>& path) const
+{
+	// all octants on the path sharing the start link it from the end of a sibling of the first octant not sharing it.
+	const uint32_t start = octants_[path.back()].start;
+	for (int32_t i = int32_t(path.size()) - 2; i >= 0; --i)
 	{
-		if (c == mortonCode)
-			continue;
-		if (octant->child[c] == 0)
-			continue;
-		if (!overlaps(query, maxDistance, sqrMaxDistance, octant->child[c]))
+		const Octant& octant = octants_[path[i]];
+		if (octant.start == start)
 			continue;
-		if (findNeighbor(octant->child[c], query, minDistance, maxDistance, resultIndex))
-			return true; // early pruning
+
+		const uint32_t lastChild = octant.firstChild + bitCount(octant.childMask);
+		for (uint32_t c = octant.firstChild; c < lastChild; ++c)
+		{
+			// the successor of the end of the octant is outside or undefined.
+			const uint32_t end = octants_[c].end;
+			if (end != octant.end && successors_[end] == start)
+				return end;
+		}
 	}
 
-	// all children have been checked...check if point is inside the current octant...
-	return inside(query, maxDistance, octant);
+	return std::numeric_limits<uint32_t>::max();
 }
 
 template <typename PointT, typename ContainerT>
-
-bool Octree<PointT, ContainerT>::inside(const PointT& query, float radius, const Octant* octant)
+void Octree<PointT, ContainerT>::linkBehind(const std::vector<uint32_t>& path, uint32_t idx, uint32_t end)
 {
-	// we exploit the symmetry to reduce the test to test
-	// whether the farthest corner is inside the search ball.
-	float x = get<0>(query) - octant->x;
-	float y = get<1>(query) - octant->y;
-	float z = get<2>(query) - octant->z;
+	successors_[idx] = successors_[end];
+	successors_[end] = idx;
 
-	x = std::abs(x) + radius;
-	y = std::abs(y) + radius;
-	z = std::abs(z) + radius;
+	for (uint32_t i = 0; i < path.size(); ++i)
+	{
+		Octant& octant = octants_[path[i]];
+		octant.size += 1;
+		if (octant.end == end)
+			octant.end = idx;
+	}
+}
 
-	if (x > octant->extent)
-		return false;
-	if (y > octant->extent)
-		return false;
-	if (z > octant->extent)
-		return false;
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::linkChild(std::vector<uint32_t>& path, uint32_t childIdx, uint32_t pred)
+{
+	const uint32_t idx = octants_[childIdx].start;
+	const Octant& parent = octants_[path.back()];
+	if (childIdx > parent.firstChild)
+	{
+		linkBehind(path, idx, octants_[childIdx - 1].end);
+	}
+	else
+	{
+		const uint32_t start = parent.start;
+		if (pred != std::numeric_limits<uint32_t>::max())
+			successors_[pred] = idx;
+		successors_[idx] = start;
 
-	return true;
+		for (uint32_t i = 0; i < path.size(); ++i)
+		{
+			Octant& octant = octants_[path[i]];
+			octant.size += 1;
+			if (octant.start == start)
+				octant.start = idx;
+		}
+	}
+
+	path.push_back(childIdx);
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::splitLeaf(const std::vector<uint32_t>& path)
+{
+	const Octant leaf = octants_[path.back()];
+	const uint32_t pred = predecessor(path);
+	const uint32_t next = successors_[leaf.end];
+
+	createOctant(octants_, path.back(), leaf.x, leaf.y, leaf.z, leaf.extent, leaf.start, leaf.end, leaf.size);
+
+	// createOctant relinks the points, which might change start and end of the octant.
+	const Octant& octant = octants_[path.back()];
+	if (pred != std::numeric_limits<uint32_t>::max())
+		successors_[pred] = octant.start;
+	successors_[octant.end] = next;
+
+	for (uint32_t i = 0; i + 1 < path.size(); ++i)
+	{
+		Octant& parent = octants_[path[i]];
+		if (parent.start == leaf.start)
+			parent.start = octant.start;
+		if (parent.end == leaf.end)
+			parent.end = octant.end;
+	}
+}
+
+template <typename PointT, typename ContainerT>
+uint32_t Octree<PointT, ContainerT>::addChild(uint32_t octantIdx, uint32_t code, uint32_t idx)
+{
+	static const float factor[] = { -0.5f, 0.5f };
+
+	// children are stored consecutively; therefore, all children are appended again.
+	const Octant parent = octants_[octantIdx];
+	const uint32_t firstChild = octants_.size();
+	uint32_t childIdx = 0;
+	uint32_t oldChild = parent.firstChild;
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		if (c == code)
+		{
+			Octant leaf;
+			leaf.x = parent.x + factor[(c & 1) > 0] * parent.extent;
+			leaf.y = parent.y + factor[(c & 2) > 0] * parent.extent;
+			leaf.z = parent.z + factor[(c & 4) > 0] * parent.extent;
+			leaf.extent = 0.5f * parent.extent;
+			leaf.start = idx;
+			leaf.end = idx;
+			leaf.size = 1;
+			childIdx = octants_.size();
+			octants_.push_back(leaf);
+		}
+		else if ((parent.childMask & (1 << c)) != 0)
+		{
+			const Octant sibling = octants_[oldChild++];
+			octants_.push_back(sibling);
+		}
+	}
+
+	octants_[octantIdx].firstChild = firstChild;
+	octants_[octantIdx].childMask = parent.childMask | (1 << code);
+
+	return childIdx;
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::removeChild(uint32_t octantIdx, uint32_t childIdx)
+{
+	const Octant parent = octants_[octantIdx];
+	const uint32_t firstChild = octants_.size();
+	uint8_t childMask = 0;
+	uint32_t oldChild = parent.firstChild;
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		if ((parent.childMask & (1 << c)) == 0)
+			continue;
+		if (oldChild != childIdx)
+		{
+			const Octant sibling = octants_[oldChild];
+			octants_.push_back(sibling);
+			childMask |= (1 << c);
+		}
+		oldChild += 1;
+	}
+
+	octants_[octantIdx].firstChild = firstChild;
+	octants_[octantIdx].childMask = childMask;
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::mergeOctants(const std::vector<uint32_t>& path)
+{
+	// the points of an octant are already linked consecutively; thus, we only have to drop the children.
+	for (uint32_t i = 0; i < path.size(); ++i)
+	{
+		Octant& octant = octants_[path[i]];
+		if (!octant.isLeaf && octant.size <= params_.bucketSize)
+		{
+			octant.isLeaf = true;
+			octant.childMask = 0;
+			octant.firstChild = 0;
+			return;
+		}
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::compactOctants()
+{
+	std::vector<Octant> octants;
+	octants.reserve(octants_.size());
+	octants.push_back(octants_[0]);
+	copyChildren(octants, 0);
+	octants_.swap(octants);
+	root_ = &octants_[0];
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::copyChildren(std::vector<Octant>& octants, uint32_t octantIdx) const
+{
+	if (octants[octantIdx].isLeaf)
+		return;
+
+	// allocate all children consecutively before their descendants as in createOctant.
+	const uint32_t oldChild = octants[octantIdx].firstChild;
+	const uint32_t numChildren = bitCount(octants[octantIdx].childMask);
+	const uint32_t firstChild = octants.size();
+	octants.insert(octants.end(), octants_.begin() + oldChild, octants_.begin() + oldChild + numChildren);
+	octants[octantIdx].firstChild = firstChild;
+	for (uint32_t i = 0; i < numChildren; ++i)
+		copyChildren(octants, firstChild + i);
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::aggregate(int depth, std::vector<OctantAggregate>& aggregates, bool findNearest) const
+{
+	aggregates.clear();
+	if (root_ == 0 || mapping_ != 0 || depth < 0)
+		return;
+
+	const ContainerT& points = *data_;
+	std::vector<double> sums;
+	octantSums(sums);
+
+	std::vector<std::pair<const Octant*, uint32_t> > items;
+	collectAggregates(root_, 0, depth, items);
+	const uint32_t M = items.size();
+
+	// every thread collects its aggregates in its own buffer, which are afterwards merged in order of the octants.
+	const int32_t numThreads = maxThreads();
+	std::vector<std::vector<OctantAggregate> > threadAggregates(numThreads);
+	std::vector<int32_t> owner(M);
+	std::vector<uint64_t> location(M);
+	std::vector<uint64_t> offsets(M + 1, 0);
+
+#pragma omp parallel num_threads(numThreads)
+	{
+		const int32_t t = threadIndex();
+		std::vector<OctantAggregate>& buffer = threadAggregates[t];
+		std::vector<uint32_t> indexes;
+		std::vector<std::pair<uint64_t, uint32_t> > cells;
+
+#pragma omp for schedule(dynamic, 256)
+		for (int32_t i = 0; i < int32_t(M); ++i)
+		{
+			const Octant* octant = items[i].first;
+			owner[i] = t;
+			location[i] = buffer.size();
+			if (items[i].second > 0)
+			{
+				aggregateLeaf(octant, items[i].second, findNearest, buffer, indexes, cells);
+				offsets[i + 1] = buffer.size() - location[i];
+				continue;
+			}
+
+			const uint32_t k = octant - root_;
+			OctantAggregate agg;
+			agg.x = sums[3 * k] / octant->size;
+			agg.y = sums[3 * k + 1] / octant->size;
+			agg.z = sums[3 * k + 2] / octant->size;
+			agg.size = octant->size;
+			agg.first = octant->start;
+			agg.nearest = octant->start;
+			if (findNearest && params_.reorderPoints)
+			{
+				float minDistance = std::numeric_limits<float>::infinity();
+				for (uint32_t j = octant->offset; j < octant->offset + octant->size; ++j)
+				{
+					float dist = sqrDistance(xs_[j] - agg.x, ys_[j] - agg.y, zs_[j] - agg.z);
+					if (dist < minDistance)
+					{
+						minDistance = dist;
+						agg.nearest = permutation_[j];
+					}
+				}
+			}
+			else if (findNearest)
+			{
+				float minDistance = std::numeric_limits<float>::infinity();
+				uint32_t idx = octant->start;
+				for (uint32_t j = 0; j < octant->size; ++j)
+				{
+					const PointT& p = points[idx];
+					float dist = sqrDistance(get<0>(p) - agg.x, get<1>(p) - agg.y, get<2>(p) - agg.z);
+					if (dist < minDistance)
+					{
+						minDistance = dist;
+						agg.nearest = idx;
+					}
+					idx = successors_[idx];
+				}
+			}
+			buffer.push_back(agg);
+			offsets[i + 1] = 1;
+		}
+	}
+
+	for (uint32_t i = 0; i < M; ++i)
+		offsets[i + 1] += offsets[i];
+
+	aggregates.resize(offsets[M]);
+#pragma omp parallel for schedule(dynamic, 256) num_threads(numThreads)
+	for (int32_t i = 0; i < int32_t(M); ++i)
+	{
+		const OctantAggregate* buffer = &threadAggregates[owner[i]][location[i]];
+		std::copy(buffer, buffer + (offsets[i + 1] - offsets[i]), aggregates.begin() + offsets[i]);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::octantSums(std::vector<double>& sums) const
+{
+	const ContainerT& points = *data_;
+	const int32_t numOctants = octants_.size();
+	sums.assign(3 * numOctants, 0.0);
+
+	// leafs contain disjoint subsets of points; afterwards, the children are stored behind their parent, thus a
+	// single backward pass over all octants sums up the children before their parent.
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int32_t i = 0; i < numOctants; ++i)
+	{
+		const Octant& octant = octants_[i];
+		if (!octant.isLeaf)
+			continue;
+
+		double sx = 0.0, sy = 0.0, sz = 0.0;
+		if (params_.reorderPoints)
+		{
+			for (uint32_t k = octant.offset; k < octant.offset + octant.size; ++k)
+			{
+				sx += xs_[k];
+				sy += ys_[k];
+				sz += zs_[k];
+			}
+		}
+		else
+		{
+			uint32_t idx = octant.start;
+			for (uint32_t k = 0; k < octant.size; ++k)
+			{
+				const PointT& p = points[idx];
+				sx += get<0>(p);
+				sy += get<1>(p);
+				sz += get<2>(p);
+				idx = successors_[idx];
+			}
+		}
+		sums[3 * i] = sx;
+		sums[3 * i + 1] = sy;
+		sums[3 * i + 2] = sz;
+	}
+
+	for (int32_t i = numOctants - 1; i >= 0; --i)
+	{
+		const Octant& octant = octants_[i];
+		if (octant.isLeaf)
+			continue;
+
+		const uint32_t lastChild = octant.firstChild + bitCount(octant.childMask);
+		for (uint32_t c = octant.firstChild; c < lastChild; ++c)
+		{
+			for (uint32_t d = 0; d < 3; ++d)
+				sums[3 * i + d] += sums[3 * c + d];
+		}
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::collectAggregates(const Octant* octant,
+                                                   int octantDepth,
+                                                   int depth,
+                                                   std::vector<std::pair<const Octant*, uint32_t> >& items) const
+{
+	if (octantDepth == depth || octant->isLeaf)
+	{
+		items.push_back(std::make_pair(octant, uint32_t(depth - octantDepth)));
+		return;
+	}
+
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* child = this->child(octant, c);
+		if (child != 0)
+			collectAggregates(child, octantDepth + 1, depth, items);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::aggregateLeaf(const Octant* octant,
+                                               uint32_t levels,
+                                               bool findNearest,
+                                               std::vector<OctantAggregate>& aggregates,
+                                               std::vector<uint32_t>& indexes,
+                                               std::vector<std::pair<uint64_t, uint32_t> >& cells) const
+{
+	// cells of the subdivided leaf with the same splitting planes and rule as in createOctant, where 21 bits per axis
+	// suffice for float coordinates.
+	static const float factor[] = { -0.5f, 0.5f };
+	levels = std::min<uint32_t>(levels, 21);
+
+	// cells are sorted by code and position in the successor list, which keeps the first point of each cell first.
+	const ContainerT& points = *data_;
+	const bool reordered = params_.reorderPoints;
+	getIndices(octant, indexes);
+	cells.resize(octant->size);
+	for (uint32_t i = 0; i < octant->size; ++i)
+	{
+		const uint32_t k = octant->offset + i;
+		const PointT& p = points[indexes[i]];
+		const float coords[3] = { reordered ? xs_[k] : get<0>(p), reordered ? ys_[k] : get<1>(p), reordered ? zs_[k] : get<2>(p) };
+		float center[3] = { octant->x, octant->y, octant->z };
+		float extent = octant->extent;
+		uint64_t cell[3] = { 0, 0, 0 };
+		for (uint32_t l = 0; l < levels; ++l)
+		{
+			for (uint32_t d = 0; d < 3; ++d)
+			{
+				const uint32_t upper = (coords[d] > center[d]) ? 1 : 0;
+				cell[d] = (cell[d] << 1) | upper;
+				center[d] += factor[upper] * extent;
+			}
+			extent *= 0.5f;
+		}
+		cells[i] = std::make_pair((cell[0] << 42) | (cell[1] << 21) | cell[2], i);
+	}
+	std::sort(cells.begin(), cells.end());
+
+	for (uint32_t begin = 0; begin < cells.size();)
+	{
+		uint32_t end = begin + 1;
+		while (end < cells.size() && cells[end].first == cells[begin].first)
+			++end;
+
+		double sum[3] = { 0.0, 0.0, 0.0 };
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			const uint32_t k = octant->offset + cells[i].second;
+			const PointT& p = points[indexes[cells[i].second]];
+			sum[0] += reordered ? xs_[k] : get<0>(p);
+			sum[1] += reordered ? ys_[k] : get<1>(p);
+			sum[2] += reordered ? zs_[k] : get<2>(p);
+		}
+
+		OctantAggregate agg;
+		agg.x = sum[0] / (end - begin);
+		agg.y = sum[1] / (end - begin);
+		agg.z = sum[2] / (end - begin);
+		agg.size = end - begin;
+		agg.first = indexes[cells[begin].second];
+		agg.nearest = agg.first;
+
+		float minDistance = std::numeric_limits<float>::infinity();
+		for (uint32_t i = begin; i < end && findNearest; ++i)
+		{
+			const uint32_t k = octant->offset + cells[i].second;
+			const PointT& p = points[indexes[cells[i].second]];
+			float dist = reordered ? sqrDistance(xs_[k] - agg.x, ys_[k] - agg.y, zs_[k] - agg.z)
+			                       : sqrDistance(get<0>(p) - agg.x, get<1>(p) - agg.y, get<2>(p) - agg.z);
+			if (dist < minDistance)
+			{
+				minDistance = dist;
+				agg.nearest = indexes[cells[i].second];
+			}
+		}
+
+		aggregates.push_back(agg);
+		begin = end;
+	}
+}
+
+template <typename PointT, typename ContainerT>
+int Octree<PointT, ContainerT>::depthForExtent(float extent) const
+{
+	if (root_ == 0)
+		return 0;
+
+	int depth = 0;
+	for (float e = root_->extent; e > extent && e > 0.0f; e *= 0.5f)
+		depth += 1;
+
+	return depth;
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::downsample(float extent, std::vector<uint32_t>& resultIndices) const
+{
+	std::vector<OctantAggregate> aggregates;
+	aggregate(depthForExtent(extent), aggregates);
+
+	resultIndices.resize(aggregates.size());
+	for (uint32_t i = 0; i < aggregates.size(); ++i)
+		resultIndices[i] = aggregates[i].nearest;
+}
+
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::levelOfDetail(const PointT& viewpoint,
+                                               float error,
+                                               std::vector<LodSample>& samples,
+                                               uint32_t maxSamples) const
+{
+	samples.clear();
+	if (root_ == 0 || centroids_ == 0)
+		return false;
+	if (maxSamples == 0)
+		return true;
+
+	// max-heap of (relative extent, octant index) of the octants, which are not reported yet.
+	std::vector<std::pair<float, uint32_t> > heap;
+	heap.push_back(std::make_pair(relativeExtent(viewpoint, root_), 0));
+	uint32_t numSamples = 1; // reported samples and octants in the heap.
+	while (!heap.empty())
+	{
+		std::pop_heap(heap.begin(), heap.end());
+		const std::pair<float, uint32_t> entry = heap.back();
+		heap.pop_back();
+		const Octant* octant = root_ + entry.second;
+
+		// refining replaces the octant by its children or the points of the leaf, if they fit the budget.
+		const uint32_t refined = octant->isLeaf ? octant->size : bitCount(octant->childMask);
+		if (entry.first <= error || numSamples - 1 + refined > maxSamples)
+		{
+			LodSample sample;
+			sample.x = centroids_[3 * entry.second];
+			sample.y = centroids_[3 * entry.second + 1];
+			sample.z = centroids_[3 * entry.second + 2];
+			sample.size = octant->size;
+			sample.index = octant->start;
+			samples.push_back(sample);
+			continue;
+		}
+		numSamples += refined - 1;
+
+		if (!octant->isLeaf)
+		{
+			for (uint32_t c = 0; c < 8; ++c)
+			{
+				const Octant* childOctant = child(octant, c);
+				if (childOctant == 0)
+					continue;
+				heap.push_back(std::make_pair(relativeExtent(viewpoint, childOctant), uint32_t(childOctant - root_)));
+				std::push_heap(heap.begin(), heap.end());
+			}
+			continue;
+		}
+
+		LodSample sample;
+		sample.size = 1;
+		if (params_.reorderPoints)
+		{
+			for (uint32_t i = octant->offset; i < octant->offset + octant->size; ++i)
+			{
+				sample.x = xs_[i];
+				sample.y = ys_[i];
+				sample.z = zs_[i];
+				sample.index = permutation_[i];
+				samples.push_back(sample);
+			}
+		}
+		else
+		{
+			const ContainerT& points = *data_;
+			uint32_t idx = octant->start;
+			for (uint32_t i = 0; i < octant->size; ++i)
+			{
+				const PointT& p = points[idx];
+				sample.x = get<0>(p);
+				sample.y = get<1>(p);
+				sample.z = get<2>(p);
+				sample.index = idx;
+				samples.push_back(sample);
+				idx = successors_[idx];
+			}
+		}
+	}
+
+	return true;
+}
+
+template <typename PointT, typename ContainerT>
+float Octree<PointT, ContainerT>::relativeExtent(const PointT& viewpoint, const Octant* octant) const
+{
+	// distance of the viewpoint to the nearest point of the octant.
+	const float dx = std::max(0.0f, std::abs(get<0>(viewpoint) - octant->x) - octant->extent);
+	const float dy = std::max(0.0f, std::abs(get<1>(viewpoint) - octant->y) - octant->extent);
+	const float dz = std::max(0.0f, std::abs(get<2>(viewpoint) - octant->z) - octant->extent);
+	const float distance = std::sqrt(sqrDistance(dx, dy, dz));
+	if (distance == 0.0f)
+		return std::numeric_limits<float>::infinity();
+
+	return octant->extent / distance;
+}
+
+template <typename PointT, typename ContainerT>
+QueryStats Octree<PointT, ContainerT>::queryStats() const
+{
+	QueryStats stats;
+	for (uint32_t t = 0; t < threadStats_.size(); ++t)
+	{
+		const ThreadStats& counters = threadStats_[t];
+		stats.queries += counters.queries.load();
+		stats.octantsVisited += counters.octantsVisited.load();
+		stats.overlapTests += counters.overlapTests.load();
+		stats.containedOctants += counters.containedOctants.load();
+		stats.pointsTested += counters.pointsTested.load();
+		stats.results += counters.results.load();
+	}
+
+	return stats;
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::resetQueryStats()
+{
+	for (uint32_t t = 0; t < threadStats_.size(); ++t)
+	{
+		ThreadStats& counters = threadStats_[t];
+		counters.queries.reset();
+		counters.octantsVisited.reset();
+		counters.overlapTests.reset();
+		counters.containedOctants.reset();
+		counters.pointsTested.reset();
+		counters.results.reset();
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+QueryStats Octree<PointT, ContainerT>::radiusQueryCost(const std::vector<PointT>& queries, float radius) const
+{
+	QueryStats stats;
+	stats.queries = queries.size();
+	if (root_ == 0)
+		return stats;
+
+	const float sqrRadius = Distance::sqr(radius);
+	for (uint32_t q = 0; q < queries.size(); ++q)
+		radiusQueryCost<Distance>(root_, queries[q], radius, sqrRadius, stats);
+
+	return stats;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+void Octree<PointT, ContainerT>::radiusQueryCost(const Octant* octant,
+                                                 const PointT& query,
+                                                 float radius,
+                                                 float sqrRadius,
+                                                 QueryStats& stats) const
+{
+	// same decisions as radiusNeighbors.
+	stats.octantsVisited += 1;
+	if (contains<Distance>(query, sqrRadius, octant))
+	{
+		stats.containedOctants += 1;
+		stats.results += octant->size;
+		return;
+	}
+
+	if (octant->isLeaf)
+	{
+		stats.pointsTested += octant->size;
+		return;
+	}
+
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* childOctant = child(octant, c);
+		if (childOctant == 0)
+			continue;
+		stats.overlapTests += 1;
+		if (overlaps<Distance>(query, radius, sqrRadius, childOctant))
+			radiusQueryCost<Distance>(childOctant, query, radius, sqrRadius, stats);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+OctreeShape Octree<PointT, ContainerT>::shape() const
+{
+	OctreeShape result;
+	result.leafOccupancy.assign(9, 0);
+	result.numLeafs = 0;
+	result.maxLeafSize = 0;
+	result.meanLeafSize = 0.0f;
+	result.bytes = octants_.capacity() * sizeof(Octant) + successors_.capacity() * sizeof(uint32_t) +
+	               coordinates_.capacity() * sizeof(float) + indexes_.capacity() * sizeof(uint32_t) +
+	               quantized_.capacity() * sizeof(int16_t) + centroidCoordinates_.capacity() * sizeof(float);
+	if (params_.copyPoints && data_ != 0)
+		result.bytes += data_->size() * sizeof(PointT);
+	result.mappedBytes = mappingSize_;
+	if (root_ == 0)
+		return result;
+
+	const uint32_t bucketSize = std::max(params_.bucketSize, uint32_t(1));
+	uint64_t leafPoints = 0;
+	std::vector<std::pair<const Octant*, uint32_t> > stack(1, std::make_pair(root_, 0u));
+	while (!stack.empty())
+	{
+		const Octant* octant = stack.back().first;
+		const uint32_t depth = stack.back().second;
+		stack.pop_back();
+
+		if (result.octantsPerDepth.size() <= depth)
+		{
+			result.octantsPerDepth.resize(depth + 1, 0);
+			result.leafsPerDepth.resize(depth + 1, 0);
+		}
+		result.octantsPerDepth[depth] += 1;
+
+		if (octant->isLeaf)
+		{
+			result.leafsPerDepth[depth] += 1;
+			result.leafOccupancy[(octant->size > bucketSize) ? 8 : (8 * std::max(octant->size, 1u) - 1) / bucketSize] += 1;
+			result.numLeafs += 1;
+			result.maxLeafSize = std::max(result.maxLeafSize, octant->size);
+			leafPoints += octant->size;
+			continue;
+		}
+
+		for (uint32_t c = 0; c < 8; ++c)
+		{
+			const Octant* childOctant = child(octant, c);
+			if (childOctant != 0)
+				stack.push_back(std::make_pair(childOctant, depth + 1));
+		}
+	}
+	result.meanLeafSize = float(leafPoints) / result.numLeafs;
+
+	return result;
+}
+
+template <typename PointT, typename ContainerT>
+const typename Octree<PointT, ContainerT>::Octant* Octree<PointT, ContainerT>::child(const Octant* octant, uint32_t i) const
+{
+	if ((octant->childMask & (1 << i)) == 0)
+		return 0;
+
+	// children are stored consecutively; therefore we only have to count the preceding children.
+	return root_ + octant->firstChild + bitCount(octant->childMask & ((1 << i) - 1));
+}
+
+template <typename PointT, typename ContainerT>
+uint32_t Octree<PointT, ContainerT>::childCode(float x, float y, float z, const PointT& p)
+{
+	uint32_t code = 0;
+	if (get<0>(p) > x)
+		code |= 1;
+	if (get<1>(p) > y)
+		code |= 2;
+	if (get<2>(p) > z)
+		code |= 4;
+
+	return code;
+}
+
+template <typename PointT, typename ContainerT>
+uint32_t Octree<PointT, ContainerT>::bitCount(uint32_t mask)
+{
+	mask = mask - ((mask >> 1) & 0x55);
+	mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+	return (mask + (mask >> 4)) & 0x0F;
+}
+
+template <typename PointT, typename ContainerT>
+OctreePartition<PointT, ContainerT> Octree<PointT, ContainerT>::partition(int depth) const
+{
+	return OctreePartition<PointT, ContainerT>(this, depth);
+}
+
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::getOctantIndicesAtSpecifiedDepth(int depth, std::vector<std::vector<uint32_t>>& indicesList)
+{
+	indicesList.clear();
+	if (depth < 1 || !root_)
+	{
+		partition_ = OctreePartition<PointT, ContainerT>();
+		return false;
+	}
+	partition_ = partition(depth);
+	indicesList.resize(partition_.size());
+#pragma omp parallel for
+	for (int k = 0; k < int(partition_.size()); ++k)
+	{
+		partition_.indices(k, indicesList[k]);
+	}
+
+	return !indicesList.empty();
+}
+
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::getOctantIndicesAtSpecifiedDepth(int depth,
+                                                                  std::vector<uint32_t>& indices,
+                                                                  std::vector<uint32_t>& offsets)
+{
+	indices.clear();
+	offsets.assign(1, 0);
+	if (depth < 1 || !root_)
+	{
+		partition_ = OctreePartition<PointT, ContainerT>();
+		return false;
+	}
+	partition_ = partition(depth);
+	const std::vector<const Octant*>& parts = partition_.parts_;
+	offsets.resize(parts.size() + 1);
+	for (uint32_t k = 0; k < parts.size(); ++k)
+	{
+		offsets[k + 1] = offsets[k] + parts[k]->size;
+	}
+
+	if (params_.reorderPoints)
+	{
+		// the parts are consecutive ranges of the leaf-sorted indices, which are copied at once.
+		if (!parts.empty())
+			indices.assign(permutation_ + parts[0]->offset, permutation_ + parts[0]->offset + offsets.back());
+		return !parts.empty();
+	}
+
+	indices.resize(offsets.back());
+#pragma omp parallel for
+	for (int k = 0; k < int(parts.size()); ++k)
+	{
+		copyIndices(parts[k], &indices[0] + offsets[k]);
+	}
+
+	return !parts.empty();
+}
+
+template <typename PointT, typename ContainerT>
+template <typename VisitorT>
+uint32_t Octree<PointT, ContainerT>::visitOctantsAtSpecifiedDepth(int depth, VisitorT&& visitor) const
+{
+	uint32_t part = 0;
+	if (depth < 1 || !root_)
+		return part;
+
+	// a single thread collects the parts, while the other threads of the team process them.
+#pragma omp parallel
+#pragma omp single
+	visitOctantsAtSpecifiedDepth(root_, 0, depth, part, &visitor);
+
+	return part;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename VisitorT>
+void Octree<PointT, ContainerT>::visitOctantsAtSpecifiedDepth(const Octant* octant,
+                                                              int octantDepth,
+                                                              int depth,
+                                                              uint32_t& part,
+                                                              VisitorT* visitor) const
+{
+	if (octantDepth == depth || octant->isLeaf)
+	{
+		const uint32_t p = part++;
+#pragma omp task firstprivate(octant, p, visitor)
+		{
+			if (params_.reorderPoints)
+			{
+				(*visitor)(p, static_cast<const uint32_t*>(permutation_ + octant->offset), octant->size);
+			}
+			else
+			{
+				std::vector<uint32_t> indices(octant->size);
+				copyIndices(octant, &indices[0]);
+				(*visitor)(p, static_cast<const uint32_t*>(&indices[0]), octant->size);
+			}
+		}
+		return;
+	}
+
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* childOctant = child(octant, c);
+		if (childOctant != 0)
+			visitOctantsAtSpecifiedDepth(childOctant, octantDepth + 1, depth, part, visitor);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+
+bool Octree<PointT, ContainerT>::radiusSearchLimitInOneOctant(int octantIndex, const PointT& query, float radius, std::vector<uint32_t>& resultIndices) const
+{
+	return partition_.radiusNeighbors(octantIndex, query, radius, resultIndices);
+}
+
+template <typename PointT, typename ContainerT>
+
+bool Octree<PointT, ContainerT>::radiusSearchLimitInOneOctant(int octantIndex,
+                                                              const PointT& query,
+                                                              float radius,
+                                                              std::vector<uint32_t>& resultIndices,
+                                                              std::vector<float>& distances) const
+{
+	return partition_.radiusNeighbors(octantIndex, query, radius, resultIndices, distances);
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::getIndices(const Octant* octant, std::vector<uint32_t>& indices) const
+{
+	indices.clear();
+	appendIndices(octant, indices);
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::appendIndices(const Octant* octant, std::vector<uint32_t>& indices) const
+{
+	if (params_.reorderPoints)
+	{
+		indices.insert(indices.end(), permutation_ + octant->offset, permutation_ + octant->offset + octant->size);
+		return;
+	}
+
+	indices.reserve(indices.size() + octant->size);
+	uint32_t idx = octant->start;
+	for (uint32_t i = 0; i < octant->size; ++i)
+	{
+		indices.push_back(idx);
+		idx = successors_[idx];
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::copyIndices(const Octant* octant, uint32_t* indices) const
+{
+	if (params_.reorderPoints)
+	{
+		std::copy(permutation_ + octant->offset, permutation_ + octant->offset + octant->size, indices);
+		return;
+	}
+
+	uint32_t idx = octant->start;
+	for (uint32_t i = 0; i < octant->size; ++i)
+	{
+		indices[i] = idx;
+		idx = successors_[idx];
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::boxSearch(const PointT& min, const PointT& max, std::vector<uint32_t>& resultIndices) const
+{
+	resultIndices.clear();
+	if (root_ == 0)
+		return;
+
+	const float boxMin[3] = { get<0>(min), get<1>(min), get<2>(min) };
+	const float boxMax[3] = { get<0>(max), get<1>(max), get<2>(max) };
+	boxSearch(root_, boxMin, boxMax, resultIndices);
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::boxSearch(const Octant* octant,
+                                           const float min[3],
+                                           const float max[3],
+                                           std::vector<uint32_t>& resultIndices) const
+{
+	const float center[3] = { octant->x, octant->y, octant->z };
+	const float extent = octant->extent;
+	bool contained = true;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		if (center[i] + extent < min[i] || center[i] - extent > max[i])
+			return; // no overlap.
+		if (center[i] - extent < min[i] || center[i] + extent > max[i])
+			contained = false;
+	}
+
+	// if the box contains the octant, simply add the point indexes.
+	if (contained)
+	{
+		appendIndices(octant, resultIndices);
+		return;
+	}
+
+	if (octant->isLeaf)
+	{
+		if (params_.reorderPoints)
+		{
+			for (uint32_t k = octant->offset; k < octant->offset + octant->size; ++k)
+			{
+				if (xs_[k] >= min[0] && xs_[k] <= max[0] && ys_[k] >= min[1] && ys_[k] <= max[1] && zs_[k] >= min[2] &&
+				    zs_[k] <= max[2])
+					resultIndices.push_back(permutation_[k]);
+			}
+
+			return;
+		}
+
+		uint32_t idx = octant->start;
+		for (uint32_t i = 0; i < octant->size; ++i)
+		{
+			const PointT& p = (*data_)[idx];
+			if (get<0>(p) >= min[0] && get<0>(p) <= max[0] && get<1>(p) >= min[1] && get<1>(p) <= max[1] &&
+			    get<2>(p) >= min[2] && get<2>(p) <= max[2])
+				resultIndices.push_back(idx);
+			idx = successors_[idx];
+		}
+
+		return;
+	}
+
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* childOctant = child(octant, c);
+		if (childOctant != 0)
+			boxSearch(childOctant, min, max, resultIndices);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::Ray::set(const PointT& o, const PointT& d, float r, float maxDist)
+{
+	const float length = std::sqrt(get<0>(d) * get<0>(d) + get<1>(d) * get<1>(d) + get<2>(d) * get<2>(d));
+	if (!(length > 0.0f) || !(r >= 0.0f))
+		return false;
+
+	origin[0] = get<0>(o);
+	origin[1] = get<1>(o);
+	origin[2] = get<2>(o);
+	direction[0] = get<0>(d) / length;
+	direction[1] = get<1>(d) / length;
+	direction[2] = get<2>(d) / length;
+	for (uint32_t i = 0; i < 3; ++i)
+		invDirection[i] = (direction[i] != 0.0f) ? 1.0f / direction[i] : 0.0f;
+	radius = r;
+	sqrRadius = r * r;
+	maxDistance = maxDist;
+
+	return true;
+}
+
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::rayInterval(const Octant* octant, const Ray& ray, float& tEnter, float& tExit) const
+{
+	const float center[3] = { octant->x, octant->y, octant->z };
+	const float extent = octant->extent + ray.radius;
+	tEnter = 0.0f;
+	tExit = ray.maxDistance;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		const float lower = center[i] - extent - ray.origin[i];
+		const float upper = center[i] + extent - ray.origin[i];
+		if (ray.direction[i] == 0.0f)
+		{
+			// parallel to the slab: either always or never inside.
+			if (lower > 0.0f || upper < 0.0f)
+				return false;
+			continue;
+		}
+
+		float t0 = lower * ray.invDirection[i];
+		float t1 = upper * ray.invDirection[i];
+		if (t0 > t1)
+			std::swap(t0, t1);
+		tEnter = std::max(tEnter, t0);
+		tExit = std::min(tExit, t1);
+	}
+
+	return tEnter <= tExit;
+}
+
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::rayTest(const Ray& ray, float x, float y, float z, float& t) const
+{
+	const float v[3] = { x - ray.origin[0], y - ray.origin[1], z - ray.origin[2] };
+	t = v[0] * ray.direction[0] + v[1] * ray.direction[1] + v[2] * ray.direction[2];
+	if (t < 0.0f || t > ray.maxDistance)
+		return false;
+
+	// the squared distance to the ray is the squared norm of the cross product with the normalized direction.
+	const float cx = v[1] * ray.direction[2] - v[2] * ray.direction[1];
+	const float cy = v[2] * ray.direction[0] - v[0] * ray.direction[2];
+	const float cz = v[0] * ray.direction[1] - v[1] * ray.direction[0];
+
+	return cx * cx + cy * cy + cz * cz <= ray.sqrRadius;
+}
+
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::rayCast(const PointT& origin,
+                                         const PointT& direction,
+                                         float radius,
+                                         uint32_t& hitIndex,
+                                         float& hitDistance,
+                                         float maxDistance) const
+{
+	hitIndex = std::numeric_limits<uint32_t>::max();
+	hitDistance = std::numeric_limits<float>::infinity();
+
+	Ray ray;
+	if (root_ == 0 || !ray.set(origin, direction, radius, maxDistance))
+		return false;
+
+	rayCast(root_, ray, hitIndex, hitDistance);
+
+	return hitIndex != std::numeric_limits<uint32_t>::max();
+}
+
+template <typename PointT, typename ContainerT>
+template <typename QueryContainerT>
+void Octree<PointT, ContainerT>::rayCast(const PointT& origin,
+                                         const QueryContainerT& directions,
+                                         float radius,
+                                         uint32_t* hitIndices,
+                                         float* hitDistances,
+                                         float maxDistance) const
+{
+	const uint32_t N = directions.size();
+#pragma omp parallel for schedule(dynamic, 256)
+	for (int32_t i = 0; i < int32_t(N); ++i)
+	{
+		float hitDistance;
+		rayCast(origin, directions[i], radius, hitIndices[i], hitDistance, maxDistance);
+		if (hitDistances != 0)
+			hitDistances[i] = hitDistance;
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::rayCast(const Octant* octant, const Ray& ray, uint32_t& hitIndex, float& hitDistance) const
+{
+	if (octant->isLeaf)
+	{
+		uint32_t idx = octant->start;
+		for (uint32_t k = 0; k < octant->size; ++k)
+		{
+			float t;
+			if (params_.reorderPoints)
+			{
+				const uint32_t j = octant->offset + k;
+				if (rayTest(ray, xs_[j], ys_[j], zs_[j], t) && t < hitDistance)
+				{
+					hitDistance = t;
+					hitIndex = permutation_[j];
+				}
+				continue;
+			}
+
+			const PointT& p = (*data_)[idx];
+			if (rayTest(ray, get<0>(p), get<1>(p), get<2>(p), t) && t < hitDistance)
+			{
+				hitDistance = t;
+				hitIndex = idx;
+			}
+			idx = successors_[idx];
+		}
+
+		return;
+	}
+
+	// sort the children hit by the ray by their entry parameter, i.e., front-to-back.
+	std::pair<float, const Octant*> children[8];
+	uint32_t numChildren = 0;
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* childOctant = child(octant, c);
+		float tEnter, tExit;
+		if (childOctant == 0 || !rayInterval(childOctant, ray, tEnter, tExit) || tEnter > hitDistance)
+			continue;
+
+		uint32_t pos = numChildren++;
+		for (; pos > 0 && children[pos - 1].first > tEnter; --pos)
+			children[pos] = children[pos - 1];
+		children[pos] = std::make_pair(tEnter, childOctant);
+	}
+
+	for (uint32_t c = 0; c < numChildren; ++c)
+	{
+		// all points of the remaining children are behind the current hit.
+		if (children[c].first > hitDistance)
+			break;
+		rayCast(children[c].second, ray, hitIndex, hitDistance);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::rayPoints(const PointT& origin,
+                                           const PointT& direction,
+                                           float radius,
+                                           std::vector<uint32_t>& resultIndices,
+                                           std::vector<float>& rayDistances,
+                                           float maxDistance) const
+{
+	resultIndices.clear();
+	rayDistances.clear();
+
+	Ray ray;
+	float tEnter, tExit;
+	if (root_ == 0 || !ray.set(origin, direction, radius, maxDistance) || !rayInterval(root_, ray, tEnter, tExit))
+		return;
+
+	std::vector<std::pair<float, uint32_t> > hits;
+	rayPoints(root_, ray, hits);
+	std::sort(hits.begin(), hits.end());
+
+	resultIndices.resize(hits.size());
+	rayDistances.resize(hits.size());
+	for (uint32_t i = 0; i < hits.size(); ++i)
+	{
+		rayDistances[i] = hits[i].first;
+		resultIndices[i] = hits[i].second;
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::rayPoints(const Octant* octant,
+                                           const Ray& ray,
+                                           std::vector<std::pair<float, uint32_t> >& hits) const
+{
+	if (octant->isLeaf)
+	{
+		uint32_t idx = octant->start;
+		for (uint32_t k = 0; k < octant->size; ++k)
+		{
+			float t;
+			if (params_.reorderPoints)
+			{
+				const uint32_t j = octant->offset + k;
+				if (rayTest(ray, xs_[j], ys_[j], zs_[j], t))
+					hits.push_back(std::make_pair(t, permutation_[j]));
+				continue;
+			}
+
+			const PointT& p = (*data_)[idx];
+			if (rayTest(ray, get<0>(p), get<1>(p), get<2>(p), t))
+				hits.push_back(std::make_pair(t, idx));
+			idx = successors_[idx];
+		}
+
+		return;
+	}
+
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* childOctant = child(octant, c);
+		float tEnter, tExit;
+		if (childOctant != 0 && rayInterval(childOctant, ray, tEnter, tExit))
+			rayPoints(childOctant, ray, hits);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+int32_t Octree<PointT, ContainerT>::joinTest(const Octant* octant, const Octant* otherOctant, float sqrRadius)
+{
+	// per axis, the minimal and maximal distance between points of the boxes.
+	const float centers[3] = { octant->x - otherOctant->x, octant->y - otherOctant->y, octant->z - otherOctant->z };
+	const float extent = octant->extent + otherOctant->extent;
+	float minGap[3], maxGap[3];
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		minGap[i] = std::max(std::abs(centers[i]) - extent, 0.0f);
+		maxGap[i] = std::abs(centers[i]) + extent;
+	}
+
+	if (Distance::norm(minGap[0], minGap[1], minGap[2]) >= sqrRadius)
+		return -1;
+	if (Distance::norm(maxGap[0], maxGap[1], maxGap[2]) < sqrRadius)
+		return 1;
+
+	return 0;
+}
+
+template <typename PointT, typename ContainerT>
+const uint32_t* Octree<PointT, ContainerT>::octantIndices(const Octant* octant, std::vector<uint32_t>& buffer) const
+{
+	if (params_.reorderPoints)
+		return permutation_ + octant->offset;
+
+	buffer.clear();
+	appendIndices(octant, buffer);
+
+	return buffer.data();
+}
+
+template <typename PointT, typename ContainerT>
+typename Octree<PointT, ContainerT>::LeafPoints Octree<PointT, ContainerT>::gatherPoints(const Octant* octant,
+                                                                                         JoinBuffers& buffers,
+                                                                                         uint32_t i) const
+{
+	LeafPoints points;
+	if (params_.reorderPoints)
+	{
+		points.indices = permutation_ + octant->offset;
+		points.xs = xs_ + octant->offset;
+		points.ys = ys_ + octant->offset;
+		points.zs = zs_ + octant->offset;
+		return points;
+	}
+
+	buffers.indices[i].resize(octant->size);
+	buffers.xs[i].resize(octant->size);
+	buffers.ys[i].resize(octant->size);
+	buffers.zs[i].resize(octant->size);
+
+	uint32_t idx = octant->start;
+	for (uint32_t k = 0; k < octant->size; ++k)
+	{
+		const PointT& p = (*data_)[idx];
+		buffers.indices[i][k] = idx;
+		buffers.xs[i][k] = get<0>(p);
+		buffers.ys[i][k] = get<1>(p);
+		buffers.zs[i][k] = get<2>(p);
+		idx = successors_[idx];
+	}
+
+	points.indices = buffers.indices[i].data();
+	points.xs = buffers.xs[i].data();
+	points.ys = buffers.ys[i].data();
+	points.zs = buffers.zs[i].data();
+	return points;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance, typename VisitorT>
+bool Octree<PointT, ContainerT>::radiusJoin(const Octree& other, float radius, VisitorT&& visitor) const
+{
+	if (root_ == 0 || other.root_ == 0)
+		return true;
+
+	JoinBuffers buffers;
+	return radiusJoin<Distance>(root_, other, other.root_, Distance::sqr(radius), visitor, buffers);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+void Octree<PointT, ContainerT>::radiusJoin(const Octree& other,
+                                            float radius,
+                                            std::vector<std::pair<uint32_t, uint32_t> >& pairs) const
+{
+	pairs.clear();
+	if (root_ == 0 || other.root_ == 0)
+		return;
+
+	// expand the pairs of octants breadth-first until there are enough pairs to balance the threads.
+	typedef std::pair<const Octant*, const Octant*> OctantPair;
+	const float sqrRadius = Distance::sqr(radius);
+	const uint32_t minTasks = 64 * maxThreads();
+	std::vector<OctantPair> tasks(1, OctantPair(root_, other.root_)), next;
+	bool expanded = true;
+	while (expanded && tasks.size() < minTasks)
+	{
+		expanded = false;
+		next.clear();
+		for (uint32_t t = 0; t < tasks.size(); ++t)
+		{
+			const Octant* a = tasks[t].first;
+			const Octant* b = tasks[t].second;
+			const int32_t test = joinTest<Distance>(a, b, sqrRadius);
+			if (test < 0)
+				continue;
+			if (test > 0 || (a->isLeaf && b->isLeaf))
+			{
+				next.push_back(tasks[t]);
+				continue;
+			}
+
+			expanded = true;
+			const bool splitFirst = b->isLeaf || (!a->isLeaf && a->extent >= b->extent);
+			for (uint32_t c = 0; c < 8; ++c)
+			{
+				const Octant* childOctant = splitFirst ? child(a, c) : other.child(b, c);
+				if (childOctant != 0)
+					next.push_back(splitFirst ? OctantPair(childOctant, b) : OctantPair(a, childOctant));
+			}
+		}
+		tasks.swap(next);
+	}
+
+	const int32_t numTasks = tasks.size();
+	std::vector<std::vector<std::pair<uint32_t, uint32_t> > > taskPairs(numTasks);
+#pragma omp parallel
+	{
+		JoinBuffers buffers;
+#pragma omp for schedule(dynamic, 1)
+		for (int32_t t = 0; t < numTasks; ++t)
+		{
+			JoinPairsVisitor visitor(taskPairs[t]);
+			radiusJoin<Distance>(tasks[t].first, other, tasks[t].second, sqrRadius, visitor, buffers);
+		}
+	}
+
+	uint64_t numPairs = 0;
+	for (int32_t t = 0; t < numTasks; ++t)
+		numPairs += taskPairs[t].size();
+	pairs.reserve(numPairs);
+	for (int32_t t = 0; t < numTasks; ++t)
+		pairs.insert(pairs.end(), taskPairs[t].begin(), taskPairs[t].end());
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance, typename VisitorT>
+bool Octree<PointT, ContainerT>::radiusJoin(const Octant* octant,
+                                            const Octree& other,
+                                            const Octant* otherOctant,
+                                            float sqrRadius,
+                                            VisitorT& visitor,
+                                            JoinBuffers& buffers) const
+{
+	const int32_t test = joinTest<Distance>(octant, otherOctant, sqrRadius);
+	if (test < 0)
+		return true;
+
+	// all pairs of points are within the radius.
+	if (test > 0)
+	{
+		const uint32_t* indices = octantIndices(octant, buffers.indices[0]);
+		const uint32_t* otherIndices = other.octantIndices(otherOctant, buffers.indices[1]);
+		return visitor(indices, octant->size, otherIndices, otherOctant->size);
+	}
+
+	if (octant->isLeaf && otherOctant->isLeaf)
+	{
+		const LeafPoints p = gatherPoints(octant, buffers, 0);
+		const LeafPoints q = other.gatherPoints(otherOctant, buffers, 1);
+		const uint32_t blockSize = 64;
+		uint32_t indices[blockSize];
+		float distances[blockSize];
+		Octant pointOctant;
+		pointOctant.extent = 0.0f;
+		for (uint32_t i = 0; i < octant->size; ++i)
+		{
+			// skip points farther away from the other octant than the radius, which saves most scans of small radii.
+			pointOctant.x = p.xs[i];
+			pointOctant.y = p.ys[i];
+			pointOctant.z = p.zs[i];
+			if (joinTest<Distance>(&pointOctant, otherOctant, sqrRadius) < 0)
+				continue;
+
+			for (uint32_t first = 0; first < otherOctant->size; first += blockSize)
+			{
+				uint32_t n = simd::Scan<Distance>::radius(q.xs + first,
+				                                          q.ys + first,
+				                                          q.zs + first,
+				                                          q.indices + first,
+				                                          std::min(blockSize, otherOctant->size - first),
+				                                          p.xs[i],
+				                                          p.ys[i],
+				                                          p.zs[i],
+				                                          sqrRadius,
+				                                          indices,
+				                                          distances);
+				for (uint32_t j = 0; j < n; ++j)
+				{
+					if (!visitor(p.indices[i], indices[j], distances[j]))
+						return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// descend into the larger octant, which shrinks the pairs of octants fastest.
+	if (otherOctant->isLeaf || (!octant->isLeaf && octant->extent >= otherOctant->extent))
+	{
+		for (uint32_t c = 0; c < 8; ++c)
+		{
+			const Octant* childOctant = child(octant, c);
+			if (childOctant != 0 && !radiusJoin<Distance>(childOctant, other, otherOctant, sqrRadius, visitor, buffers))
+				return false;
+		}
+	}
+	else
+	{
+		for (uint32_t c = 0; c < 8; ++c)
+		{
+			const Octant* childOctant = other.child(otherOctant, c);
+			if (childOctant != 0 && !radiusJoin<Distance>(octant, other, childOctant, sqrRadius, visitor, buffers))
+				return false;
+		}
+	}
+
+	return true;
+}
+
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::convexSearch(const std::vector<Halfspace>& halfspaces, std::vector<uint32_t>& resultIndices) const
+{
+	resultIndices.clear();
+	const uint32_t N = halfspaces.size();
+	if (N > 32)
+		return false;
+	if (root_ == 0)
+		return true;
+
+	const uint32_t active = (N == 32) ? ~uint32_t(0) : (uint32_t(1) << N) - 1;
+	convexSearch(root_, N > 0 ? &halfspaces[0] : 0, active, resultIndices);
+
+	return true;
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::convexSearch(const Octant* octant,
+                                              const Halfspace* halfspaces,
+                                              uint32_t active,
+                                              std::vector<uint32_t>& resultIndices) const
+{
+	// the octant is outside of a half-space, if its nearest corner is outside, and inside, if its farthest corner is
+	// inside. Only the remaining half-spaces have to be checked for the children.
+	uint32_t remaining = active;
+	for (uint32_t i = 0; i < 32 && (active >> i) != 0; ++i)
+	{
+		if ((active & (uint32_t(1) << i)) == 0)
+			continue;
+
+		const Halfspace& h = halfspaces[i];
+		const float dist = h.nx * octant->x + h.ny * octant->y + h.nz * octant->z - h.d;
+		const float projectedExtent = octant->extent * (std::abs(h.nx) + std::abs(h.ny) + std::abs(h.nz));
+		if (dist - projectedExtent > 0.0f)
+			return;
+		if (dist + projectedExtent <= 0.0f)
+			remaining &= ~(uint32_t(1) << i);
+	}
+
+	if (remaining == 0)
+	{
+		appendIndices(octant, resultIndices);
+		return;
+	}
+
+	if (octant->isLeaf)
+	{
+		uint32_t idx = octant->start;
+		for (uint32_t k = 0; k < octant->size; ++k)
+		{
+			float x, y, z;
+			uint32_t index;
+			if (params_.reorderPoints)
+			{
+				x = xs_[octant->offset + k];
+				y = ys_[octant->offset + k];
+				z = zs_[octant->offset + k];
+				index = permutation_[octant->offset + k];
+			}
+			else
+			{
+				const PointT& p = (*data_)[idx];
+				x = get<0>(p);
+				y = get<1>(p);
+				z = get<2>(p);
+				index = idx;
+				idx = successors_[idx];
+			}
+
+			bool inside = true;
+			for (uint32_t i = 0; i < 32 && (remaining >> i) != 0 && inside; ++i)
+			{
+				const Halfspace& h = halfspaces[i];
+				if ((remaining & (uint32_t(1) << i)) != 0 && h.nx * x + h.ny * y + h.nz * z > h.d)
+					inside = false;
+			}
+			if (inside)
+				resultIndices.push_back(index);
+		}
+
+		return;
+	}
+
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* childOctant = child(octant, c);
+		if (childOctant != 0)
+			convexSearch(childOctant, halfspaces, remaining, resultIndices);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::createOctant(std::vector<Octant>& octants,
+                                              uint32_t octantIdx,
+                                              float x,
+                                              float y,
+                                              float z,
+                                              float extent,
+                                              uint32_t startIdx,
+                                              uint32_t endIdx,
+                                              uint32_t size)
+{
+	// For a leaf we don't have to change anything; points are already correctly linked or correctly reordered.
+	// Note: octants is reallocated when allocating children, therefore octant is only valid until then.
+	Octant* octant = &octants[octantIdx];
+
+	octant->isLeaf = true;
+
+	octant->x = x;
+	octant->y = y;
+	octant->z = z;
+	octant->extent = extent;
+
+	octant->start = startIdx;
+	octant->end = endIdx;
+	octant->size = size;
+
+	static const float factor[] = { -0.5f, 0.5f };
+
+	// subdivide subset of points and re-link points according to Morton codes
+	if (size > params_.bucketSize && extent > 2 * params_.minExtent)
+	{
+		octant->isLeaf = false;
+
+		const ContainerT& points = *data_;
+		uint32_t childStarts[8] = { 0 };
+		uint32_t childEnds[8] = { 0 };
+		uint32_t childSizes[8] = { 0 };
+
+		// re-link disjoint child subsets...
+		uint32_t idx = startIdx;
+
+		for (uint32_t i = 0; i < size; ++i)
+		{
+			const PointT& p = points[idx];
+
+			// determine Morton code for each point...
+			const uint32_t mortonCode = childCode(x, y, z, p);
+
+			// set child starts and update successors...
+			if (childSizes[mortonCode] == 0)
+				childStarts[mortonCode] = idx;
+			else
+				successors_[childEnds[mortonCode]] = idx;
+			childSizes[mortonCode] += 1;
+
+			childEnds[mortonCode] = idx;
+			idx = successors_[idx];
+		}
+
+		// allocate all children consecutively...
+		uint8_t childMask = 0;
+		uint32_t numChildren = 0;
+		for (uint32_t i = 0; i < 8; ++i)
+		{
+			if (childSizes[i] == 0)
+				continue;
+			childMask |= (1 << i);
+			numChildren += 1;
+		}
+
+		const uint32_t firstChild = octants.size();
+		octant->firstChild = firstChild;
+		octant->childMask = childMask;
+		octants.resize(firstChild + numChildren);
+
+		// now, we can create the child nodes...
+		float childExtent = 0.5f * extent;
+
+		if (params_.parallelBuild && size > params_.parallelThreshold)
+		{
+			// children contain disjoint subsets of points, which are relinked independently of each other. Each
+			// subtree is built into its own array and afterwards appended in order of the children, which gives
+			// exactly the same octants as the serial construction.
+			std::vector<Octant> subtrees[8];
+			for (uint32_t i = 0; i < 8; ++i)
+			{
+				if (childSizes[i] == 0)
+					continue;
+
+				float childX = x + factor[(i & 1) > 0] * extent;
+				float childY = y + factor[(i & 2) > 0] * extent;
+				float childZ = z + factor[(i & 4) > 0] * extent;
+				std::vector<Octant>* subtree = &subtrees[i];
+				subtree->reserve(estimateOctants(childSizes[i]));
+				subtree->resize(1);
+
+#pragma omp task shared(childStarts, childEnds, childSizes) if (childSizes[i] > params_.parallelThreshold)
+				createOctant(*subtree, 0, childX, childY, childZ, childExtent, childStarts[i], childEnds[i], childSizes[i]);
+			}
+#pragma omp taskwait
+
+			uint32_t childIdx = firstChild;
+			for (uint32_t i = 0; i < 8; ++i)
+			{
+				if (childSizes[i] == 0)
+					continue;
+				appendSubtree(octants, childIdx, subtrees[i]);
+				childIdx += 1;
+			}
+		}
+		else
+		{
+			uint32_t childIdx = firstChild;
+			for (uint32_t i = 0; i < 8; ++i)
+			{
+				if (childSizes[i] == 0)
+					continue;
+
+				float childX = x + factor[(i & 1) > 0] * extent;
+				float childY = y + factor[(i & 2) > 0] * extent;
+				float childZ = z + factor[(i & 4) > 0] * extent;
+
+				createOctant(octants, childIdx, childX, childY, childZ, childExtent, childStarts[i], childEnds[i], childSizes[i]);
+				childIdx += 1;
+			}
+		}
+
+		for (uint32_t childIdx = firstChild; childIdx < firstChild + numChildren; ++childIdx)
+		{
+			if (childIdx == firstChild)
+				octants[octantIdx].start = octants[childIdx].start;
+			else
+				successors_[octants[childIdx - 1].end] =
+				    octants[childIdx].start; // we have to ensure that also the child ends link to the next child start.
+
+			octants[octantIdx].end = octants[childIdx].end;
+		}
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::createMortonRoot(float x, float y, float z, float extent, uint32_t startIdx, uint32_t size)
+{
+	std::vector<uint32_t> chain(size), ranks(size);
+	uint32_t idx = startIdx;
+	for (uint32_t i = 0; i < size; ++i)
+	{
+		chain[i] = idx;
+		ranks[i] = i;
+		idx = successors_[idx];
+	}
+
+	// the keys only need a few levels more than the depth of balanced octrees, since deeper octants contain only few
+	// points, which are cheaply relinked by createOctant. Octants with extent <= 2 * minExtent are never split.
+	uint32_t levels = 4;
+	for (uint32_t n = size / std::max(params_.bucketSize, 1u); n > 1 && levels < mortonLevels; n /= 8)
+		levels += 1;
+	uint32_t splitLevels = 0;
+	for (float e = extent; e > 2 * params_.minExtent && splitLevels < levels; e *= 0.5f)
+		splitLevels += 1;
+	levels = std::max(splitLevels, 1u);
+
+	std::vector<uint64_t> keys(size);
+	const int32_t numBlocks = (size + mortonBlockSize - 1) / mortonBlockSize;
+#pragma omp parallel for if (params_.parallelBuild)
+	for (int32_t b = 0; b < numBlocks; ++b)
+	{
+		const uint32_t first = b * mortonBlockSize;
+		mortonKeys(&chain[first], std::min(uint32_t(mortonBlockSize), size - first), x, y, z, extent, levels, &keys[first]);
+	}
+
+	radixSort(keys, ranks, 3 * levels, params_.parallelBuild);
+	createMortonOctant(octants_, 0, x, y, z, extent, keys, ranks, chain, 0, size, 0, levels);
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::mortonKeys(const uint32_t* chain,
+                                            uint32_t size,
+                                            float x,
+                                            float y,
+                                            float z,
+                                            float extent,
+                                            uint32_t levels,
+                                            uint64_t* keys) const
+{
+	// the levels are processed for a whole block of points at once, which allows to vectorize the comparisons with
+	// the centers of the octants.
+	const ContainerT& points = *data_;
+	float coordinates[3][mortonBlockSize], centers[3][mortonBlockSize];
+	uint32_t cells[3][mortonBlockSize];
+	for (uint32_t i = 0; i < mortonBlockSize; ++i)
+	{
+		const PointT& p = points[chain[std::min(i, size - 1)]];
+		coordinates[0][i] = get<0>(p);
+		coordinates[1][i] = get<1>(p);
+		coordinates[2][i] = get<2>(p);
+		centers[0][i] = x;
+		centers[1][i] = y;
+		centers[2][i] = z;
+		cells[0][i] = cells[1][i] = cells[2][i] = 0;
+	}
+
+	for (uint32_t level = 0; level < levels; ++level)
+	{
+		// the child centers are x + factor[b] * extent as in createOctant, i.e., exactly x +/- 0.5 * extent.
+		const float childExtent = 0.5f * extent;
+		for (uint32_t a = 0; a < 3; ++a)
+		{
+			for (uint32_t i = 0; i < mortonBlockSize; ++i)
+			{
+				const uint32_t b = (coordinates[a][i] > centers[a][i]);
+				cells[a][i] = (cells[a][i] << 1) | b;
+				centers[a][i] += b ? childExtent : -childExtent;
+			}
+		}
+		extent = childExtent;
+	}
+
+	for (uint32_t i = 0; i < size; ++i)
+		keys[i] = spreadBits(cells[0][i]) | (spreadBits(cells[1][i]) << 1) | (spreadBits(cells[2][i]) << 2);
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::createMortonOctant(std::vector<Octant>& octants,
+                                                    uint32_t octantIdx,
+                                                    float x,
+                                                    float y,
+                                                    float z,
+                                                    float extent,
+                                                    const std::vector<uint64_t>& keys,
+                                                    std::vector<uint32_t>& ranks,
+                                                    const std::vector<uint32_t>& chain,
+                                                    uint32_t first,
+                                                    uint32_t last,
+                                                    uint32_t level,
+                                                    uint32_t levels)
+{
+	const uint32_t size = last - first;
+	const bool isLeaf = (size <= params_.bucketSize || extent <= 2 * params_.minExtent);
+	if (isLeaf || level == levels)
+	{
+		// createOctant keeps the order of the successor list inside of leafs, which the stable sort only keeps among
+		// points with the same key. Below the levels of the keys, the keys do not distinguish the points anymore and
+		// createOctant relinks the points as usual.
+		if (isLeaf)
+			std::sort(ranks.begin() + first, ranks.begin() + last);
+		for (uint32_t i = first; i + 1 < last; ++i)
+			successors_[chain[ranks[i]]] = chain[ranks[i + 1]];
+
+		createOctant(octants, octantIdx, x, y, z, extent, chain[ranks[first]], chain[ranks[last - 1]], size);
+		return;
+	}
+
+	Octant* octant = &octants[octantIdx];
+	octant->isLeaf = false;
+	octant->x = x;
+	octant->y = y;
+	octant->z = z;
+	octant->extent = extent;
+	octant->size = size;
+
+	// the children are consecutive ranges of the sorted keys with the child codes of the level.
+	const uint32_t shift = 3 * (levels - 1 - level);
+	uint32_t childFirst[9];
+	childFirst[0] = first;
+	for (uint32_t i = 1; i < 8; ++i)
+	{
+		uint32_t lower = childFirst[i - 1], upper = last;
+		while (lower < upper)
+		{
+			const uint32_t mid = lower + (upper - lower) / 2;
+			if (((keys[mid] >> shift) & 7) < i)
+				lower = mid + 1;
+			else
+				upper = mid;
+		}
+		childFirst[i] = lower;
+	}
+	childFirst[8] = last;
+
+	uint8_t childMask = 0;
+	uint32_t numChildren = 0;
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		if (childFirst[i] == childFirst[i + 1])
+			continue;
+		childMask |= (1 << i);
+		numChildren += 1;
+	}
+
+	const uint32_t firstChild = octants.size();
+	octant->firstChild = firstChild;
+	octant->childMask = childMask;
+	octants.resize(firstChild + numChildren);
+
+	static const float factor[] = { -0.5f, 0.5f };
+	const float childExtent = 0.5f * extent;
+	uint32_t childIdx = firstChild;
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		if (childFirst[i] == childFirst[i + 1])
+			continue;
+
+		float childX = x + factor[(i & 1) > 0] * extent;
+		float childY = y + factor[(i & 2) > 0] * extent;
+		float childZ = z + factor[(i & 4) > 0] * extent;
+
+		createMortonOctant(octants, childIdx, childX, childY, childZ, childExtent, keys, ranks, chain, childFirst[i], childFirst[i + 1], level + 1, levels);
+		childIdx += 1;
+	}
+
+	for (childIdx = firstChild; childIdx < firstChild + numChildren; ++childIdx)
+	{
+		if (childIdx == firstChild)
+			octants[octantIdx].start = octants[childIdx].start;
+		else
+			successors_[octants[childIdx - 1].end] = octants[childIdx].start;
+
+		octants[octantIdx].end = octants[childIdx].end;
+	}
+}
+
+template <typename PointT, typename ContainerT>
+void Octree<PointT, ContainerT>::appendSubtree(std::vector<Octant>& octants, uint32_t octantIdx, const std::vector<Octant>& subtree)
+{
+	// all descendants of subtree[0] are stored behind it, i.e., their indexes are shifted by offset.
+	const uint32_t offset = octants.size() - 1;
+	octants.insert(octants.end(), subtree.begin() + 1, subtree.end());
+	octants[octantIdx] = subtree[0];
+	if (!subtree[0].isLeaf)
+		octants[octantIdx].firstChild += offset;
+	for (uint32_t i = offset + 1; i < octants.size(); ++i)
+	{
+		if (!octants[i].isLeaf)
+			octants[i].firstChild += offset;
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+void Octree<PointT, ContainerT>::radiusNeighbors(const Octant* octant, const PointT& query, float radius, float sqrRadius, std::vector<uint32_t>& resultIndices)
+    const
+{
+	if (collectQueryStats)
+		threadStats().octantsVisited += 1;
+
+	// if search ball S(q,r) contains octant, simply add point indexes.
+	if (contains<Distance>(query, sqrRadius, octant))
+	{
+		if (collectQueryStats)
+		{
+			threadStats().containedOctants += 1;
+			threadStats().results += octant->size;
+		}
+
+		// the permutation is also available for quantized points.
+		if (permutation_ != 0)
+		{
+			const uint32_t* first = &permutation_[octant->offset];
+			resultIndices.insert(resultIndices.end(), first, first + octant->size);
+			return; // early pruning.
+		}
+
+		uint32_t idx = octant->start;
+		for (uint32_t i = 0; i < octant->size; ++i)
+		{
+			resultIndices.push_back(idx);
+			idx = successors_[idx];
+		}
+
+		return; // early pruning.
+	}
+
+	if (octant->isLeaf)
+	{
+		if (params_.reorderPoints)
+		{
+			const uint32_t first = resultIndices.size(), offset = octant->offset;
+			resultIndices.resize(first + octant->size);
+			uint32_t n = simd::Scan<Distance>::radius(&xs_[offset],
+			                                          &ys_[offset],
+			                                          &zs_[offset],
+			                                          &permutation_[offset],
+			                                          octant->size,
+			                                          get<0>(query),
+			                                          get<1>(query),
+			                                          get<2>(query),
+			                                          sqrRadius,
+			                                          &resultIndices[first],
+			                                          0);
+			resultIndices.resize(first + n);
+			if (collectQueryStats)
+			{
+				threadStats().pointsTested += octant->size;
+				threadStats().results += n;
+			}
+
+			return;
+		}
+
+		const uint32_t first = resultIndices.size();
+		if (!quantized_.empty())
+		{
+			quantizedRadiusNeighbors<Distance>(octant, query, radius, sqrRadius, resultIndices, 0);
+		}
+		else
+		{
+			uint32_t idx = octant->start;
+			for (uint32_t i = 0; i < octant->size; ++i)
+			{
+				float dist = Distance::compute(query, (*data_)[idx]);
+				if (dist < sqrRadius)
+					resultIndices.push_back(idx);
+				idx = successors_[idx];
+			}
+		}
+		if (collectQueryStats)
+		{
+			threadStats().pointsTested += octant->size;
+			threadStats().results += resultIndices.size() - first;
+		}
+
+		return;
+	}
+
+	// check whether child nodes are in range.
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* childOctant = child(octant, c);
+		if (childOctant == 0)
+			continue;
+		if (collectQueryStats)
+			threadStats().overlapTests += 1;
+		if (!overlaps<Distance>(query, radius, sqrRadius, childOctant))
+			continue;
+		radiusNeighbors<Distance>(childOctant, query, radius, sqrRadius, resultIndices);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+void Octree<PointT, ContainerT>::radiusNeighbors(const Octant* octant,
+                                                 const PointT& query,
+                                                 float radius,
+                                                 float sqrRadius,
+                                                 std::vector<uint32_t>& resultIndices,
+                                                 std::vector<float>& distances) const
+{
+	if (collectQueryStats)
+		threadStats().octantsVisited += 1;
+
+	// if search ball S(q,r) contains octant, simply add point indexes and compute squared distances.
+	if (contains<Distance>(query, sqrRadius, octant))
+	{
+		if (collectQueryStats)
+		{
+			threadStats().containedOctants += 1;
+			threadStats().results += octant->size;
+		}
+
+		if (params_.reorderPoints)
+		{
+			const uint32_t* first = &permutation_[octant->offset];
+			resultIndices.insert(resultIndices.end(), first, first + octant->size);
+
+			const float qx = get<0>(query), qy = get<1>(query), qz = get<2>(query);
+			for (uint32_t k = octant->offset; k < octant->offset + octant->size; ++k)
+				distances.push_back(Distance::norm(qx - xs_[k], qy - ys_[k], qz - zs_[k]));
+
+			return; // early pruning.
+		}
+
+		uint32_t idx = octant->start;
+		for (uint32_t i = 0; i < octant->size; ++i)
+		{
+			resultIndices.push_back(idx);
+			distances.push_back(Distance::compute(query, (*data_)[idx]));
+			idx = successors_[idx];
+		}
+
+		return; // early pruning.
+	}
+
+	if (octant->isLeaf)
+	{
+		if (params_.reorderPoints)
+		{
+			const uint32_t first = resultIndices.size(), offset = octant->offset;
+			resultIndices.resize(first + octant->size);
+			distances.resize(first + octant->size);
+			uint32_t n = simd::Scan<Distance>::radius(&xs_[offset],
+			                                          &ys_[offset],
+			                                          &zs_[offset],
+			                                          &permutation_[offset],
+			                                          octant->size,
+			                                          get<0>(query),
+			                                          get<1>(query),
+			                                          get<2>(query),
+			                                          sqrRadius,
+			                                          &resultIndices[first],
+			                                          &distances[first]);
+			resultIndices.resize(first + n);
+			distances.resize(first + n);
+			if (collectQueryStats)
+			{
+				threadStats().pointsTested += octant->size;
+				threadStats().results += n;
+			}
+
+			return;
+		}
+
+		const uint32_t first = resultIndices.size();
+		if (!quantized_.empty())
+		{
+			quantizedRadiusNeighbors<Distance>(octant, query, radius, sqrRadius, resultIndices, &distances);
+		}
+		else
+		{
+			uint32_t idx = octant->start;
+			for (uint32_t i = 0; i < octant->size; ++i)
+			{
+				float dist = Distance::compute(query, (*data_)[idx]);
+				if (dist < sqrRadius)
+				{
+					resultIndices.push_back(idx);
+					distances.push_back(dist);
+				}
+				idx = successors_[idx];
+			}
+		}
+		if (collectQueryStats)
+		{
+			threadStats().pointsTested += octant->size;
+			threadStats().results += resultIndices.size() - first;
+		}
+
+		return;
+	}
+
+	// check whether child nodes are in range.
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* childOctant = child(octant, c);
+		if (childOctant == 0)
+			continue;
+		if (collectQueryStats)
+			threadStats().overlapTests += 1;
+		if (!overlaps<Distance>(query, radius, sqrRadius, childOctant))
+			continue;
+		radiusNeighbors<Distance>(childOctant, query, radius, sqrRadius, resultIndices, distances);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+void Octree<PointT, ContainerT>::radiusNeighbors(const PointT& query, float radius, std::vector<uint32_t>& resultIndices) const
+{
+	resultIndices.clear();
+	if (collectQueryStats)
+		threadStats().queries += 1;
+	if (root_ == 0)
+		return;
+
+	float sqrRadius = Distance::sqr(radius); // "squared" radius
+	radiusNeighbors<Distance>(root_, query, radius, sqrRadius, resultIndices);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+void Octree<PointT, ContainerT>::radiusNeighbors(const PointT& query, float radius, std::vector<uint32_t>& resultIndices, std::vector<float>& distances) const
+{
+	resultIndices.clear();
+	distances.clear();
+	if (collectQueryStats)
+		threadStats().queries += 1;
+	if (root_ == 0)
+		return;
+
+	float sqrRadius = Distance::sqr(radius); // "squared" radius
+	radiusNeighbors<Distance>(root_, query, radius, sqrRadius, resultIndices, distances);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance, typename VisitorT>
+bool Octree<PointT, ContainerT>::visitRadiusNeighbors(const Octant* octant,
+                                                      const PointT& query,
+                                                      float radius,
+                                                      float sqrRadius,
+                                                      VisitorT& visitor) const
+{
+	const float qx = get<0>(query), qy = get<1>(query), qz = get<2>(query);
+
+	// if search ball S(q,r) contains octant, all points are neighbors.
+	if (contains<Distance>(query, sqrRadius, octant))
+	{
+		if (params_.reorderPoints)
+		{
+			for (uint32_t k = octant->offset; k < octant->offset + octant->size; ++k)
+			{
+				if (!visitor(permutation_[k], Distance::norm(qx - xs_[k], qy - ys_[k], qz - zs_[k])))
+					return false;
+			}
+
+			return true;
+		}
+
+		uint32_t idx = octant->start;
+		for (uint32_t i = 0; i < octant->size; ++i)
+		{
+			if (!visitor(idx, Distance::compute(query, (*data_)[idx])))
+				return false;
+			idx = successors_[idx];
+		}
+
+		return true;
+	}
+
+	if (octant->isLeaf)
+	{
+		if (params_.reorderPoints)
+		{
+			// the vectorized scan filters blocks of points, whose neighbors are afterwards passed to the visitor.
+			const uint32_t blockSize = 64;
+			uint32_t indices[blockSize];
+			float distances[blockSize];
+			const uint32_t last = octant->offset + octant->size;
+			for (uint32_t first = octant->offset; first < last; first += blockSize)
+			{
+				uint32_t n = simd::Scan<Distance>::radius(&xs_[first],
+				                                          &ys_[first],
+				                                          &zs_[first],
+				                                          &permutation_[first],
+				                                          std::min(blockSize, last - first),
+				                                          qx,
+				                                          qy,
+				                                          qz,
+				                                          sqrRadius,
+				                                          indices,
+				                                          distances);
+				for (uint32_t i = 0; i < n; ++i)
+				{
+					if (!visitor(indices[i], distances[i]))
+						return false;
+				}
+			}
+
+			return true;
+		}
+
+		uint32_t idx = octant->start;
+		for (uint32_t i = 0; i < octant->size; ++i)
+		{
+			float dist = Distance::compute(query, (*data_)[idx]);
+			if (dist < sqrRadius && !visitor(idx, dist))
+				return false;
+			idx = successors_[idx];
+		}
+
+		return true;
+	}
+
+	// check whether child nodes are in range.
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* childOctant = child(octant, c);
+		if (childOctant == 0)
+			continue;
+		if (!overlaps<Distance>(query, radius, sqrRadius, childOctant))
+			continue;
+		if (!visitRadiusNeighbors<Distance>(childOctant, query, radius, sqrRadius, visitor))
+			return false;
+	}
+
+	return true;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance, typename VisitorT>
+bool Octree<PointT, ContainerT>::radiusNeighbors(const PointT& query, float radius, VisitorT&& visitor) const
+{
+	if (root_ == 0)
+		return true;
+
+	return visitRadiusNeighbors<Distance>(root_, query, radius, Distance::sqr(radius), visitor);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+uint32_t Octree<PointT, ContainerT>::radiusNeighbors(const PointT& query,
+                                                     float radius,
+                                                     uint32_t* resultIndices,
+                                                     float* sqrDistances,
+                                                     uint32_t capacity,
+                                                     bool& truncated) const
+{
+	BufferVisitor visitor(resultIndices, sqrDistances, capacity);
+	truncated = !radiusNeighbors<Distance>(query, radius, visitor);
+
+	return visitor.size;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance, typename QueryContainerT>
+void Octree<PointT, ContainerT>::radiusNeighborsBatch(const QueryContainerT& queries,
+                                                      float radius,
+                                                      std::vector<uint64_t>& offsets,
+                                                      std::vector<uint32_t>& resultIndices) const
+{
+	radiusNeighborsBatch<Distance>(queries, radius, offsets, resultIndices, 0);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance, typename QueryContainerT>
+void Octree<PointT, ContainerT>::radiusNeighborsBatch(const QueryContainerT& queries,
+                                                      float radius,
+                                                      std::vector<uint64_t>& offsets,
+                                                      std::vector<uint32_t>& resultIndices,
+                                                      std::vector<float>& distances) const
+{
+	radiusNeighborsBatch<Distance>(queries, radius, offsets, resultIndices, &distances);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance, typename QueryContainerT>
+void Octree<PointT, ContainerT>::radiusNeighborsBatch(const QueryContainerT& queries,
+                                                      float radius,
+                                                      std::vector<uint64_t>& offsets,
+                                                      std::vector<uint32_t>& resultIndices,
+                                                      std::vector<float>* distances) const
+{
+	const uint32_t N = queries.size();
+	offsets.assign(N + 1, 0);
+	resultIndices.clear();
+	if (distances != 0)
+		distances->clear();
+	if (root_ == 0 || N == 0)
+		return;
+
+	std::vector<uint32_t> order;
+	sortByMortonCode(queries, order);
+
+	// every thread collects its results in its own buffers, which are afterwards merged in order of the queries.
+	const int32_t numThreads = maxThreads();
+	std::vector<std::vector<uint32_t> > threadIndices(numThreads);
+	std::vector<std::vector<float> > threadDistances(numThreads);
+	std::vector<int32_t> owner(N);
+	std::vector<uint64_t> location(N);
+	const float sqrRadius = Distance::sqr(radius);
+
+#pragma omp parallel num_threads(numThreads)
+	{
+		const int32_t t = threadIndex();
+		std::vector<uint32_t>& indices = threadIndices[t];
+		std::vector<float>& dists = threadDistances[t];
+
+#pragma omp for schedule(dynamic, 64)
+		for (int32_t i = 0; i < int32_t(N); ++i)
+		{
+			const uint32_t q = order[i];
+			owner[q] = t;
+			location[q] = indices.size();
+			if (collectQueryStats)
+				threadStats().queries += 1;
+			if (distances != 0)
+				radiusNeighbors<Distance>(root_, queries[q], radius, sqrRadius, indices, dists);
+			else
+				radiusNeighbors<Distance>(root_, queries[q], radius, sqrRadius, indices);
+			offsets[q + 1] = indices.size() - location[q];
+		}
+	}
+
+	for (uint32_t q = 0; q < N; ++q)
+		offsets[q + 1] += offsets[q];
+
+	resultIndices.resize(offsets[N]);
+	if (distances != 0)
+		distances->resize(offsets[N]);
+
+#pragma omp parallel for schedule(dynamic, 256) num_threads(numThreads)
+	for (int32_t q = 0; q < int32_t(N); ++q)
+	{
+		const uint64_t count = offsets[q + 1] - offsets[q];
+		if (count == 0)
+			continue;
+
+		const uint32_t* indices = &threadIndices[owner[q]][location[q]];
+		std::copy(indices, indices + count, resultIndices.begin() + offsets[q]);
+		if (distances != 0)
+		{
+			const float* dists = &threadDistances[owner[q]][location[q]];
+			std::copy(dists, dists + count, distances->begin() + offsets[q]);
+		}
+	}
+}
+
+template <typename PointT, typename ContainerT>
+uint64_t Octree<PointT, ContainerT>::mortonCode(float x, float y, float z) const
+{
+	const uint32_t maxCell = (1 << 21) - 1;
+	const float scale = (root_->extent > 0.0f) ? maxCell / (2.0f * root_->extent) : 0.0f;
+	const float p[3] = { x - (root_->x - root_->extent), y - (root_->y - root_->extent), z - (root_->z - root_->extent) };
+
+	uint64_t code = 0;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		// quantize and spread the 21 bits such that two zero bits are between consecutive bits.
+		float cell = std::min(std::max(p[i] * scale, 0.0f), float(maxCell));
+		code |= spreadBits(uint64_t(cell)) << i;
+	}
+
+	return code;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename QueryContainerT>
+void Octree<PointT, ContainerT>::sortByMortonCode(const QueryContainerT& queries, std::vector<uint32_t>& order) const
+{
+	const uint32_t N = queries.size();
+	std::vector<std::pair<uint64_t, uint32_t> > codes(N);
+#pragma omp parallel for
+	for (int32_t i = 0; i < int32_t(N); ++i)
+	{
+		const PointT& q = queries[i];
+		codes[i] = std::make_pair(mortonCode(get<0>(q), get<1>(q), get<2>(q)), uint32_t(i));
+	}
+	std::sort(codes.begin(), codes.end());
+
+	order.resize(N);
+	for (uint32_t i = 0; i < N; ++i)
+		order[i] = codes[i].second;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+bool Octree<PointT, ContainerT>::overlaps(const PointT& query, float radius, float sqRadius, const Octant* o)
+{
+	// we exploit the symmetry to reduce the test to testing if its inside the Minkowski sum around the positive quadrant.
+	float x = get<0>(query) - o->x;
+	float y = get<1>(query) - o->y;
+	float z = get<2>(query) - o->z;
+
+	x = std::abs(x);
+	y = std::abs(y);
+	z = std::abs(z);
+
+	float maxdist = radius + o->extent;
+
+	// Completely outside, since q' is outside the relevant area.
+	if (x > maxdist || y > maxdist || z > maxdist)
+		return false;
+
+	int32_t num_less_extent = (x < o->extent) + (y < o->extent) + (z < o->extent);
+
+	// Checking different cases:
+
+	// a. inside the surface region of the octant.
+	if (num_less_extent > 1)
+		return true;
+
+	// b. checking the corner region && edge region.
+	x = std::max(x - o->extent, 0.0f);
+	y = std::max(y - o->extent, 0.0f);
+	z = std::max(z - o->extent, 0.0f);
+
+	return (Distance::norm(x, y, z) < sqRadius);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+bool Octree<PointT, ContainerT>::contains(const PointT& query, float sqRadius, const Octant* o)
+{
+	// we exploit the symmetry to reduce the test to test
+	// whether the farthest corner is inside the search ball.
+	float x = get<0>(query) - o->x;
+	float y = get<1>(query) - o->y;
+	float z = get<2>(query) - o->z;
+
+	x = std::abs(x);
+	y = std::abs(y);
+	z = std::abs(z);
+	// reminder: (x, y, z) - (-e, -e, -e) = (x, y, z) + (e, e, e)
+	x += o->extent;
+	y += o->extent;
+	z += o->extent;
+
+	return (Distance::norm(x, y, z) < sqRadius);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+int32_t Octree<PointT, ContainerT>::findNeighbor(const PointT& query, float minDistance) const
+{
+	float maxDistance = std::numeric_limits<float>::infinity();
+	int32_t resultIndex = -1;
+	if (collectQueryStats)
+		threadStats().queries += 1;
+	if (root_ == 0)
+		return resultIndex;
+
+	findNeighbor<Distance>(root_, query, minDistance, maxDistance, resultIndex);
+	if (collectQueryStats && resultIndex >= 0)
+		threadStats().results += 1;
+
+	return resultIndex;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance, typename QueryContainerT>
+void Octree<PointT, ContainerT>::findNeighbors(const QueryContainerT& queries, int32_t* resultIndices, float* sqrDistances, float minDistance) const
+{
+	const uint32_t N = queries.size();
+	if (N == 0)
+		return;
+
+	if (root_ == 0)
+	{
+		std::fill(resultIndices, resultIndices + N, -1);
+		if (sqrDistances != 0)
+			std::fill(sqrDistances, sqrDistances + N, std::numeric_limits<float>::infinity());
+		return;
+	}
+
+	std::vector<uint32_t> order;
+	sortByMortonCode(queries, order);
+
+	// blocks of subsequent queries are processed by the same thread to exploit their coherence.
+	const uint32_t blockSize = 256;
+	const int32_t numBlocks = (N + blockSize - 1) / blockSize;
+#pragma omp parallel for schedule(dynamic, 1)
+	for (int32_t b = 0; b < numBlocks; ++b)
+	{
+		const uint32_t first = b * blockSize;
+		findNeighbors<Distance>(queries, order, first, std::min(first + blockSize, N), resultIndices, sqrDistances, minDistance);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance, typename QueryContainerT>
+void Octree<PointT, ContainerT>::findNeighbors(const QueryContainerT& queries,
+                                               const std::vector<uint32_t>& order,
+                                               uint32_t first,
+                                               uint32_t last,
+                                               int32_t* resultIndices,
+                                               float* sqrDistances,
+                                               float minDistance) const
+{
+	// octants from the root to the leaf of the previous query and the previous query with its nearest neighbor.
+	std::vector<const Octant*> path;
+	bool hasPrevious = false;
+	uint32_t previous = 0;
+	float previousDistance = 0.0f;
+
+	for (uint32_t i = first; i < last; ++i)
+	{
+		const uint32_t q = order[i];
+		const PointT& query = queries[q];
+		if (collectQueryStats)
+			threadStats().queries += 1;
+
+		int32_t resultIndex = -1;
+		float maxDistance = std::numeric_limits<float>::infinity();
+		if (root_ != 0)
+		{
+			// the previous neighbor is at most previousDistance + d(previous, query) away, which is slightly enlarged
+			// to find it again with its exact distance.
+			float bound = std::numeric_limits<float>::infinity();
+			if (hasPrevious)
+				bound = (previousDistance + Distance::sqrt(Distance::compute(queries[previous], query))) * 1.0001f + 1e-6f;
+
+			while (!path.empty() && !inside(query, bound, path.back()))
+				path.pop_back();
+			const Octant* start = path.empty() ? root_ : path.back();
+
+			maxDistance = bound;
+			findNeighbor<Distance>(start, query, minDistance, maxDistance, resultIndex);
+			if (resultIndex < 0 && bound < std::numeric_limits<float>::infinity())
+			{
+				// the previous neighbor is not allowed by minDistance and the nearest neighbor can be farther away.
+				maxDistance = std::numeric_limits<float>::infinity();
+				start = root_;
+				findNeighbor<Distance>(start, query, minDistance, maxDistance, resultIndex);
+			}
+
+			// the path of the next query starts with the path to the leaf of this query.
+			if (path.empty())
+				path.push_back(root_);
+			for (const Octant* octant = path.back(); !octant->isLeaf;)
+			{
+				uint32_t mortonCode = 0;
+				if (get<0>(query) > octant->x)
+					mortonCode |= 1;
+				if (get<1>(query) > octant->y)
+					mortonCode |= 2;
+				if (get<2>(query) > octant->z)
+					mortonCode |= 4;
+				octant = child(octant, mortonCode);
+				if (octant == 0)
+					break;
+				path.push_back(octant);
+			}
+		}
+
+		hasPrevious = (resultIndex >= 0);
+		previous = q;
+		previousDistance = maxDistance;
+		if (collectQueryStats && resultIndex >= 0)
+			threadStats().results += 1;
+
+		resultIndices[q] = resultIndex;
+		if (sqrDistances == 0)
+			continue;
+		if (resultIndex < 0)
+			sqrDistances[q] = std::numeric_limits<float>::infinity();
+		else if (data_ != 0)
+			sqrDistances[q] = Distance::compute(query, (*data_)[resultIndex]);
+		else
+			sqrDistances[q] = Distance::sqr(maxDistance);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+int32_t Octree<PointT, ContainerT>::findNeighbor(const PointT& query, const ApproximateParams& approx, bool& exact, float minDistance) const
+{
+	float maxDistance = std::numeric_limits<float>::infinity();
+	int32_t resultIndex = -1;
+	exact = true;
+	if (collectQueryStats)
+		threadStats().queries += 1;
+	if (root_ == 0)
+		return resultIndex;
+
+	ApproximateState state(approx);
+	findNeighbor<Distance>(root_, query, minDistance, maxDistance, resultIndex, &state);
+	if (collectQueryStats && resultIndex >= 0)
+		threadStats().results += 1;
+	exact = !state.relaxed && !state.exhausted;
+
+	return resultIndex;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+bool Octree<PointT, ContainerT>::overlaps(const PointT& query, float radius, const Octant* octant, ApproximateState* approx) const
+{
+	if (!overlaps<Distance>(query, radius, Distance::sqr(radius), octant))
+		return false;
+	if (approx == 0 || approx->scale == 1.0f)
+		return true;
+
+	const float shrunkRadius = approx->scale * radius;
+	if (overlaps<Distance>(query, shrunkRadius, Distance::sqr(shrunkRadius), octant))
+		return true;
+
+	approx->relaxed = true;
+	return false;
+}
+
+template <typename PointT, typename ContainerT>
+bool Octree<PointT, ContainerT>::inside(const PointT& query, float radius, const Octant* octant, ApproximateState* approx) const
+{
+	if (inside(query, radius, octant))
+		return true;
+	if (approx == 0 || approx->scale == 1.0f || !inside(query, approx->scale * radius, octant))
+		return false;
+
+	approx->relaxed = true;
+	return true;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+bool Octree<PointT, ContainerT>::findNeighbor(const Octant* octant,
+                                              const PointT& query,
+                                              float minDistance,
+                                              float& maxDistance,
+                                              int32_t& resultIndex,
+                                              ApproximateState* approx) const
+{
+	if (collectQueryStats)
+		threadStats().octantsVisited += 1;
+
+	// 1. first descend to leaf and check in leafs points.
+	if (octant->isLeaf)
+	{
+		// with an exhausted budget, the search stops.
+		if (approx != 0 && !approx->visit(octant->size))
+			return true;
+		if (collectQueryStats)
+			threadStats().pointsTested += octant->size;
+
+		float sqrMaxDistance = Distance::sqr(maxDistance);
+		float sqrMinDistance = (minDistance < 0) ? minDistance : Distance::sqr(minDistance);
+
+		if (params_.reorderPoints)
+		{
+			const uint32_t offset = octant->offset;
+			uint32_t nearest = simd::Scan<Distance>::nearest(&xs_[offset],
+			                                                 &ys_[offset],
+			                                                 &zs_[offset],
+			                                                 octant->size,
+			                                                 get<0>(query),
+			                                                 get<1>(query),
+			                                                 get<2>(query),
+			                                                 sqrMinDistance,
+			                                                 sqrMaxDistance);
+			if (nearest < octant->size)
+				resultIndex = permutation_[offset + nearest];
+		}
+		else
+		{
+			uint32_t idx = octant->start;
+			for (uint32_t i = 0; i < octant->size; ++i)
+			{
+				float dist = Distance::compute(query, (*data_)[idx]);
+				if (dist > sqrMinDistance && dist < sqrMaxDistance)
+				{
+					resultIndex = idx;
+					sqrMaxDistance = dist;
+				}
+				idx = successors_[idx];
+			}
+		}
+
+		maxDistance = Distance::sqrt(sqrMaxDistance);
+		return inside(query, maxDistance, octant, approx);
+	}
+
+	// determine Morton code for each point...
+	uint32_t mortonCode = 0;
+	if (get<0>(query) > octant->x)
+		mortonCode |= 1;
+	if (get<1>(query) > octant->y)
+		mortonCode |= 2;
+	if (get<2>(query) > octant->z)
+		mortonCode |= 4;
+
+	const Octant* nearestChild = child(octant, mortonCode);
+	if (nearestChild != 0)
+	{
+		if (findNeighbor<Distance>(nearestChild, query, minDistance, maxDistance, resultIndex, approx))
+			return true;
+	}
+
+	// 2. check adjacent octants for overlap and check these if necessary.
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		if (c == mortonCode)
+			continue;
+		const Octant* childOctant = child(octant, c);
+		if (childOctant == 0)
+			continue;
+		if (collectQueryStats)
+			threadStats().overlapTests += 1;
+		if (!overlaps<Distance>(query, maxDistance, childOctant, approx))
+			continue;
+		if (findNeighbor<Distance>(childOctant, query, minDistance, maxDistance, resultIndex, approx))
+			return true; // early pruning
+	}
+
+	// all children have been checked...check if point is inside the current octant...
+	return inside(query, maxDistance, octant, approx);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+void Octree<PointT, ContainerT>::knnNeighbors(const PointT& query,
+                                              uint32_t k,
+                                              std::vector<uint32_t>& resultIndices,
+                                              std::vector<float>& sqrDistances,
+                                              float minDistance) const
+{
+	resultIndices.clear();
+	sqrDistances.clear();
+	if (root_ == 0 || k == 0)
+		return;
+
+	std::vector<KnnEntry> heap;
+	heap.reserve(k);
+	float maxDistance = std::numeric_limits<float>::infinity();
+	float sqrMinDistance = (minDistance < 0) ? minDistance : Distance::sqr(minDistance);
+	knnNeighbors<Distance>(root_, query, k, sqrMinDistance, std::numeric_limits<float>::infinity(), maxDistance, heap);
+
+	std::sort_heap(heap.begin(), heap.end());
+	resultIndices.reserve(heap.size());
+	sqrDistances.reserve(heap.size());
+	for (uint32_t i = 0; i < heap.size(); ++i)
+	{
+		sqrDistances.push_back(heap[i].first);
+		resultIndices.push_back(heap[i].second);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+void Octree<PointT, ContainerT>::radiusKnn(const PointT& query,
+                                           float radius,
+                                           uint32_t k,
+                                           std::vector<uint32_t>& resultIndices,
+                                           std::vector<float>& sqrDistances,
+                                           float minDistance) const
+{
+	resultIndices.clear();
+	sqrDistances.clear();
+	if (root_ == 0 || k == 0 || !(radius > 0))
+		return;
+
+	std::vector<KnnEntry> heap;
+	heap.reserve(k);
+	// the radius is the initial bound, which shrinks to the distance of the k-th neighbor.
+	float maxDistance = radius;
+	float sqrMinDistance = (minDistance < 0) ? minDistance : Distance::sqr(minDistance);
+	if (overlaps<Distance>(query, radius, Distance::sqr(radius), root_))
+		knnNeighbors<Distance>(root_, query, k, sqrMinDistance, Distance::sqr(radius), maxDistance, heap);
+
+	std::sort_heap(heap.begin(), heap.end());
+	resultIndices.reserve(heap.size());
+	sqrDistances.reserve(heap.size());
+	for (uint32_t i = 0; i < heap.size(); ++i)
+	{
+		sqrDistances.push_back(heap[i].first);
+		resultIndices.push_back(heap[i].second);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+void Octree<PointT, ContainerT>::knnNeighbors(const PointT& query,
+                                              uint32_t k,
+                                              std::vector<uint32_t>& resultIndices,
+                                              std::vector<float>& sqrDistances,
+                                              const ApproximateParams& approx,
+                                              bool& exact,
+                                              float minDistance) const
+{
+	resultIndices.clear();
+	sqrDistances.clear();
+	exact = true;
+	if (root_ == 0 || k == 0)
+		return;
+
+	std::vector<KnnEntry> heap;
+	heap.reserve(k);
+	float maxDistance = std::numeric_limits<float>::infinity();
+	float sqrMinDistance = (minDistance < 0) ? minDistance : Distance::sqr(minDistance);
+	ApproximateState state(approx);
+	knnNeighbors<Distance>(root_, query, k, sqrMinDistance, std::numeric_limits<float>::infinity(), maxDistance, heap, &state);
+	exact = !state.relaxed && !state.exhausted;
+
+	std::sort_heap(heap.begin(), heap.end());
+	resultIndices.reserve(heap.size());
+	sqrDistances.reserve(heap.size());
+	for (uint32_t i = 0; i < heap.size(); ++i)
+	{
+		sqrDistances.push_back(heap[i].first);
+		resultIndices.push_back(heap[i].second);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance, typename QueryContainerT>
+void Octree<PointT, ContainerT>::knnNeighbors(const QueryContainerT& queries,
+                                              uint32_t k,
+                                              uint32_t* resultIndices,
+                                              float* sqrDistances,
+                                              float minDistance) const
+{
+	if (k == 0)
+		return;
+
+	// the heap is reused by all queries; therefore we only allocate once.
+	std::vector<KnnEntry> heap;
+	heap.reserve(k);
+	float sqrMinDistance = (minDistance < 0) ? minDistance : Distance::sqr(minDistance);
+
+	const uint32_t N = queries.size();
+	for (uint32_t q = 0; q < N; ++q)
+	{
+		heap.clear();
+		if (root_ != 0)
+		{
+			float maxDistance = std::numeric_limits<float>::infinity();
+			knnNeighbors<Distance>(root_, queries[q], k, sqrMinDistance, std::numeric_limits<float>::infinity(), maxDistance, heap);
+			std::sort_heap(heap.begin(), heap.end());
+		}
+
+		uint32_t* indices = resultIndices + uint64_t(q) * k;
+		for (uint32_t i = 0; i < heap.size(); ++i)
+			indices[i] = heap[i].second;
+		for (uint32_t i = heap.size(); i < k; ++i)
+			indices[i] = std::numeric_limits<uint32_t>::max();
+
+		if (sqrDistances == 0)
+			continue;
+
+		float* dists = sqrDistances + uint64_t(q) * k;
+		for (uint32_t i = 0; i < heap.size(); ++i)
+			dists[i] = heap[i].first;
+		for (uint32_t i = heap.size(); i < k; ++i)
+			dists[i] = std::numeric_limits<float>::infinity();
+	}
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+bool Octree<PointT, ContainerT>::knnNeighbors(const Octant* octant,
+                                              const PointT& query,
+                                              uint32_t k,
+                                              float sqrMinDistance,
+                                              float sqrMaxDistance,
+                                              float& maxDistance,
+                                              std::vector<KnnEntry>& heap,
+                                              ApproximateState* approx) const
+{
+	// 1. first descend to leaf and check in leafs points.
+	if (octant->isLeaf)
+	{
+		// with an exhausted budget, the search stops.
+		if (approx != 0 && !approx->visit(octant->size))
+			return true;
+
+		if (params_.reorderPoints)
+		{
+			const float qx = get<0>(query), qy = get<1>(query), qz = get<2>(query);
+			for (uint32_t i = octant->offset; i < octant->offset + octant->size; ++i)
+			{
+				float dist = Distance::norm(qx - xs_[i], qy - ys_[i], qz - zs_[i]);
+				if (dist > sqrMinDistance && dist < sqrMaxDistance)
+					insertNeighbor(heap, k, dist, permutation_[i]);
+			}
+		}
+		else
+		{
+			uint32_t idx = octant->start;
+			for (uint32_t i = 0; i < octant->size; ++i)
+			{
+				float dist = Distance::compute(query, (*data_)[idx]);
+				if (dist > sqrMinDistance && dist < sqrMaxDistance)
+					insertNeighbor(heap, k, dist, idx);
+				idx = successors_[idx];
+			}
+		}
+
+		if (heap.size() == k)
+			maxDistance = Distance::sqrt(heap.front().first);
+		return inside(query, maxDistance, octant, approx);
+	}
+
+	// determine Morton code for each point...
+	uint32_t mortonCode = 0;
+	if (get<0>(query) > octant->x)
+		mortonCode |= 1;
+	if (get<1>(query) > octant->y)
+		mortonCode |= 2;
+	if (get<2>(query) > octant->z)
+		mortonCode |= 4;
+
+	const Octant* nearestChild = child(octant, mortonCode);
+	if (nearestChild != 0)
+	{
+		if (knnNeighbors<Distance>(nearestChild, query, k, sqrMinDistance, sqrMaxDistance, maxDistance, heap, approx))
+			return true;
+	}
+
+	// 2. check adjacent octants for overlap with the ball of the current k-th neighbor.
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		if (c == mortonCode)
+			continue;
+		const Octant* childOctant = child(octant, c);
+		if (childOctant == 0)
+			continue;
+		if (!overlaps<Distance>(query, maxDistance, childOctant, approx))
+			continue;
+		if (knnNeighbors<Distance>(childOctant, query, k, sqrMinDistance, sqrMaxDistance, maxDistance, heap, approx))
+			return true; // early pruning
+	}
+
+	// all children have been checked...check if ball of k-th neighbor is inside the current octant...
+	return inside(query, maxDistance, octant, approx);
+}
+
+template <typename PointT, typename ContainerT>
+
+void Octree<PointT, ContainerT>::insertNeighbor(std::vector<KnnEntry>& heap, uint32_t k, float sqrDistance, uint32_t index)
+{
+	if (heap.size() < k)
+	{
+		heap.push_back(KnnEntry(sqrDistance, index));
+		std::push_heap(heap.begin(), heap.end());
+	}
+	else if (sqrDistance < heap.front().first)
+	{
+		// replace current k-th neighbor, which shrinks the search radius.
+		std::pop_heap(heap.begin(), heap.end());
+		heap.back() = KnnEntry(sqrDistance, index);
+		std::push_heap(heap.begin(), heap.end());
+	}
+}
+
+template <typename PointT, typename ContainerT>
+
+float Octree<PointT, ContainerT>::sqrDistance(const PointT& p, const PointT& q)
+{
+	float x = get<0>(p) - get<0>(q);
+	float y = get<1>(p) - get<1>(q);
+	float z = get<2>(p) - get<2>(q);
+
+	return x * x + y * y + z * z;
+}
+
+template <typename PointT, typename ContainerT>
+
+float Octree<PointT, ContainerT>::sqrDistance(float x, float y, float z)
+{
+	return x * x + y * y + z * z;
+}
+
+template <typename PointT, typename ContainerT>
+
+bool Octree<PointT, ContainerT>::inside(const PointT& query, float radius, const Octant* octant)
+{
+	// we exploit the symmetry to reduce the test to test
+	// whether the farthest corner is inside the search ball.
+	float x = get<0>(query) - octant->x;
+	float y = get<1>(query) - octant->y;
+	float z = get<2>(query) - octant->z;
+
+	x = std::abs(x) + radius;
+	y = std::abs(y) + radius;
+	z = std::abs(z) + radius;
+
+	if (x > octant->extent)
+		return false;
+	if (y > octant->extent)
+		return false;
+	if (z > octant->extent)
+		return false;
+
+	return true;
+}
+template <typename PointT, typename ContainerT>
+OctreePartition<PointT, ContainerT>::OctreePartition()
+    : octree_(0)
+    , depth_(0)
+{
+}
+
+template <typename PointT, typename ContainerT>
+OctreePartition<PointT, ContainerT>::OctreePartition(const OctreeT* octree, int depth)
+    : octree_(octree)
+    , depth_(depth)
+{
+	if (octree_->root_ != 0 && depth >= 0)
+		collectParts(octree_->root_, 0);
+}
+
+template <typename PointT, typename ContainerT>
+void OctreePartition<PointT, ContainerT>::collectParts(const Octant* octant, int depth)
+{
+	if (depth == depth_ || octant->isLeaf)
+	{
+		parts_.push_back(octant);
+		return;
+	}
+
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* child = octree_->child(octant, c);
+		if (child != 0)
+			collectParts(child, depth + 1);
+	}
+}
+
+template <typename PointT, typename ContainerT>
+uint32_t OctreePartition<PointT, ContainerT>::size() const
+{
+	return parts_.size();
+}
+
+template <typename PointT, typename ContainerT>
+int OctreePartition<PointT, ContainerT>::depth() const
+{
+	return depth_;
+}
+
+template <typename PointT, typename ContainerT>
+uint32_t OctreePartition<PointT, ContainerT>::pointCount(uint32_t part) const
+{
+	return parts_[part]->size;
+}
+
+template <typename PointT, typename ContainerT>
+void OctreePartition<PointT, ContainerT>::indices(uint32_t part, std::vector<uint32_t>& indices) const
+{
+	octree_->getIndices(parts_[part], indices);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+bool OctreePartition<PointT, ContainerT>::radiusNeighbors(uint32_t part, const PointT& query, float radius, std::vector<uint32_t>& resultIndices) const
+{
+	resultIndices.clear();
+	if (collectQueryStats)
+		octree_->threadStats().queries += 1;
+	if (!isLimitedTo<Distance>(part, query, radius))
+		return false;
+
+	octree_->template radiusNeighbors<Distance>(parts_[part], query, radius, Distance::sqr(radius), resultIndices);
+	return true;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+bool OctreePartition<PointT, ContainerT>::radiusNeighbors(uint32_t part,
+                                                          const PointT& query,
+                                                          float radius,
+                                                          std::vector<uint32_t>& resultIndices,
+                                                          std::vector<float>& distances) const
+{
+	resultIndices.clear();
+	distances.clear();
+	if (collectQueryStats)
+		octree_->threadStats().queries += 1;
+	if (!isLimitedTo<Distance>(part, query, radius))
+		return false;
+
+	octree_->template radiusNeighbors<Distance>(parts_[part], query, radius, Distance::sqr(radius), resultIndices, distances);
+	return true;
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+bool OctreePartition<PointT, ContainerT>::isLimitedTo(uint32_t part, const PointT& query, float radius) const
+{
+	if (part >= parts_.size())
+		return false;
+	if (OctreeT::inside(query, radius, parts_[part]))
+		return true;
+
+	return !overlapsOtherPart<Distance>(octree_->root_, 0, query, radius, Distance::sqr(radius), parts_[part]);
+}
+
+template <typename PointT, typename ContainerT>
+template <typename Distance>
+bool OctreePartition<PointT, ContainerT>::overlapsOtherPart(const Octant* octant,
+                                                            int octantDepth,
+                                                            const PointT& query,
+                                                            float radius,
+                                                            float sqrRadius,
+                                                            const Octant* part) const
+{
+	if (collectQueryStats)
+		octree_->threadStats().octantsVisited += 1;
+
+	// parts are the octants at depth_ and leafs above; all octants contain points.
+	if (octantDepth == depth_ || octant->isLeaf)
+		return octant != part;
+
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		const Octant* child = octree_->child(octant, c);
+		if (child == 0)
+			continue;
+		if (collectQueryStats)
+			octree_->threadStats().overlapTests += 1;
+		if (!OctreeT::template overlaps<Distance>(query, radius, sqrRadius, child))
+			continue;
+		if (overlapsOtherPart<Distance>(child, octantDepth + 1, query, radius, sqrRadius, part))
+			return true;
+	}
+
+	return false;
+}
+
+template <typename PointT, typename ContainerT>
+SharedOctree<PointT, ContainerT>::SharedOctree()
+    : current_(std::make_shared<OctreeT>())
+    , spare_(std::make_shared<Spare>())
+{
+}
+
+template <typename PointT, typename ContainerT>
+typename SharedOctree<PointT, ContainerT>::Snapshot SharedOctree<PointT, ContainerT>::snapshot() const
+{
+	return std::atomic_load(&current_);
+}
+
+template <typename PointT, typename ContainerT>
+void SharedOctree<PointT, ContainerT>::rebuild(const ContainerT& pts, const OctreeParams& params)
+{
+	std::lock_guard<std::mutex> lock(rebuildMutex_);
+	std::unique_ptr<OctreeT> octree(acquire());
+	octree->initialize(pts, params);
+	publish(octree.release());
+}
+
+template <typename PointT, typename ContainerT>
+void SharedOctree<PointT, ContainerT>::rebuild(const ContainerT& pts, const std::vector<uint32_t>& indexes, const OctreeParams& params)
+{
+	std::lock_guard<std::mutex> lock(rebuildMutex_);
+	std::unique_ptr<OctreeT> octree(acquire());
+	octree->initialize(pts, indexes, params);
+	publish(octree.release());
+}
+
+template <typename PointT, typename ContainerT>
+void SharedOctree<PointT, ContainerT>::Recycle::operator()(OctreeT* octree) const
+{
+	{
+		std::lock_guard<std::mutex> lock(spare->mutex);
+		if (spare->octree == 0)
+		{
+			spare->octree = octree;
+			return;
+		}
+	}
+	delete octree;
+}
+
+template <typename PointT, typename ContainerT>
+typename SharedOctree<PointT, ContainerT>::OctreeT* SharedOctree<PointT, ContainerT>::acquire()
+{
+	// the spare has no snapshots and gets none, since snapshots are only taken from current_.
+	{
+		std::lock_guard<std::mutex> lock(spare_->mutex);
+		if (spare_->octree != 0)
+		{
+			OctreeT* octree = spare_->octree;
+			spare_->octree = 0;
+			return octree;
+		}
+	}
+
+	return new OctreeT();
+}
+
+template <typename PointT, typename ContainerT>
+void SharedOctree<PointT, ContainerT>::publish(OctreeT* octree)
+{
+	Recycle recycle;
+	recycle.spare = spare_;
+	// the previous octree is handed back to the spare, when the last snapshot is released.
+	Snapshot previous = std::atomic_exchange(&current_, Snapshot(octree, recycle));
+}
+
+template <typename PointT, typename ContainerT>
+OctreeBuilder<PointT, ContainerT>::OctreeBuilder(const std::string& path, const OctreeParams& params, uint32_t maxPointsInMemory)
+    : path_(path)
+    , params_(params)
+    , maxPointsInMemory_(std::max(maxPointsInMemory, uint32_t(1)))
+    , userBounds_(false)
+    , numAdded_(0)
+    , numPoints_(0)
+    , numSpills_(1)
+    , coordinatesOffset_(0)
+    , indexesOffset_(0)
+{
+	for (uint32_t i = 0; i < 3; ++i)
+		min_[i] = max_[i] = 0.0f;
+}
+
+template <typename PointT, typename ContainerT>
+OctreeBuilder<PointT, ContainerT>::~OctreeBuilder()
+{
+	spill_.close();
+	removeSpills();
+}
+
+template <typename PointT, typename ContainerT>
+void OctreeBuilder<PointT, ContainerT>::setBounds(const float min[3], const float max[3])
+{
+	userBounds_ = true;
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		min_[i] = min[i];
+		max_[i] = max[i];
+	}
+}
+
+template <typename PointT, typename ContainerT>
+bool OctreeBuilder<PointT, ContainerT>::add(const ContainerT& pts)
+{
+	if (!spill_.is_open())
+		spill_.open(spillPath(0).c_str(), std::ios::binary | std::ios::trunc);
+
+	// points are written in blocks, which keeps only a small buffer in memory.
+	const uint32_t blockSize = 8192;
+	std::vector<Record> block;
+	block.reserve(blockSize);
+	const uint32_t N = pts.size();
+	for (uint32_t i = 0; i < N; ++i)
+	{
+		const PointT& p = pts[i];
+		Record r;
+		r.x = get<0>(p);
+		r.y = get<1>(p);
+		r.z = get<2>(p);
+		r.index = numAdded_ + i;
+		if (!std::isfinite(r.x) || !std::isfinite(r.y) || !std::isfinite(r.z))
+			continue;
+
+		if (userBounds_)
+		{
+			if (r.x < min_[0] || r.y < min_[1] || r.z < min_[2] || r.x > max_[0] || r.y > max_[1] || r.z > max_[2])
+				continue;
+		}
+		else if (numPoints_ == 0 && block.empty())
+		{
+			min_[0] = max_[0] = r.x;
+			min_[1] = max_[1] = r.y;
+			min_[2] = max_[2] = r.z;
+		}
+		else
+		{
+			min_[0] = std::min(min_[0], r.x);
+			min_[1] = std::min(min_[1], r.y);
+			min_[2] = std::min(min_[2], r.z);
+			max_[0] = std::max(max_[0], r.x);
+			max_[1] = std::max(max_[1], r.y);
+			max_[2] = std::max(max_[2], r.z);
+		}
+
+		block.push_back(r);
+		if (block.size() == blockSize)
+		{
+			spill_.write(reinterpret_cast<const char*>(&block[0]), block.size() * sizeof(Record));
+			numPoints_ += block.size();
+			block.clear();
+		}
+	}
+	if (!block.empty())
+	{
+		spill_.write(reinterpret_cast<const char*>(&block[0]), block.size() * sizeof(Record));
+		numPoints_ += block.size();
+	}
+	numAdded_ += N;
+
+	return spill_.good();
+}
+
+template <typename PointT, typename ContainerT>
+uint32_t OctreeBuilder<PointT, ContainerT>::size() const
+{
+	return numAdded_;
+}
+
+template <typename PointT, typename ContainerT>
+bool OctreeBuilder<PointT, ContainerT>::build()
+{
+	bool success = !spill_.is_open() || spill_.good();
+	spill_.close();
+
+	const uint32_t N = numPoints_;
+	FileHeader header;
+	std::memset(&header, 0, sizeof(FileHeader));
+	std::memcpy(header.magic, "UNIBNOCT", 8);
+	header.version = 2;
+	header.byteOrder = 0x01020304;
+	header.octantSize = sizeof(Octant);
+	header.bucketSize = params_.bucketSize;
+	header.minExtent = params_.minExtent;
+	header.numPoints = N;
+
+	// the number of octants is only known at the end, thus the octants are stored behind the points.
+	coordinatesOffset_ = (sizeof(FileHeader) + 63) & ~uint64_t(63);
+	indexesOffset_ = (coordinatesOffset_ + 3 * uint64_t(N) * sizeof(float) + 63) & ~uint64_t(63);
+	header.coordinatesOffset = coordinatesOffset_;
+	header.indexesOffset = indexesOffset_;
+	header.octantsOffset = (indexesOffset_ + uint64_t(N) * sizeof(uint32_t) + 63) & ~uint64_t(63);
+
+	out_.open(path_.c_str(), std::ios::binary | std::ios::trunc);
+	success = success && out_.is_open() && RecordOctree::littleEndian();
+
+	if (success && N > 0)
+	{
+		// same root as Octree::createRoot.
+		float ctr[3] = { min_[0], min_[1], min_[2] };
+		float maxextent = 0.5f * (max_[0] - min_[0]);
+		ctr[0] += maxextent;
+		for (uint32_t i = 1; i < 3; ++i)
+		{
+			float extent = 0.5f * (max_[i] - min_[i]);
+			ctr[i] += extent;
+			if (extent > maxextent)
+				maxextent = extent;
+		}
+
+		octants_.resize(1);
+		success = buildOctant(0, N, 0, ctr[0], ctr[1], ctr[2], maxextent, 0);
+	}
+
+	header.numOctants = octants_.size();
+	header.fileSize = header.octantsOffset + uint64_t(header.numOctants) * sizeof(Octant);
+	if (success)
+	{
+		if (header.numOctants > 0)
+		{
+			out_.seekp(header.octantsOffset);
+			out_.write(reinterpret_cast<const char*>(&octants_[0]), uint64_t(header.numOctants) * sizeof(Octant));
+		}
+		else
+		{
+			// the empty sections still have to be inside the file.
+			const char padding[64] = { 0 };
+			out_.seekp(sizeof(FileHeader));
+			out_.write(padding, header.fileSize - sizeof(FileHeader));
+		}
+		out_.seekp(0);
+		out_.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+		success = out_.good();
+	}
+	if (out_.is_open())
+		out_.close();
+	success = success && out_.good();
+	out_.clear();
+
+	removeSpills();
+	std::vector<Octant>().swap(octants_);
+	numAdded_ = 0;
+	numPoints_ = 0;
+
+	return success;
+}
+
+template <typename PointT, typename ContainerT>
+bool OctreeBuilder<PointT, ContainerT>::buildOctant(uint32_t file,
+                                                    uint32_t size,
+                                                    uint32_t octantIdx,
+                                                    float x,
+                                                    float y,
+                                                    float z,
+                                                    float extent,
+                                                    uint32_t offset)
+{
+	const uint32_t blockSize = 8192;
+	std::ifstream in(spillPath(file).c_str(), std::ios::binary);
+	if (!in.is_open())
+		return false;
+
+	if (size <= maxPointsInMemory_)
+	{
+		std::vector<Record> records(size);
+		in.read(reinterpret_cast<char*>(&records[0]), uint64_t(size) * sizeof(Record));
+		const bool success = bool(in);
+		in.close();
+		std::remove(spillPath(file).c_str());
+
+		return success && buildSubtree(records, octantIdx, x, y, z, extent, offset);
+	}
+
+	Octant* octant = &octants_[octantIdx];
+	octant->x = x;
+	octant->y = y;
+	octant->z = z;
+	octant->extent = extent;
+	octant->size = size;
+	octant->offset = offset;
+
+	std::vector<Record> block(blockSize);
+	if (size <= params_.bucketSize || extent <= 2 * params_.minExtent)
+	{
+		// a leaf with too many points for the memory is copied blockwise.
+		std::vector<float> coordinates(3 * blockSize);
+		std::vector<uint32_t> indexes(blockSize);
+		for (uint32_t i = 0; i < size; i += blockSize)
+		{
+			const uint32_t n = std::min(blockSize, size - i);
+			if (!in.read(reinterpret_cast<char*>(&block[0]), n * sizeof(Record)))
+				return false;
+			for (uint32_t k = 0; k < n; ++k)
+			{
+				coordinates[k] = block[k].x;
+				coordinates[blockSize + k] = block[k].y;
+				coordinates[2 * blockSize + k] = block[k].z;
+				indexes[k] = block[k].index;
+			}
+			if (i == 0)
+				octant->start = block[0].index;
+			octant->end = block[n - 1].index;
+			if (!writePoints(&coordinates[0], &coordinates[blockSize], &coordinates[2 * blockSize], &indexes[0], n, offset + i))
+				return false;
+		}
+		in.close();
+		std::remove(spillPath(file).c_str());
+
+		return true;
+	}
+
+	// distribute the points to the children in the order of the file, which keeps the order of the points inside of
+	// each child as in Octree::createOctant.
+	std::ofstream childFiles[8];
+	std::vector<Record> childBlocks[8];
+	uint32_t childSizes[8] = { 0 };
+	const uint32_t firstSpill = numSpills_;
+	numSpills_ += 8;
+	for (uint32_t c = 0; c < 8; ++c)
+		childFiles[c].open(spillPath(firstSpill + c).c_str(), std::ios::binary | std::ios::trunc);
+
+	bool success = true;
+	for (uint32_t i = 0; i < size && success; i += blockSize)
+	{
+		const uint32_t n = std::min(blockSize, size - i);
+		success = bool(in.read(reinterpret_cast<char*>(&block[0]), n * sizeof(Record)));
+		for (uint32_t k = 0; k < n && success; ++k)
+		{
+			const Record& r = block[k];
+			uint32_t mortonCode = 0;
+			if (r.x > x)
+				mortonCode |= 1;
+			if (r.y > y)
+				mortonCode |= 2;
+			if (r.z > z)
+				mortonCode |= 4;
+
+			std::vector<Record>& childBlock = childBlocks[mortonCode];
+			childBlock.push_back(r);
+			childSizes[mortonCode] += 1;
+			if (childBlock.size() == blockSize)
+			{
+				childFiles[mortonCode].write(reinterpret_cast<const char*>(&childBlock[0]), childBlock.size() * sizeof(Record));
+				childBlock.clear();
+			}
+		}
+	}
+	in.close();
+	std::remove(spillPath(file).c_str());
+
+	uint8_t childMask = 0;
+	uint32_t numChildren = 0;
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		if (!childBlocks[c].empty())
+			childFiles[c].write(reinterpret_cast<const char*>(&childBlocks[c][0]), childBlocks[c].size() * sizeof(Record));
+		success = success && childFiles[c].good();
+		childFiles[c].close();
+		if (childSizes[c] == 0)
+			continue;
+		childMask |= (1 << c);
+		numChildren += 1;
+	}
+	if (!success)
+		return false;
+
+	// allocate all children consecutively like Octree::createOctant before building them depth-first.
+	const uint32_t firstChild = octants_.size();
+	octant->isLeaf = false;
+	octant->firstChild = firstChild;
+	octant->childMask = childMask;
+	octants_.resize(firstChild + numChildren);
+
+	static const float factor[] = { -0.5f, 0.5f };
+	const float childExtent = 0.5f * extent;
+	uint32_t childIdx = firstChild;
+	uint32_t childOffset = offset;
+	for (uint32_t c = 0; c < 8; ++c)
+	{
+		if (childSizes[c] == 0)
+			continue;
+
+		float childX = x + factor[(c & 1) > 0] * extent;
+		float childY = y + factor[(c & 2) > 0] * extent;
+		float childZ = z + factor[(c & 4) > 0] * extent;
+		if (!buildOctant(firstSpill + c, childSizes[c], childIdx, childX, childY, childZ, childExtent, childOffset))
+			return false;
+		childIdx += 1;
+		childOffset += childSizes[c];
+	}
+
+	octants_[octantIdx].start = octants_[firstChild].start;
+	octants_[octantIdx].end = octants_[firstChild + numChildren - 1].end;
+
+	return true;
+}
+
+template <typename PointT, typename ContainerT>
+bool OctreeBuilder<PointT, ContainerT>::buildSubtree(std::vector<Record>& records,
+                                                     uint32_t octantIdx,
+                                                     float x,
+                                                     float y,
+                                                     float z,
+                                                     float extent,
+                                                     uint32_t offset)
+{
+	const uint32_t N = records.size();
+	RecordOctree tree;
+	tree.params_ = params_;
+	tree.params_.copyPoints = false;
+	tree.data_ = &records;
+	tree.successors_.resize(N);
+	for (uint32_t i = 0; i < N; ++i)
+		tree.successors_[i] = i + 1;
+
+	tree.octants_.resize(1);
+#pragma omp parallel if (params_.parallelBuild && N > params_.parallelThreshold)
+#pragma omp single
+	tree.createOctant(tree.octants_, 0, x, y, z, extent, 0, N - 1, N);
+
+	std::vector<float> coordinates;
+	std::vector<uint32_t> indexes;
+	tree.reorderPoints(tree.octants_, coordinates, indexes);
+	for (uint32_t k = 0; k < N; ++k)
+		indexes[k] = records[indexes[k]].index;
+
+	// the subtree refers to the records, which are mapped to the indexes of the added points.
+	const uint32_t first = octants_.size();
+	RecordOctree::appendSubtree(octants_, octantIdx, tree.octants_);
+	octants_[octantIdx].start = records[octants_[octantIdx].start].index;
+	octants_[octantIdx].end = records[octants_[octantIdx].end].index;
+	octants_[octantIdx].offset += offset;
+	for (uint32_t i = first; i < octants_.size(); ++i)
+	{
+		octants_[i].start = records[octants_[i].start].index;
+		octants_[i].end = records[octants_[i].end].index;
+		octants_[i].offset += offset;
+	}
+
+	return writePoints(&coordinates[0], &coordinates[N], &coordinates[2 * N], &indexes[0], N, offset);
+}
+
+template <typename PointT, typename ContainerT>
+bool OctreeBuilder<PointT, ContainerT>::writePoints(const float* xs,
+                                                    const float* ys,
+                                                    const float* zs,
+                                                    const uint32_t* indexes,
+                                                    uint32_t n,
+                                                    uint32_t offset)
+{
+	const float* coordinates[3] = { xs, ys, zs };
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		out_.seekp(coordinatesOffset_ + (uint64_t(i) * numPoints_ + offset) * sizeof(float));
+		out_.write(reinterpret_cast<const char*>(coordinates[i]), uint64_t(n) * sizeof(float));
+	}
+	out_.seekp(indexesOffset_ + uint64_t(offset) * sizeof(uint32_t));
+	out_.write(reinterpret_cast<const char*>(indexes), uint64_t(n) * sizeof(uint32_t));
+
+	return out_.good();
+}
+
+template <typename PointT, typename ContainerT>
+void OctreeBuilder<PointT, ContainerT>::removeSpills()
+{
+	for (uint32_t i = 0; i < numSpills_; ++i)
+		std::remove(spillPath(i).c_str());
+	numSpills_ = 1;
+}
+
+template <typename PointT, typename ContainerT>
+std::string OctreeBuilder<PointT, ContainerT>::spillPath(uint32_t file) const
+{
+	char suffix[32];
+	std::snprintf(suffix, sizeof(suffix), ".spill%u", file);
+	return path_ + suffix;
+}
+
+// implementation details of OctreeParams::autoTune, which are not part of the interface.
+namespace detail
+{
+/** @return weighted traversal steps of the radius queries on the octree built with params, which are counted with
+ * UNIBN_OCTREE_STATS and otherwise determined by Octree::radiusQueryCost; both are deterministic and give the same
+ * value. Visiting an octant costs about as much as four distance computations and an overlap test as two.
+ **/
+template <typename PointT, typename ContainerT>
+double radiusQueryCost(Octree<PointT, ContainerT>& octree,
+                       const OctreeParams& params,
+                       const std::vector<PointT>& queries,
+                       float radius)
+{
+	QueryStats stats;
+	if (collectQueryStats)
+	{
+		octree.resetQueryStats();
+		std::vector<uint32_t> resultIndices;
+		for (uint32_t q = 0; q < queries.size(); ++q)
+			octree.radiusNeighbors(queries[q], radius, resultIndices);
+		stats = octree.queryStats();
+	}
+	else
+	{
+		stats = octree.radiusQueryCost(queries, radius);
+	}
+
+	// the vectorized scans of the reordered points test several points at once.
+	const double pointCost = params.reorderPoints ? 0.25 : 1.0;
+	return 4.0 * stats.octantsVisited + 2.0 * stats.overlapTests + pointCost * stats.pointsTested;
+}
+
+/** @return smallest time in seconds of three runs of the radius queries on the octree. **/
+template <typename PointT, typename ContainerT>
+double radiusQueryTime(const Octree<PointT, ContainerT>& octree, const std::vector<PointT>& queries, float radius)
+{
+	std::vector<uint32_t> resultIndices;
+	double minTime = std::numeric_limits<double>::infinity();
+	for (uint32_t run = 0; run < 3; ++run)
+	{
+		const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		for (uint32_t q = 0; q < queries.size(); ++q)
+			octree.radiusNeighbors(queries[q], radius, resultIndices);
+		minTime = std::min(minTime, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+	}
+
+	return minTime;
+}
+
+/** @return candidate with the lowest radiusQueryCost, where the first one wins ties. With timeTies, the candidates
+ * within 5% of the lowest cost are rebuilt and the fastest of them wins.
+ **/
+template <typename PointT, typename ContainerT>
+OctreeParams selectParams(const ContainerT& points,
+                          const std::vector<PointT>& queries,
+                          float radius,
+                          const std::vector<OctreeParams>& candidates,
+                          bool timeTies)
+{
+	std::vector<double> costs(candidates.size());
+	uint32_t best = 0;
+	for (uint32_t i = 0; i < candidates.size(); ++i)
+	{
+		Octree<PointT, ContainerT> octree;
+		octree.initialize(points, candidates[i]);
+		costs[i] = radiusQueryCost(octree, candidates[i], queries, radius);
+		if (costs[i] < costs[best])
+			best = i;
+	}
+
+	if (timeTies)
+	{
+		const double maxCost = 1.05 * costs[best];
+		double bestTime = std::numeric_limits<double>::infinity();
+		for (uint32_t i = 0; i < candidates.size(); ++i)
+		{
+			if (costs[i] > maxCost)
+				continue;
+			Octree<PointT, ContainerT> octree;
+			octree.initialize(points, candidates[i]);
+			const double time = radiusQueryTime(octree, queries, radius);
+			if (time < bestTime)
+			{
+				bestTime = time;
+				best = i;
+			}
+		}
+	}
+
+	return candidates[best];
+}
+} // namespace detail
+
+template <typename ContainerT>
+OctreeParams OctreeParams::autoTune(const ContainerT& points,
+                                    const ContainerT& sampleQueries,
+                                    float radius,
+                                    const OctreeParams& base,
+                                    bool timeTies)
+{
+	typedef typename ContainerT::value_type PointT;
+
+	OctreeParams best = base;
+	if (points.size() == 0 || sampleQueries.size() == 0)
+		return best;
+	best.copyPoints = false;
+
+	const uint32_t step = (sampleQueries.size() + 1023) / 1024;
+	std::vector<PointT> queries;
+	for (uint32_t i = 0; i < sampleQueries.size(); i += step)
+		queries.push_back(sampleQueries[i]);
+
+	static const uint32_t bucketSizes[] = { 4, 8, 16, 32, 64, 128 };
+	static const float extentFactors[] = { 0.125f, 0.25f, 0.5f };
+
+	std::vector<OctreeParams> candidates;
+	OctreeParams params = best;
+	params.minExtent = 0.0f;
+	for (uint32_t i = 0; i < sizeof(bucketSizes) / sizeof(bucketSizes[0]); ++i)
+	{
+		params.bucketSize = bucketSizes[i];
+		candidates.push_back(params);
+	}
+	best = detail::selectParams(points, queries, radius, candidates, timeTies);
+
+	candidates.assign(1, best);
+	params = best;
+	for (uint32_t i = 0; i < sizeof(extentFactors) / sizeof(extentFactors[0]); ++i)
+	{
+		params.minExtent = extentFactors[i] * radius;
+		candidates.push_back(params);
+	}
+	best = detail::selectParams(points, queries, radius, candidates, timeTies);
+	best.copyPoints = base.copyPoints;
+
+	return best;
 }
 } // namespace unibn
 
@@ -0,0 +1,812 @@
+#ifndef UNIBN_OCTREE_CUDA_H_
+#define UNIBN_OCTREE_CUDA_H_
+
+// Copyright (c) 2015 Jens Behley, University of Bonn
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to
+// deal in the Software without restriction, including without limitation the
+// rights  to use, copy, modify, merge, publish, distribute, sublicense, and/or
+// sell copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+// FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+// IN THE SOFTWARE.
+
+// Optional CUDA backend, which needs to be compiled with nvcc, e.g., by configuring with cmake -DOCTREE_CUDA=ON.
+
+#include "Octree.hpp"
+
+#include <climits>
+
+#include <cub/cub.cuh>
+#include <cuda_runtime.h>
+
+namespace unibn
+{
+namespace cuda
+{
+/** \brief octant of the flat device octree; its points are stored at offset, ..., offset + size - 1 of the sorted
+ * points.
+ **/
+struct DeviceOctant
+{
+	float x, y, z; // center
+	float extent; // half of side-length
+	uint32_t offset; // position of the first point in the sorted points.
+	uint32_t size; // number of points
+	uint32_t firstChild; // index of first child; children are stored consecutively.
+	uint32_t childMask; // i-th bit is set, if i-th child exists; leafs have no children.
+};
+
+/** \brief device memory for size elements of type T, which is released by the destructor. **/
+template <typename T>
+class DeviceBuffer
+{
+public:
+	DeviceBuffer()
+	    : data_(0)
+	    , size_(0)
+	{
+	}
+
+	~DeviceBuffer()
+	{
+		clear();
+	}
+
+	/** \brief allocate memory for size elements, which discards the previous contents.
+   * @return false, if the allocation failed.
+   **/
+	bool resize(uint64_t size)
+	{
+		if (size == size_)
+			return true;
+
+		clear();
+		if (size == 0)
+			return true;
+		if (cudaMalloc(reinterpret_cast<void**>(&data_), size * sizeof(T)) != cudaSuccess)
+		{
+			data_ = 0;
+			return false;
+		}
+		size_ = size;
+
+		return true;
+	}
+
+	void clear()
+	{
+		if (data_ != 0)
+			cudaFree(data_);
+		data_ = 0;
+		size_ = 0;
+	}
+
+	T* data()
+	{
+		return data_;
+	}
+
+	const T* data() const
+	{
+		return data_;
+	}
+
+	uint64_t size() const
+	{
+		return size_;
+	}
+
+protected:
+	// not copyable, not assignable ...
+	DeviceBuffer(const DeviceBuffer&);
+	DeviceBuffer& operator=(const DeviceBuffer&);
+
+	T* data_;
+	uint64_t size_;
+};
+
+namespace kernels
+{
+/** \brief number of levels of the Morton keys, i.e., 3 bits per level fit into 63 bits. **/
+static const uint32_t mortonLevels = 21;
+
+/** \brief maximal number of octants on the traversal stacks, i.e., 7 siblings per level and the current octant. **/
+static const uint32_t stackSize = 8 * (mortonLevels + 1);
+
+/** \brief maximal number of neighbors of knnNeighbors. **/
+static const uint32_t maxK = 32;
+
+/** @return integer with the same order as the float f, which allows to use the integer atomicMin and atomicMax. **/
+__device__ inline int32_t orderedInt(float f)
+{
+	const int32_t i = __float_as_int(f);
+	return (i >= 0) ? i : i ^ 0x7FFFFFFF;
+}
+
+__global__ void bounds(const float* points, uint32_t N, uint32_t stride, int32_t* result)
+{
+	float minimum[3] = { INFINITY, INFINITY, INFINITY };
+	float maximum[3] = { -INFINITY, -INFINITY, -INFINITY };
+	for (uint32_t i = blockIdx.x * blockDim.x + threadIdx.x; i < N; i += gridDim.x * blockDim.x)
+	{
+		const float* p = points + uint64_t(i) * stride;
+		for (uint32_t a = 0; a < 3; ++a)
+		{
+			minimum[a] = fminf(minimum[a], p[a]);
+			maximum[a] = fmaxf(maximum[a], p[a]);
+		}
+	}
+
+	if (minimum[0] > maximum[0])
+		return; // no points.
+
+	for (uint32_t a = 0; a < 3; ++a)
+	{
+		atomicMin(&result[a], orderedInt(minimum[a]));
+		atomicMax(&result[3 + a], orderedInt(maximum[a]));
+	}
+}
+
+/** \brief Morton keys with the child codes of all levels below the root, which are determined exactly like in
+ * Octree::createOctant, i.e., by comparison with the octant centers x +/- 0.5 * extent.
+ **/
+__global__ void mortonKeys(const float* points,
+                           uint32_t N,
+                           uint32_t stride,
+                           float x,
+                           float y,
+                           float z,
+                           float extent,
+                           uint64_t* keys,
+                           uint32_t* indexes)
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i >= N)
+		return;
+
+	const float* p = points + uint64_t(i) * stride;
+	float center[3] = { x, y, z };
+	uint64_t key = 0;
+	for (uint32_t level = 0; level < mortonLevels; ++level)
+	{
+		// explicit rounding, since the centers must not be contracted to fused multiply-adds.
+		const float childExtent = __fmul_rn(0.5f, extent);
+		uint32_t code = 0;
+		for (uint32_t a = 0; a < 3; ++a)
+		{
+			const bool upper = (p[a] > center[a]);
+			code |= uint32_t(upper) << a;
+			center[a] = __fadd_rn(center[a], upper ? childExtent : -childExtent);
+		}
+		key = (key << 3) | code;
+		extent = childExtent;
+	}
+
+	keys[i] = key;
+	indexes[i] = i;
+}
+
+/** \brief copy the points in sorted order into the x, y and z arrays. **/
+__global__ void gatherPoints(const float* points,
+                             uint32_t N,
+                             uint32_t stride,
+                             const uint32_t* permutation,
+                             float* xs,
+                             float* ys,
+                             float* zs)
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i >= N)
+		return;
+
+	const float* p = points + uint64_t(permutation[i]) * stride;
+	xs[i] = p[0];
+	ys[i] = p[1];
+	zs[i] = p[2];
+}
+
+/** \brief split the sorted keys keys[ranges[2 * i]], ..., keys[ranges[2 * i + 1] - 1] of the i-th octant by the child
+ * codes at the given shift, i.e., the c-th child covers childFirst[9 * i + c], ..., childFirst[9 * i + c + 1] - 1.
+ **/
+__global__ void childRanges(const uint64_t* keys, const uint32_t* ranges, uint32_t count, uint32_t shift, uint32_t* childFirst)
+{
+	const uint32_t i = blockIdx.x * blockDim.x + threadIdx.x;
+	if (i >= count)
+		return;
+
+	const uint32_t last = ranges[2 * i + 1];
+	uint32_t* first = childFirst + 9 * i;
+	first[0] = ranges[2 * i];
+	for (uint32_t c = 1; c < 8; ++c)
+	{
+		uint32_t lower = first[c - 1], upper = last;
+		while (lower < upper)
+		{
+			const uint32_t mid = lower + (upper - lower) / 2;
+			if (((keys[mid] >> shift) & 7) < c)
+				lower = mid + 1;
+			else
+				upper = mid;
+		}
+		first[c] = lower;
+	}
+	first[8] = last;
+}
+
+/** @return squared distance of the query to the nearest point of the octant. **/
+__device__ inline float minSqrDistance(const DeviceOctant& octant, float qx, float qy, float qz)
+{
+	const float dx = fmaxf(fabsf(qx - octant.x) - octant.extent, 0.0f);
+	const float dy = fmaxf(fabsf(qy - octant.y) - octant.extent, 0.0f);
+	const float dz = fmaxf(fabsf(qz - octant.z) - octant.extent, 0.0f);
+
+	return dx * dx + dy * dy + dz * dz;
+}
+
+/** @return squared distance of the query to the farthest corner of the octant. **/
+__device__ inline float maxSqrDistance(const DeviceOctant& octant, float qx, float qy, float qz)
+{
+	const float dx = fabsf(qx - octant.x) + octant.extent;
+	const float dy = fabsf(qy - octant.y) + octant.extent;
+	const float dz = fabsf(qz - octant.z) + octant.extent;
+
+	return dx * dx + dy * dy + dz * dz;
+}
+
+/** \brief radius neighbors of each query, which are only counted into offsets without fill and otherwise written to
+ * indices (and sqrDistances, if not null) starting at offsets[q].
+ **/
+template <bool fill>
+__global__ void radiusNeighbors(const DeviceOctant* octants,
+                                const float* xs,
+                                const float* ys,
+                                const float* zs,
+                                const uint32_t* permutation,
+                                const float* queries,
+                                uint32_t M,
+                                uint32_t stride,
+                                float sqrRadius,
+                                uint64_t* offsets,
+                                uint32_t* indices,
+                                float* sqrDistances)
+{
+	const uint32_t q = blockIdx.x * blockDim.x + threadIdx.x;
+	if (q >= M)
+		return;
+
+	const float qx = queries[uint64_t(q) * stride], qy = queries[uint64_t(q) * stride + 1],
+	            qz = queries[uint64_t(q) * stride + 2];
+	uint64_t position = fill ? offsets[q] : 0;
+
+	uint32_t stack[stackSize];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const DeviceOctant octant = octants[stack[--top]];
+		if (minSqrDistance(octant, qx, qy, qz) > sqrRadius)
+			continue;
+
+		// if search ball S(q,r) contains octant, all points are neighbors.
+		const bool contained = (maxSqrDistance(octant, qx, qy, qz) < sqrRadius);
+		if (contained && !fill)
+		{
+			position += octant.size;
+			continue;
+		}
+
+		if (contained || octant.childMask == 0)
+		{
+			for (uint32_t k = octant.offset; k < octant.offset + octant.size; ++k)
+			{
+				const float dx = qx - xs[k], dy = qy - ys[k], dz = qz - zs[k];
+				const float dist = dx * dx + dy * dy + dz * dz;
+				if (!contained && !(dist < sqrRadius))
+					continue;
+
+				if (fill)
+				{
+					indices[position] = permutation[k];
+					if (sqrDistances != 0)
+						sqrDistances[position] = dist;
+				}
+				position += 1;
+			}
+			continue;
+		}
+
+		uint32_t child = octant.firstChild;
+		for (uint32_t c = 0; c < 8; ++c)
+		{
+			if ((octant.childMask & (1 << c)) != 0)
+				stack[top++] = child++;
+		}
+	}
+
+	if (!fill)
+		offsets[q] = position;
+}
+
+/** \brief k nearest neighbors of each query sorted by increasing distance, where unused entries are filled with
+ * UINT_MAX and infinity.
+ **/
+__global__ void knnNeighbors(const DeviceOctant* octants,
+                             const float* xs,
+                             const float* ys,
+                             const float* zs,
+                             const uint32_t* permutation,
+                             const float* queries,
+                             uint32_t M,
+                             uint32_t stride,
+                             uint32_t k,
+                             uint32_t* indices,
+                             float* sqrDistances)
+{
+	const uint32_t q = blockIdx.x * blockDim.x + threadIdx.x;
+	if (q >= M)
+		return;
+
+	const float qx = queries[uint64_t(q) * stride], qy = queries[uint64_t(q) * stride + 1],
+	            qz = queries[uint64_t(q) * stride + 2];
+
+	// the neighbors found so far sorted by increasing distance.
+	uint32_t neighbors[maxK];
+	float distances[maxK];
+	uint32_t count = 0;
+	float maxDistance = INFINITY;
+
+	uint32_t stack[stackSize];
+	uint32_t top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		const DeviceOctant octant = octants[stack[--top]];
+		if (minSqrDistance(octant, qx, qy, qz) > maxDistance)
+			continue;
+
+		if (octant.childMask == 0)
+		{
+			for (uint32_t j = octant.offset; j < octant.offset + octant.size; ++j)
+			{
+				const float dx = qx - xs[j], dy = qy - ys[j], dz = qz - zs[j];
+				const float dist = dx * dx + dy * dy + dz * dz;
+				if (count == k && !(dist < maxDistance))
+					continue;
+
+				uint32_t pos = (count < k) ? count++ : k - 1;
+				for (; pos > 0 && distances[pos - 1] > dist; --pos)
+				{
+					distances[pos] = distances[pos - 1];
+					neighbors[pos] = neighbors[pos - 1];
+				}
+				distances[pos] = dist;
+				neighbors[pos] = permutation[j];
+				if (count == k)
+					maxDistance = distances[k - 1];
+			}
+			continue;
+		}
+
+		// push the children farthest first such that the nearest child is visited next.
+		uint32_t children[8];
+		float childDistances[8];
+		uint32_t numChildren = 0;
+		uint32_t child = octant.firstChild;
+		for (uint32_t c = 0; c < 8; ++c)
+		{
+			if ((octant.childMask & (1 << c)) == 0)
+				continue;
+
+			const float dist = minSqrDistance(octants[child], qx, qy, qz);
+			uint32_t pos = numChildren++;
+			for (; pos > 0 && childDistances[pos - 1] < dist; --pos)
+			{
+				childDistances[pos] = childDistances[pos - 1];
+				children[pos] = children[pos - 1];
+			}
+			childDistances[pos] = dist;
+			children[pos] = child++;
+		}
+		for (uint32_t c = 0; c < numChildren; ++c)
+		{
+			if (childDistances[c] <= maxDistance)
+				stack[top++] = children[c];
+		}
+	}
+
+	for (uint32_t i = 0; i < k; ++i)
+	{
+		indices[uint64_t(q) * k + i] = (i < count) ? neighbors[i] : UINT_MAX;
+		if (sqrDistances != 0)
+			sqrDistances[uint64_t(q) * k + i] = (i < count) ? distances[i] : INFINITY;
+	}
+}
+} // namespace kernels
+
+/** \brief Octree on the GPU built from points in device memory.
+ *
+ * The construction determines the Morton keys of all points exactly like OctreeParams::mortonBuild, sorts them with
+ * a device radix sort and derives the octants level by level from the key ranges. Thus, the points never leave the
+ * device and only the octants are copied to the host. The octants are the same as the ones of Octree with the same
+ * OctreeParams, but in breadth-first order and with the points of each octant stored consecutively in Morton order.
+ * Since the keys cover 21 levels, octants at depth 21 are not split any further.
+ *
+ * The queries mirror the batched queries of Octree with the Euclidean distance: radius queries report compressed
+ * sparse row results and kNN queries fixed-size rows, where all arrays are in device memory. The points and queries
+ * are given by stride floats per point, where the first three are x, y and z.
+ */
+class CudaOctree
+{
+public:
+	CudaOctree()
+	    : size_(0)
+	{
+	}
+
+	/** \brief build the octree for the N points in device memory.
+   * @return false, if a CUDA call failed; the octree is then empty.
+   **/
+	bool initialize(const float* points, uint32_t N, const OctreeParams& params = OctreeParams(), uint32_t stride = 3);
+
+	void clear();
+
+	/** @return number of points. **/
+	uint32_t size() const
+	{
+		return size_;
+	}
+
+	/** @return octants in breadth-first order, which are also available in device memory. **/
+	const std::vector<DeviceOctant>& octants() const
+	{
+		return octants_;
+	}
+
+	/** \brief device pointers of the points sorted by their Morton keys and their indexes. **/
+	const float* xs() const
+	{
+		return coordinates_.data();
+	}
+	const float* ys() const
+	{
+		return coordinates_.data() + size_;
+	}
+	const float* zs() const
+	{
+		return coordinates_.data() + 2 * size_;
+	}
+	const uint32_t* permutation() const
+	{
+		return permutation_.data();
+	}
+
+	/** \brief radius neighbor queries for the M queries in device memory.
+   *
+   * The indices of the i-th query are resultIndices[offsets[i]], ..., resultIndices[offsets[i + 1] - 1] like in
+   * Octree::radiusNeighborsBatch. The buffers are resized as needed; sqrDistances may be null.
+   * @return false, if a CUDA call failed.
+   **/
+	bool radiusNeighbors(const float* queries,
+	                     uint32_t M,
+	                     float radius,
+	                     DeviceBuffer<uint64_t>& offsets,
+	                     DeviceBuffer<uint32_t>& resultIndices,
+	                     DeviceBuffer<float>* sqrDistances = 0,
+	                     uint32_t stride = 3) const;
+
+	/** \brief k nearest neighbor queries for the M queries in device memory with k <= 32.
+   *
+   * The results of the i-th query are written to resultIndices[i * k], ..., resultIndices[i * k + k - 1] and
+   * accordingly to sqrDistances like in Octree::knnNeighbors, which must both provide M * k elements in device memory.
+   * Unused entries are filled with std::numeric_limits<uint32_t>::max() and infinity. sqrDistances may be null.
+   * @return false, if k > 32 or a CUDA call failed.
+   **/
+	bool knnNeighbors(const float* queries,
+	                  uint32_t M,
+	                  uint32_t k,
+	                  uint32_t* resultIndices,
+	                  float* sqrDistances,
+	                  uint32_t stride = 3) const;
+
+protected:
+	// not copyable, not assignable ...
+	CudaOctree(const CudaOctree&);
+	CudaOctree& operator=(const CudaOctree&);
+
+	static uint32_t numBlocks(uint64_t size)
+	{
+		return (size + blockSize - 1) / blockSize;
+	}
+
+	/** @return float with the order given by kernels::orderedInt. **/
+	static float orderedFloat(int32_t i)
+	{
+		i = (i >= 0) ? i : i ^ 0x7FFFFFFF;
+		float f;
+		std::memcpy(&f, &i, sizeof(float));
+		return f;
+	}
+
+	/** \brief derive the octants from the sorted Morton keys. **/
+	bool createOctants(float x, float y, float z, float extent);
+
+	static const uint32_t blockSize = 256;
+
+	OctreeParams params_;
+	uint32_t size_;
+	std::vector<DeviceOctant> octants_;
+
+	DeviceBuffer<DeviceOctant> deviceOctants_;
+	DeviceBuffer<uint64_t> keys_;
+	DeviceBuffer<float> coordinates_; // x, y and z arrays of the sorted points.
+	DeviceBuffer<uint32_t> permutation_;
+};
+
+inline bool CudaOctree::initialize(const float* points, uint32_t N, const OctreeParams& params, uint32_t stride)
+{
+	clear();
+	params_ = params;
+	if (N == 0)
+		return true;
+
+	// determine axis-aligned bounding box.
+	DeviceBuffer<int32_t> bounds;
+	int32_t result[6] = { INT_MAX, INT_MAX, INT_MAX, INT_MIN, INT_MIN, INT_MIN };
+	if (!bounds.resize(6) || cudaMemcpy(bounds.data(), result, sizeof(result), cudaMemcpyHostToDevice) != cudaSuccess)
+		return false;
+	kernels::bounds<<<std::min(numBlocks(N), 1024u), blockSize>>>(points, N, stride, bounds.data());
+	if (cudaGetLastError() != cudaSuccess)
+		return false;
+	if (cudaMemcpy(result, bounds.data(), sizeof(result), cudaMemcpyDeviceToHost) != cudaSuccess)
+		return false;
+
+	// the root octant exactly like Octree::createRoot.
+	float min[3], max[3];
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		min[i] = orderedFloat(result[i]);
+		max[i] = orderedFloat(result[3 + i]);
+	}
+	float ctr[3] = { min[0], min[1], min[2] };
+	float maxextent = 0.5f * (max[0] - min[0]);
+	ctr[0] += maxextent;
+	for (uint32_t i = 1; i < 3; ++i)
+	{
+		float extent = 0.5f * (max[i] - min[i]);
+		ctr[i] += extent;
+		if (extent > maxextent)
+			maxextent = extent;
+	}
+
+	// sort the points by their Morton keys.
+	DeviceBuffer<uint64_t> keys;
+	DeviceBuffer<uint32_t> indexes;
+	if (!keys.resize(N) || !indexes.resize(N) || !keys_.resize(N) || !permutation_.resize(N))
+		return false;
+	kernels::mortonKeys<<<numBlocks(N), blockSize>>>(points, N, stride, ctr[0], ctr[1], ctr[2], maxextent, keys.data(), indexes.data());
+	if (cudaGetLastError() != cudaSuccess)
+		return false;
+
+	size_t tempBytes = 0;
+	cub::DeviceRadixSort::SortPairs(
+	    0, tempBytes, keys.data(), keys_.data(), indexes.data(), permutation_.data(), N, 0, 3 * kernels::mortonLevels);
+	DeviceBuffer<char> temp;
+	if (!temp.resize(tempBytes))
+		return false;
+	if (cub::DeviceRadixSort::SortPairs(temp.data(),
+	                                    tempBytes,
+	                                    keys.data(),
+	                                    keys_.data(),
+	                                    indexes.data(),
+	                                    permutation_.data(),
+	                                    N,
+	                                    0,
+	                                    3 * kernels::mortonLevels) != cudaSuccess)
+		return false;
+
+	if (!coordinates_.resize(3 * uint64_t(N)))
+		return false;
+	size_ = N;
+	kernels::gatherPoints<<<numBlocks(N), blockSize>>>(points, N, stride, permutation_.data(), coordinates_.data(),
+	                                                   coordinates_.data() + N, coordinates_.data() + 2 * N);
+	if (cudaGetLastError() != cudaSuccess || !createOctants(ctr[0], ctr[1], ctr[2], maxextent))
+	{
+		clear();
+		return false;
+	}
+
+	return true;
+}
+
+inline bool CudaOctree::createOctants(float x, float y, float z, float extent)
+{
+	DeviceOctant root;
+	root.x = x;
+	root.y = y;
+	root.z = z;
+	root.extent = extent;
+	root.offset = 0;
+	root.size = size_;
+	root.firstChild = 0;
+	root.childMask = 0;
+	octants_.assign(1, root);
+
+	// all octants of a level are split at once, where only the ranges of the octants are copied between host and
+	// device.
+	static const float factor[] = { -0.5f, 0.5f };
+	std::vector<uint32_t> splits, nextSplits, ranges, childFirst;
+	DeviceBuffer<uint32_t> deviceRanges, deviceChildFirst;
+	if (size_ > params_.bucketSize && extent > 2 * params_.minExtent)
+		splits.push_back(0);
+
+	for (uint32_t level = 0; level < kernels::mortonLevels && !splits.empty(); ++level)
+	{
+		const uint32_t count = splits.size();
+		ranges.resize(2 * count);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			ranges[2 * i] = octants_[splits[i]].offset;
+			ranges[2 * i + 1] = octants_[splits[i]].offset + octants_[splits[i]].size;
+		}
+
+		childFirst.resize(9 * count);
+		if (!deviceRanges.resize(ranges.size()) || !deviceChildFirst.resize(childFirst.size()))
+			return false;
+		if (cudaMemcpy(deviceRanges.data(), ranges.data(), ranges.size() * sizeof(uint32_t), cudaMemcpyHostToDevice) !=
+		    cudaSuccess)
+			return false;
+		kernels::childRanges<<<numBlocks(count), blockSize>>>(keys_.data(), deviceRanges.data(), count,
+		                                                      3 * (kernels::mortonLevels - 1 - level),
+		                                                      deviceChildFirst.data());
+		if (cudaGetLastError() != cudaSuccess)
+			return false;
+		if (cudaMemcpy(childFirst.data(), deviceChildFirst.data(), childFirst.size() * sizeof(uint32_t),
+		               cudaMemcpyDeviceToHost) != cudaSuccess)
+			return false;
+
+		nextSplits.clear();
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			const DeviceOctant parent = octants_[splits[i]];
+			const uint32_t* first = &childFirst[9 * i];
+			const float childExtent = 0.5f * parent.extent;
+			uint32_t childMask = 0;
+			const uint32_t firstChild = octants_.size();
+			for (uint32_t c = 0; c < 8; ++c)
+			{
+				if (first[c] == first[c + 1])
+					continue;
+				childMask |= (1 << c);
+
+				DeviceOctant octant;
+				octant.x = parent.x + factor[(c & 1) > 0] * parent.extent;
+				octant.y = parent.y + factor[(c & 2) > 0] * parent.extent;
+				octant.z = parent.z + factor[(c & 4) > 0] * parent.extent;
+				octant.extent = childExtent;
+				octant.offset = first[c];
+				octant.size = first[c + 1] - first[c];
+				octant.firstChild = 0;
+				octant.childMask = 0;
+				if (octant.size > params_.bucketSize && octant.extent > 2 * params_.minExtent)
+					nextSplits.push_back(octants_.size());
+				octants_.push_back(octant);
+			}
+			octants_[splits[i]].firstChild = firstChild;
+			octants_[splits[i]].childMask = childMask;
+		}
+		splits.swap(nextSplits);
+	}
+
+	if (!deviceOctants_.resize(octants_.size()))
+		return false;
+
+	return cudaMemcpy(deviceOctants_.data(), octants_.data(), octants_.size() * sizeof(DeviceOctant),
+	                  cudaMemcpyHostToDevice) == cudaSuccess;
+}
+
+inline void CudaOctree::clear()
+{
+	size_ = 0;
+	octants_.clear();
+	deviceOctants_.clear();
+	keys_.clear();
+	coordinates_.clear();
+	permutation_.clear();
+}
+
+inline bool CudaOctree::radiusNeighbors(const float* queries,
+                                        uint32_t M,
+                                        float radius,
+                                        DeviceBuffer<uint64_t>& offsets,
+                                        DeviceBuffer<uint32_t>& resultIndices,
+                                        DeviceBuffer<float>* sqrDistances,
+                                        uint32_t stride) const
+{
+	if (!offsets.resize(uint64_t(M) + 1) || cudaMemset(offsets.data(), 0, (uint64_t(M) + 1) * sizeof(uint64_t)) != cudaSuccess)
+		return false;
+	if (size_ == 0 || M == 0)
+		return resultIndices.resize(0) && (sqrDistances == 0 || sqrDistances->resize(0));
+
+	// count the neighbors of each query, which gives the offsets by an exclusive prefix sum.
+	const float sqrRadius = radius * radius;
+	DeviceBuffer<uint64_t> counts;
+	if (!counts.resize(uint64_t(M) + 1) || cudaMemset(counts.data(), 0, (uint64_t(M) + 1) * sizeof(uint64_t)) != cudaSuccess)
+		return false;
+	kernels::radiusNeighbors<false><<<numBlocks(M), blockSize>>>(deviceOctants_.data(), xs(), ys(), zs(),
+	                                                             permutation(), queries, M, stride, sqrRadius,
+	                                                             counts.data(), 0, 0);
+	if (cudaGetLastError() != cudaSuccess)
+		return false;
+
+	size_t tempBytes = 0;
+	cub::DeviceScan::ExclusiveSum(0, tempBytes, counts.data(), offsets.data(), M + 1);
+	DeviceBuffer<char> temp;
+	if (!temp.resize(tempBytes))
+		return false;
+	if (cub::DeviceScan::ExclusiveSum(temp.data(), tempBytes, counts.data(), offsets.data(), M + 1) != cudaSuccess)
+		return false;
+
+	uint64_t total = 0;
+	if (cudaMemcpy(&total, offsets.data() + M, sizeof(uint64_t), cudaMemcpyDeviceToHost) != cudaSuccess)
+		return false;
+	if (!resultIndices.resize(total) || (sqrDistances != 0 && !sqrDistances->resize(total)))
+		return false;
+	if (total == 0)
+		return true;
+
+	kernels::radiusNeighbors<true><<<numBlocks(M), blockSize>>>(deviceOctants_.data(), xs(), ys(), zs(),
+	                                                            permutation(), queries, M, stride, sqrRadius,
+	                                                            offsets.data(), resultIndices.data(),
+	                                                            (sqrDistances != 0) ? sqrDistances->data() : 0);
+	if (cudaGetLastError() != cudaSuccess)
+		return false;
+
+	return cudaDeviceSynchronize() == cudaSuccess;
+}
+
+inline bool CudaOctree::knnNeighbors(const float* queries,
+                                     uint32_t M,
+                                     uint32_t k,
+                                     uint32_t* resultIndices,
+                                     float* sqrDistances,
+                                     uint32_t stride) const
+{
+	if (k > kernels::maxK)
+		return false;
+	if (k == 0 || M == 0)
+		return true;
+
+	if (size_ == 0)
+	{
+		// no neighbors at all; 0xFF bytes give std::numeric_limits<uint32_t>::max().
+		if (cudaMemset(resultIndices, 0xFF, uint64_t(M) * k * sizeof(uint32_t)) != cudaSuccess)
+			return false;
+		if (sqrDistances == 0)
+			return true;
+		std::vector<float> infinity(uint64_t(M) * k, std::numeric_limits<float>::infinity());
+		return cudaMemcpy(sqrDistances, infinity.data(), infinity.size() * sizeof(float), cudaMemcpyHostToDevice) ==
+		       cudaSuccess;
+	}
+
+	kernels::knnNeighbors<<<numBlocks(M), blockSize>>>(deviceOctants_.data(), xs(), ys(), zs(), permutation(),
+	                                                   queries, M, stride, k, resultIndices, sqrDistances);
+	if (cudaGetLastError() != cudaSuccess)
+		return false;
+
+	return cudaDeviceSynchronize() == cudaSuccess;
+}
+} // namespace cuda
+} // namespace unibn
+
+#endif /* UNIBN_OCTREE_CUDA_H_ */
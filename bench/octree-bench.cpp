@@ -0,0 +1,529 @@
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../Octree.hpp"
+
+/** Benchmark suite for construction and queries of the octree.
+ *
+ * Sweeps over synthetic uniform, clustered and planar point clouds and optionally a real point cloud given with
+ * --file, several numbers of points, bucket sizes and radii. All results are written as JSON records, which contain
+ * the runtime, queries per second, memory and, if the kernel allows it, hardware counters:
+ *
+ *   ./octree-bench [--quick] [--file scan_001_points.dat] [--queries 10000] [--output results.json]
+ */
+
+class Point3f
+{
+ public:
+  Point3f(float x, float y, float z) : x(x), y(y), z(z)
+  {
+  }
+
+  float x, y, z;
+};
+
+// hardware counters measured with perf events, which are unavailable inside most containers.
+class PerfCounters
+{
+ public:
+  PerfCounters()
+  {
+#ifdef __linux__
+    const uint64_t configs[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_REFERENCES,
+                                PERF_COUNT_HW_CACHE_MISSES};
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+      struct perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = configs[i];
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.inherit = 1;  // include the OpenMP threads.
+      fds_[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#else
+    for (uint32_t i = 0; i < 4; ++i) fds_[i] = -1;
+#endif
+  }
+
+  ~PerfCounters()
+  {
+#ifdef __linux__
+    for (uint32_t i = 0; i < 4; ++i)
+      if (fds_[i] >= 0) close(fds_[i]);
+#endif
+  }
+
+  void start()
+  {
+#ifdef __linux__
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+      if (fds_[i] < 0) continue;
+      ioctl(fds_[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds_[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  void stop()
+  {
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+      values_[i] = -1;
+#ifdef __linux__
+      if (fds_[i] < 0) continue;
+      ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+      uint64_t value = 0;
+      if (read(fds_[i], &value, sizeof(value)) == sizeof(value)) values_[i] = value;
+#endif
+    }
+  }
+
+  // JSON object with the counters of the last measurement, where unavailable counters are null.
+  std::string json() const
+  {
+    const char* names[] = {"cycles", "instructions", "cacheReferences", "cacheMisses"};
+    std::ostringstream out;
+    out << "{";
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+      if (i > 0) out << ", ";
+      out << "\"" << names[i] << "\": ";
+      if (values_[i] < 0)
+        out << "null";
+      else
+        out << values_[i];
+    }
+    out << "}";
+    return out.str();
+  }
+
+ protected:
+  int fds_[4];
+  int64_t values_[4];
+};
+
+// resident memory of the process in bytes.
+uint64_t residentMemory()
+{
+#ifdef __linux__
+  std::ifstream in("/proc/self/statm");
+  uint64_t size = 0, resident = 0;
+  in >> size >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+// increase of the resident memory since before, which is zero if the process released memory in the meantime.
+uint64_t residentMemoryIncrease(uint64_t before)
+{
+  const int64_t increase = int64_t(residentMemory()) - int64_t(before);
+  return (increase > 0) ? uint64_t(increase) : 0;
+}
+
+uint64_t peakMemory()
+{
+#ifdef __linux__
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return uint64_t(usage.ru_maxrss) * 1024;
+#else
+  return 0;
+#endif
+}
+
+double seconds(const std::chrono::steady_clock::time_point& begin)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// uniformly distributed points inside a cube of 20m side length.
+void uniformCloud(std::vector<Point3f>& points, uint32_t N, uint32_t seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> coord(-10.0f, 10.0f);
+  points.clear();
+  for (uint32_t i = 0; i < N; ++i) points.push_back(Point3f(coord(rng), coord(rng), coord(rng)));
+}
+
+// points normally distributed around 50 cluster centers with different spreads.
+void clusteredCloud(std::vector<Point3f>& points, uint32_t N, uint32_t seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> center(-10.0f, 10.0f);
+  std::uniform_real_distribution<float> spread(0.3f, 2.0f);
+  std::vector<Point3f> centers;
+  std::vector<float> sigmas;
+  for (uint32_t i = 0; i < 50; ++i)
+  {
+    centers.push_back(Point3f(center(rng), center(rng), center(rng)));
+    sigmas.push_back(spread(rng));
+  }
+
+  std::normal_distribution<float> normal(0.0f, 1.0f);
+  std::uniform_int_distribution<uint32_t> cluster(0, centers.size() - 1);
+  points.clear();
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    uint32_t c = cluster(rng);
+    points.push_back(Point3f(centers[c].x + sigmas[c] * normal(rng), centers[c].y + sigmas[c] * normal(rng),
+                             centers[c].z + sigmas[c] * normal(rng)));
+  }
+}
+
+// points on a ground plane and four walls with some noise similar to a LiDAR scan of a street.
+void planarCloud(std::vector<Point3f>& points, uint32_t N, uint32_t seed)
+{
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> coord(-20.0f, 20.0f);
+  std::uniform_real_distribution<float> height(0.0f, 8.0f);
+  std::normal_distribution<float> noise(0.0f, 0.02f);
+  std::uniform_int_distribution<uint32_t> plane(0, 4);
+  points.clear();
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    const uint32_t p = plane(rng);
+    if (p == 0)
+      points.push_back(Point3f(coord(rng), coord(rng), noise(rng)));
+    else if (p <= 2)
+      points.push_back(Point3f(coord(rng), (p == 1 ? -20.0f : 20.0f) + noise(rng), height(rng)));
+    else
+      points.push_back(Point3f((p == 3 ? -20.0f : 20.0f) + noise(rng), coord(rng), height(rng)));
+  }
+}
+
+// reads the last three values of each line as coordinates, which supports xyz files and the "freiburg format".
+bool readCloud(const std::string& filename, std::vector<Point3f>& points)
+{
+  std::ifstream in(filename.c_str());
+  if (!in.is_open()) return false;
+
+  std::string line;
+  points.clear();
+  while (std::getline(in, line))
+  {
+    std::istringstream tokens(line);
+    std::vector<float> values;
+    float value;
+    while (tokens >> value) values.push_back(value);
+    if (values.size() < 3) continue;
+    const uint32_t n = values.size();
+    points.push_back(Point3f(values[n - 3], values[n - 2], values[n - 1]));
+  }
+
+  return !points.empty();
+}
+
+struct Config
+{
+  std::string dataset;
+  uint32_t bucketSize;
+  bool reorderPoints;
+};
+
+// quoted JSON string, where quotes, backslashes and control characters, e.g., of file names, are escaped.
+std::string jsonString(const std::string& value)
+{
+  std::ostringstream out;
+  out << "\"";
+  for (uint32_t i = 0; i < value.size(); ++i)
+  {
+    const unsigned char c = value[i];
+    if (c == '"' || c == '\\')
+      out << '\\' << c;
+    else if (c < 0x20)
+    {
+      char buffer[8];
+      std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+      out << buffer;
+    }
+    else
+      out << c;
+  }
+  out << "\"";
+  return out.str();
+}
+
+class Report
+{
+ public:
+  explicit Report(const std::string& filename) : filename_(filename), first_(true)
+  {
+  }
+
+  // starts a new record with the common configuration.
+  std::ostringstream& record(const std::string& benchmark, const Config& config, uint32_t N)
+  {
+    current_.str("");
+    current_ << "{\"benchmark\": " << jsonString(benchmark) << ", \"dataset\": " << jsonString(config.dataset)
+             << ", \"points\": " << N
+             << ", \"bucketSize\": " << config.bucketSize
+             << ", \"reorderPoints\": " << (config.reorderPoints ? "true" : "false");
+    return current_;
+  }
+
+  void finish(const PerfCounters& counters)
+  {
+    current_ << ", \"counters\": " << counters.json() << "}";
+    records_ << (first_ ? "" : ",\n") << "  " << current_.str();
+    first_ = false;
+    std::fprintf(stderr, "%s\n", current_.str().c_str());
+  }
+
+  bool write() const
+  {
+    const std::string json = "[\n" + records_.str() + "\n]\n";
+    if (filename_.empty())
+    {
+      std::fputs(json.c_str(), stdout);
+      return true;
+    }
+
+    std::ofstream out(filename_.c_str());
+    out << json;
+    return out.good();
+  }
+
+ protected:
+  std::string filename_;
+  std::ostringstream records_, current_;
+  bool first_;
+};
+
+void run(const std::vector<Point3f>& points, const Config& config, const std::vector<float>& radii, uint32_t numQueries,
+         Report& report)
+{
+  const uint32_t N = points.size();
+  unibn::OctreeParams params;
+  params.bucketSize = config.bucketSize;
+  params.reorderPoints = config.reorderPoints;
+  PerfCounters counters;
+
+  // median build time of three runs with each construction; the memory is the increase of the resident memory by
+  // the octree.
+  for (uint32_t m = 0; m < 2; ++m)
+  {
+    params.mortonBuild = (m == 1);
+    std::vector<double> buildTimes;
+    uint64_t memory = 0;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+      unibn::Octree<Point3f> octree;
+      const uint64_t before = residentMemory();
+      counters.start();
+      std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+      octree.initialize(points, params);
+      buildTimes.push_back(seconds(begin));
+      counters.stop();
+      memory = std::max(memory, residentMemoryIncrease(before));
+    }
+    std::sort(buildTimes.begin(), buildTimes.end());
+    report.record(params.mortonBuild ? "initializeMorton" : "initialize", config, N)
+        << ", \"seconds\": " << buildTimes[1] << ", \"pointsPerSecond\": " << N / buildTimes[1]
+        << ", \"memoryBytes\": " << memory << ", \"peakMemoryBytes\": " << peakMemory();
+    report.finish(counters);
+  }
+  params.mortonBuild = false;
+
+  unibn::Octree<Point3f> octree;
+  octree.initialize(points, params);
+
+  // queries at points of the cloud, which are slightly displaced for the nearest neighbor search.
+  std::mt19937 rng(4711);
+  std::uniform_int_distribution<uint32_t> pointIndex(0, N - 1);
+  std::uniform_real_distribution<float> displacement(-0.1f, 0.1f);
+  std::vector<Point3f> queries, displaced;
+  for (uint32_t i = 0; i < numQueries; ++i)
+  {
+    const Point3f& p = points[pointIndex(rng)];
+    queries.push_back(p);
+    displaced.push_back(Point3f(p.x + displacement(rng), p.y + displacement(rng), p.z + displacement(rng)));
+  }
+
+  std::vector<uint32_t> results;
+  std::vector<float> distances;
+  for (uint32_t r = 0; r < radii.size(); ++r)
+  {
+    for (uint32_t withDistances = 0; withDistances < 2; ++withDistances)
+    {
+      uint64_t numNeighbors = 0;
+      counters.start();
+      std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < numQueries; ++i)
+      {
+        if (withDistances)
+          octree.radiusNeighbors(queries[i], radii[r], results, distances);
+        else
+          octree.radiusNeighbors(queries[i], radii[r], results);
+        numNeighbors += results.size();
+      }
+      const double t = seconds(begin);
+      counters.stop();
+      report.record(withDistances ? "radiusNeighborsDistances" : "radiusNeighbors", config, N)
+          << ", \"radius\": " << radii[r] << ", \"queries\": " << numQueries << ", \"seconds\": " << t
+          << ", \"queriesPerSecond\": " << numQueries / t << ", \"meanNeighbors\": " << double(numNeighbors) / numQueries;
+      report.finish(counters);
+    }
+  }
+
+  {
+    int64_t checksum = 0;
+    counters.start();
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < numQueries; ++i) checksum += octree.findNeighbor(displaced[i]);
+    const double t = seconds(begin);
+    counters.stop();
+    report.record("findNeighbor", config, N) << ", \"queries\": " << numQueries << ", \"seconds\": " << t
+                                             << ", \"queriesPerSecond\": " << numQueries / t << ", \"checksum\": "
+                                             << checksum;
+    report.finish(counters);
+  }
+
+  for (int depth = 2; depth <= 4; depth += 2)
+  {
+    std::vector<std::vector<uint32_t> > indicesList;
+    counters.start();
+    std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+    octree.getOctantIndicesAtSpecifiedDepth(depth, indicesList);
+    double t = seconds(begin);
+    counters.stop();
+    report.record("getOctantIndicesAtSpecifiedDepth", config, N)
+        << ", \"depth\": " << depth << ", \"octants\": " << indicesList.size() << ", \"seconds\": " << t;
+    report.finish(counters);
+
+    // queries at the points of each octant in turn, as done when processing the octants in parallel.
+    std::vector<std::pair<uint32_t, uint32_t> > octantQueries;
+    const uint32_t stride = std::max<uint32_t>(1, N / numQueries);
+    for (uint32_t o = 0; o < indicesList.size(); ++o)
+    {
+      for (uint32_t i = 0; i < indicesList[o].size(); i += stride)
+        octantQueries.push_back(std::make_pair(o, indicesList[o][i]));
+    }
+
+    for (uint32_t r = 0; r < radii.size(); ++r)
+    {
+      uint32_t numLimited = 0;
+      counters.start();
+      begin = std::chrono::steady_clock::now();
+      for (uint32_t i = 0; i < octantQueries.size(); ++i)
+      {
+        if (octree.radiusSearchLimitInOneOctant(octantQueries[i].first, points[octantQueries[i].second], radii[r],
+                                                results))
+          numLimited += 1;
+      }
+      t = seconds(begin);
+      counters.stop();
+      report.record("radiusSearchLimitInOneOctant", config, N)
+          << ", \"depth\": " << depth << ", \"radius\": " << radii[r] << ", \"queries\": " << octantQueries.size()
+          << ", \"seconds\": " << t << ", \"queriesPerSecond\": " << octantQueries.size() / t
+          << ", \"limitedFraction\": " << double(numLimited) / std::max<size_t>(1, octantQueries.size());
+      report.finish(counters);
+    }
+  }
+}
+
+int main(int argc, char** argv)
+{
+  bool quick = false;
+  std::string filename, output;
+  uint32_t numQueries = 10000;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string arg = argv[i];
+    if (arg == "--quick")
+      quick = true;
+    else if (arg == "--file" && i + 1 < argc)
+      filename = argv[++i];
+    else if (arg == "--output" && i + 1 < argc)
+      output = argv[++i];
+    else if (arg == "--queries" && i + 1 < argc)
+      numQueries = std::atoi(argv[++i]);
+    else
+    {
+      std::fprintf(stderr, "usage: %s [--quick] [--file point cloud] [--queries N] [--output results.json]\n", argv[0]);
+      return -1;
+    }
+  }
+
+  std::vector<uint32_t> sizes, bucketSizes;
+  std::vector<float> radii;
+  std::vector<bool> reorder;
+  sizes.push_back(100000);
+  bucketSizes.push_back(32);
+  radii.push_back(0.2f);
+  radii.push_back(0.5f);
+  reorder.push_back(false);
+  if (!quick)
+  {
+    sizes.push_back(1000000);
+    bucketSizes.insert(bucketSizes.begin(), 16);
+    bucketSizes.push_back(64);
+    bucketSizes.push_back(128);
+    radii.push_back(1.0f);
+    reorder.push_back(true);
+  }
+
+  std::vector<std::pair<std::string, std::vector<Point3f> > > clouds;
+  for (uint32_t s = 0; s < sizes.size(); ++s)
+  {
+    std::vector<Point3f> points;
+    uniformCloud(points, sizes[s], 1234);
+    clouds.push_back(std::make_pair(std::string("uniform"), points));
+    clusteredCloud(points, sizes[s], 1234);
+    clouds.push_back(std::make_pair(std::string("clustered"), points));
+    planarCloud(points, sizes[s], 1234);
+    clouds.push_back(std::make_pair(std::string("planar"), points));
+  }
+  if (!filename.empty())
+  {
+    std::vector<Point3f> points;
+    if (!readCloud(filename, points))
+    {
+      std::fprintf(stderr, "unable to read point cloud %s.\n", filename.c_str());
+      return -1;
+    }
+    clouds.push_back(std::make_pair(filename, points));
+  }
+
+  Report report(output);
+  for (uint32_t c = 0; c < clouds.size(); ++c)
+  {
+    for (uint32_t b = 0; b < bucketSizes.size(); ++b)
+    {
+      for (uint32_t o = 0; o < reorder.size(); ++o)
+      {
+        Config config;
+        config.dataset = clouds[c].first;
+        config.bucketSize = bucketSizes[b];
+        config.reorderPoints = reorder[o];
+        run(clouds[c].second, config, radii, numQueries, report);
+      }
+    }
+  }
+
+  return report.write() ? 0 : -1;
+}
@@ -17,7 +17,7 @@ class SimpleDescriptor
   {
   }
 
-  void compute(const PointT& query, const std::vector<PointT>& pts, const unibn::Octree<PointT>& oct,
+  void compute(const PointT& query, const std::vector<PointT>& /* pts */, const unibn::Octree<PointT>& oct,
                std::vector<float>& descriptor)
   {
     memset(&descriptor[0], 0, dim_);
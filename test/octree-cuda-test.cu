@@ -0,0 +1,223 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../OctreeCuda.cuh"
+
+namespace
+{
+
+class Point3f
+{
+ public:
+  Point3f(float x, float y, float z) : x(x), y(y), z(z)
+  {
+  }
+
+  float x, y, z;
+};
+
+void randomPoints(std::vector<Point3f>& pts, uint32_t N, uint32_t seed = 0)
+{
+  std::mt19937 mt(seed);
+  std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+  pts.clear();
+  for (uint32_t i = 0; i < N; ++i) pts.push_back(Point3f(uniform(mt), uniform(mt), uniform(mt)));
+}
+
+template <typename T>
+std::vector<T> download(const T* data, uint64_t size)
+{
+  std::vector<T> result(size);
+  if (size > 0) cudaMemcpy(result.data(), data, size * sizeof(T), cudaMemcpyDeviceToHost);
+  return result;
+}
+
+// The fixture has the name, which is befriended by unibn::Octree, to compare the hierarchies.
+class OctreeTest : public ::testing::Test
+{
+ protected:
+  typedef unibn::Octree<Point3f>::Octant Octant;
+
+  // compares the device octant with the host octant, its points and recursively its children; octants at the depth
+  // limit of the Morton keys are leafs on the device, which only contain the same points.
+  void compareOctants(const unibn::Octree<Point3f>& octree, const Octant* octant,
+                      const std::vector<unibn::cuda::DeviceOctant>& deviceOctants, uint32_t deviceIndex,
+                      const std::vector<uint32_t>& permutation, uint32_t depth, uint32_t& numOctants)
+  {
+    ASSERT_LT(deviceIndex, deviceOctants.size());
+    const unibn::cuda::DeviceOctant& deviceOctant = deviceOctants[deviceIndex];
+    ASSERT_FLOAT_EQ(octant->x, deviceOctant.x);
+    ASSERT_FLOAT_EQ(octant->y, deviceOctant.y);
+    ASSERT_FLOAT_EQ(octant->z, deviceOctant.z);
+    ASSERT_FLOAT_EQ(octant->extent, deviceOctant.extent);
+    ASSERT_EQ(octant->size, deviceOctant.size);
+    numOctants += 1;
+
+    std::vector<uint32_t> expected, indices(permutation.begin() + deviceOctant.offset,
+                                            permutation.begin() + deviceOctant.offset + deviceOctant.size);
+    octree.getIndices(octant, expected);
+    std::sort(expected.begin(), expected.end());
+    std::sort(indices.begin(), indices.end());
+    ASSERT_EQ(expected, indices);
+
+    if (depth == unibn::cuda::kernels::mortonLevels)
+    {
+      ASSERT_EQ(0, deviceOctant.childMask);
+      return;
+    }
+    ASSERT_EQ(uint32_t(octant->childMask), deviceOctant.childMask);
+    ASSERT_EQ(octant->isLeaf, deviceOctant.childMask == 0);
+
+    // children are stored consecutively in the order of their Morton codes.
+    uint32_t deviceChild = deviceOctant.firstChild;
+    for (uint32_t c = 0; c < 8; ++c)
+    {
+      const Octant* child = octree.child(octant, c);
+      if (child == 0) continue;
+      compareOctants(octree, child, deviceOctants, deviceChild, permutation, depth + 1, numOctants);
+      if (HasFatalFailure()) return;
+      deviceChild += 1;
+    }
+  }
+
+  void compareHierarchy(const unibn::Octree<Point3f>& octree, const unibn::cuda::CudaOctree& cudaOctree)
+  {
+    const std::vector<unibn::cuda::DeviceOctant>& deviceOctants = cudaOctree.octants();
+    uint32_t numOctants = 0;
+    compareOctants(octree, octree.root_, deviceOctants, 0, download(cudaOctree.permutation(), cudaOctree.size()), 0,
+                   numOctants);
+    if (HasFatalFailure()) return;
+    // all device octants are reachable.
+    ASSERT_EQ(deviceOctants.size(), numOctants);
+  }
+};
+
+TEST_F(OctreeTest, CudaHierarchy)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 20000, 4242);
+  for (uint32_t i = 0; i < 50; ++i) points.push_back(points[7]);
+  const uint32_t N = points.size();
+
+  unibn::cuda::DeviceBuffer<float> devicePoints;
+  ASSERT_TRUE(devicePoints.resize(3 * N));
+  cudaMemcpy(devicePoints.data(), &points[0], 3 * N * sizeof(float), cudaMemcpyHostToDevice);
+
+  for (uint32_t bucketSize : {1u, 4u, 32u})
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = bucketSize;
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    unibn::cuda::CudaOctree cudaOctree;
+    ASSERT_TRUE(cudaOctree.initialize(devicePoints.data(), N, params));
+    compareHierarchy(octree, cudaOctree);
+    if (HasFatalFailure()) return;
+  }
+}
+
+TEST(CudaOctreeTest, Queries)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 20000, 1337);
+  // duplicates, which can not be split.
+  for (uint32_t i = 0; i < 50; ++i) points.push_back(points[3]);
+  randomPoints(queries, 1000, 4321);
+  queries.push_back(Point3f(100.0f, 100.0f, 100.0f));
+  const uint32_t N = points.size(), M = queries.size();
+
+  unibn::cuda::DeviceBuffer<float> devicePoints, deviceQueries;
+  ASSERT_TRUE(devicePoints.resize(3 * N));
+  ASSERT_TRUE(deviceQueries.resize(3 * M));
+  cudaMemcpy(devicePoints.data(), &points[0], 3 * N * sizeof(float), cudaMemcpyHostToDevice);
+  cudaMemcpy(deviceQueries.data(), &queries[0], 3 * M * sizeof(float), cudaMemcpyHostToDevice);
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = (run == 0) ? 32 : 4;
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    unibn::cuda::CudaOctree cudaOctree;
+    ASSERT_TRUE(cudaOctree.initialize(devicePoints.data(), N, params));
+    ASSERT_EQ(N, cudaOctree.size());
+
+    // every point is in exactly one leaf.
+    std::vector<uint32_t> permutation = download(cudaOctree.permutation(), N);
+    std::sort(permutation.begin(), permutation.end());
+    for (uint32_t i = 0; i < N; ++i) ASSERT_EQ(i, permutation[i]);
+
+    const std::vector<unibn::cuda::DeviceOctant>& octants = cudaOctree.octants();
+    uint32_t leafSize = 0;
+    for (uint32_t i = 0; i < octants.size(); ++i)
+    {
+      if (octants[i].childMask == 0) leafSize += octants[i].size;
+    }
+    ASSERT_EQ(N, leafSize);
+
+    for (float radius : {0.05f, 0.3f, 4.0f})
+    {
+      unibn::cuda::DeviceBuffer<uint64_t> offsets;
+      unibn::cuda::DeviceBuffer<uint32_t> resultIndices;
+      unibn::cuda::DeviceBuffer<float> sqrDistances;
+      ASSERT_TRUE(cudaOctree.radiusNeighbors(deviceQueries.data(), M, radius, offsets, resultIndices, &sqrDistances));
+      std::vector<uint64_t> hostOffsets = download(offsets.data(), M + 1);
+      std::vector<uint32_t> hostIndices = download(resultIndices.data(), resultIndices.size());
+      ASSERT_EQ(hostOffsets[M], hostIndices.size());
+
+      std::vector<uint32_t> expected;
+      for (uint32_t q = 0; q < M; ++q)
+      {
+        octree.radiusNeighbors<unibn::L2Distance<Point3f> >(queries[q], radius, expected);
+        std::vector<uint32_t> neighbors(hostIndices.begin() + hostOffsets[q], hostIndices.begin() + hostOffsets[q + 1]);
+        std::sort(expected.begin(), expected.end());
+        std::sort(neighbors.begin(), neighbors.end());
+        ASSERT_EQ(expected, neighbors);
+      }
+    }
+
+    for (uint32_t k : {1u, 8u, 32u})
+    {
+      unibn::cuda::DeviceBuffer<uint32_t> resultIndices;
+      unibn::cuda::DeviceBuffer<float> sqrDistances;
+      ASSERT_TRUE(resultIndices.resize(uint64_t(M) * k));
+      ASSERT_TRUE(sqrDistances.resize(uint64_t(M) * k));
+      ASSERT_TRUE(cudaOctree.knnNeighbors(deviceQueries.data(), M, k, resultIndices.data(), sqrDistances.data()));
+      std::vector<float> distances = download(sqrDistances.data(), uint64_t(M) * k);
+
+      std::vector<uint32_t> expectedIndices(uint64_t(M) * k);
+      std::vector<float> expectedDistances(uint64_t(M) * k);
+      octree.knnNeighbors(queries, k, &expectedIndices[0], &expectedDistances[0]);
+      // ties may be resolved differently, but the distances are the same.
+      for (uint64_t i = 0; i < distances.size(); ++i) ASSERT_FLOAT_EQ(expectedDistances[i], distances[i]);
+    }
+
+    unibn::cuda::DeviceBuffer<uint32_t> resultIndices;
+    ASSERT_TRUE(resultIndices.resize(uint64_t(M) * 33));
+    ASSERT_FALSE(cudaOctree.knnNeighbors(deviceQueries.data(), M, 33, resultIndices.data(), 0));
+  }
+}
+
+TEST(CudaOctreeTest, Empty)
+{
+  unibn::cuda::CudaOctree cudaOctree;
+  ASSERT_TRUE(cudaOctree.initialize(0, 0));
+  ASSERT_EQ(0, cudaOctree.size());
+
+  std::vector<Point3f> queries(1, Point3f(0.0f, 0.0f, 0.0f));
+  unibn::cuda::DeviceBuffer<float> deviceQueries;
+  ASSERT_TRUE(deviceQueries.resize(3));
+  cudaMemcpy(deviceQueries.data(), &queries[0], 3 * sizeof(float), cudaMemcpyHostToDevice);
+
+  unibn::cuda::DeviceBuffer<uint64_t> offsets;
+  unibn::cuda::DeviceBuffer<uint32_t> resultIndices;
+  ASSERT_TRUE(cudaOctree.radiusNeighbors(deviceQueries.data(), 1, 1.0f, offsets, resultIndices));
+  ASSERT_EQ(0, download(offsets.data(), 2)[1]);
+  ASSERT_EQ(0, resultIndices.size());
+}
+}
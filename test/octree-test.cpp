@@ -1,9 +1,18 @@
 #include <gtest/gtest.h>
 #include <boost/random.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
 #include <map>
 #include <queue>
 #include <string>
+#include <thread>
 
+// collect the query statistics checked by QueryStats.
+#define UNIBN_OCTREE_STATS
 #include "../Octree.hpp"
 
 namespace
@@ -67,6 +76,30 @@ class NaiveNeighborSearch
     }
   }
 
+  template <typename Distance>
+  void knnNeighbors(const PointT& query, uint32_t k, std::vector<uint32_t>& resultIndices, std::vector<float>& sqrDistances,
+                    float minDistance = -1.0f)
+  {
+    const std::vector<PointT>& pts = *data_;
+    float sqrMinDistance = (minDistance < 0) ? minDistance : Distance::sqr(minDistance);
+    std::vector<std::pair<float, uint32_t> > candidates;
+    for (uint32_t i = 0; i < pts.size(); ++i)
+    {
+      float dist = Distance::compute(query, pts[i]);
+      if (dist > sqrMinDistance) candidates.push_back(std::make_pair(dist, i));
+    }
+    std::sort(candidates.begin(), candidates.end());
+    if (candidates.size() > k) candidates.resize(k);
+
+    resultIndices.clear();
+    sqrDistances.clear();
+    for (uint32_t i = 0; i < candidates.size(); ++i)
+    {
+      sqrDistances.push_back(candidates[i].first);
+      resultIndices.push_back(candidates[i].second);
+    }
+  }
+
  protected:
   const std::vector<PointT>* data_;
 };
@@ -86,17 +119,127 @@ class OctreeTest : public ::testing::Test
     return oct.root_;
   }
 
+  template <typename PointT>
+  const typename unibn::Octree<PointT>::Octant* getChild(const unibn::Octree<PointT>& oct,
+                                                         const typename unibn::Octree<PointT>::Octant* octant, uint32_t c)
+  {
+    return oct.child(octant, c);
+  }
+
+  template <typename PointT>
+  const std::vector<typename unibn::Octree<PointT>::Octant>& getOctants(const unibn::Octree<PointT>& oct)
+  {
+    return oct.octants_;
+  }
+
+  template <typename PointT>
+  const uint32_t* getPermutation(const unibn::Octree<PointT>& oct)
+  {
+    return oct.permutation_;
+  }
+
+  template <typename PointT>
+  Point3f getReorderedPoint(const unibn::Octree<PointT>& oct, uint32_t k)
+  {
+    return Point3f(oct.xs_[k], oct.ys_[k], oct.zs_[k]);
+  }
+
   template <typename PointT>
   const std::vector<uint32_t>& getSuccessors(const unibn::Octree<PointT>& oct)
   {
     return oct.successors_;
   }
 
+  template <typename PointT>
+  uint32_t getNumMappedOctants(const unibn::Octree<PointT>& oct)
+  {
+    return reinterpret_cast<const typename unibn::Octree<PointT>::FileHeader*>(oct.mapping_)->numOctants;
+  }
+
   template <typename Distance>
   bool overlaps(const Point3f& query, float radius, float sqRadius, const Octant* o)
   {
     return unibn::Octree<Point3f>::template overlaps<Distance>(query, radius, sqRadius, o);
   }
+
+  // checks that the octree contains exactly the points with inserted[i] in consistently linked octants.
+  void checkConsistency(const unibn::Octree<Point3f>& oct, const std::vector<Point3f>& points,
+                        const std::vector<bool>& inserted, uint32_t bucketSize)
+  {
+    const std::vector<uint32_t>& successors = oct.successors_;
+    std::vector<uint32_t> elementCount(points.size(), 0);
+    uint32_t numOctants = 0;
+
+    std::queue<const Octant*> queue;
+    queue.push(oct.root_);
+    while (!queue.empty())
+    {
+      const Octant* octant = queue.front();
+      queue.pop();
+      numOctants += 1;
+
+      uint32_t idx = octant->start;
+      uint32_t lastIdx = idx;
+      for (uint32_t i = 0; i < octant->size; ++i)
+      {
+        ASSERT_TRUE(inserted[idx]);
+        const float tolerance = 1e-4f * (1.0f + octant->extent);
+        ASSERT_LE(std::abs(points[idx].x - octant->x), octant->extent + tolerance);
+        ASSERT_LE(std::abs(points[idx].y - octant->y), octant->extent + tolerance);
+        ASSERT_LE(std::abs(points[idx].z - octant->z), octant->extent + tolerance);
+        if (octant->isLeaf)
+        {
+          elementCount[idx] += 1;
+        }
+        lastIdx = idx;
+        idx = successors[idx];
+      }
+      ASSERT_EQ(octant->end, lastIdx);
+      ASSERT_EQ(octant->size <= bucketSize, octant->isLeaf);
+
+      const Octant* lastchild = 0;
+      uint32_t pointSum = 0;
+      for (uint32_t c = 0; c < 8; ++c)
+      {
+        const Octant* child = oct.child(octant, c);
+        if (child == 0) continue;
+        if (lastchild == 0)
+        {
+          ASSERT_EQ(octant->start, child->start);
+        }
+        else
+        {
+          ASSERT_EQ(lastchild + 1, child);
+          ASSERT_EQ(child->start, successors[lastchild->end]);
+        }
+        pointSum += child->size;
+        lastchild = child;
+        queue.push(child);
+
+        // points of a child are selected by the same rule as in createOctant.
+        uint32_t childIdx = child->start;
+        for (uint32_t i = 0; i < child->size; ++i)
+        {
+          uint32_t code = (points[childIdx].x > octant->x) | ((points[childIdx].y > octant->y) << 1) |
+                          ((points[childIdx].z > octant->z) << 2);
+          ASSERT_EQ(c, code);
+          childIdx = successors[childIdx];
+        }
+      }
+      if (lastchild != 0)
+      {
+        ASSERT_EQ(octant->end, lastchild->end);
+      }
+      if (!octant->isLeaf)
+      {
+        ASSERT_EQ(octant->size, pointSum);
+      }
+    }
+
+    // all octants are reachable and each point is inside exactly one leaf.
+    ASSERT_EQ(oct.octants_.size(), numOctants);
+    for (uint32_t i = 0; i < points.size(); ++i) ASSERT_EQ(inserted[i] ? 1 : 0, elementCount[i]);
+  }
 };
 
 template <typename PointT>
@@ -193,16 +336,20 @@ TEST_F(OctreeTest, Initialize)
     ASSERT_EQ(octant->end, lastIdx);
 
     bool shouldBeLeaf = true;
-    Octant* firstchild = 0;
-    Octant* lastchild = 0;
+    const Octant* firstchild = 0;
+    const Octant* lastchild = 0;
     uint32_t pointSum = 0;
 
     for (uint32_t c = 0; c < 8; ++c)
     {
-      Octant* child = octant->child[c];
+      const Octant* child = getChild(oct, octant, c);
+      ASSERT_EQ((octant->childMask & (1 << c)) != 0, child != 0);
       if (child == 0) continue;
       shouldBeLeaf = false;
 
+      // children are stored consecutively in the octant array.
+      if (lastchild != 0) ASSERT_EQ(lastchild + 1, child);
+
       // child nodes should have start end intervals, which are true subsets of
       // the parent.
       if (firstchild == 0) firstchild = child;
@@ -323,16 +470,20 @@ TEST_F(OctreeTest, Initialize_minExtent)
     ASSERT_EQ(octant->end, lastIdx);
 
     bool shouldBeLeaf = true;
-    Octant* firstchild = 0;
-    Octant* lastchild = 0;
+    const Octant* firstchild = 0;
+    const Octant* lastchild = 0;
     uint32_t pointSum = 0;
 
     for (uint32_t c = 0; c < 8; ++c)
     {
-      Octant* child = octant->child[c];
+      const Octant* child = getChild(oct, octant, c);
+      ASSERT_EQ((octant->childMask & (1 << c)) != 0, child != 0);
       if (child == 0) continue;
       shouldBeLeaf = false;
 
+      // children are stored consecutively in the octant array.
+      if (lastchild != 0) ASSERT_EQ(lastchild + 1, child);
+
       // child nodes should have start end intervals, which are true subsets of
       // the parent.
       if (firstchild == 0) firstchild = child;
@@ -377,6 +528,281 @@ TEST_F(OctreeTest, Initialize_minExtent)
   }
 }
 
+TEST_F(OctreeTest, Initialize_parallel)
+{
+  uint32_t N = 100000;
+  std::vector<Point3f> points;
+  randomPoints(points, N, 1337);
+
+  std::vector<uint32_t> indexes;
+  for (uint32_t i = 0; i < N; i += 3) indexes.push_back(i);
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    unibn::Octree<Point3f> serial;
+    if (run == 0) serial.initialize(points, params);
+    if (run == 1) serial.initialize(points, indexes, params);
+
+    params.parallelBuild = true;
+    params.parallelThreshold = 500;
+    unibn::Octree<Point3f> parallel;
+    if (run == 0) parallel.initialize(points, params);
+    if (run == 1) parallel.initialize(points, indexes, params);
+
+    // the parallel construction must result in exactly the same octree.
+    ASSERT_EQ(getSuccessors(serial), getSuccessors(parallel));
+
+    const std::vector<Octant>& expected = getOctants(serial);
+    const std::vector<Octant>& octants = getOctants(parallel);
+    ASSERT_EQ(expected.size(), octants.size());
+    for (uint32_t i = 0; i < expected.size(); ++i)
+    {
+      ASSERT_EQ(expected[i].x, octants[i].x);
+      ASSERT_EQ(expected[i].y, octants[i].y);
+      ASSERT_EQ(expected[i].z, octants[i].z);
+      ASSERT_EQ(expected[i].extent, octants[i].extent);
+      ASSERT_EQ(expected[i].start, octants[i].start);
+      ASSERT_EQ(expected[i].end, octants[i].end);
+      ASSERT_EQ(expected[i].size, octants[i].size);
+      ASSERT_EQ(expected[i].isLeaf, octants[i].isLeaf);
+      ASSERT_EQ(expected[i].childMask, octants[i].childMask);
+      if (!expected[i].isLeaf) ASSERT_EQ(expected[i].firstChild, octants[i].firstChild);
+    }
+  }
+}
+
+TEST_F(OctreeTest, Initialize_morton)
+{
+  uint32_t N = 50000;
+  std::vector<Point3f> points, cluster;
+  randomPoints(points, N, 1337);
+  // a dense cluster, which needs more levels than the Morton keys provide, and exact duplicates.
+  randomPoints(cluster, 200, 4321);
+  for (uint32_t i = 0; i < cluster.size(); ++i)
+    points.push_back(Point3f(1.0f + 1e-6f * cluster[i].x, 1.0f + 1e-6f * cluster[i].y, 1.0f + 1e-6f * cluster[i].z));
+  for (uint32_t i = 0; i < 40; ++i) points.push_back(points[7]);
+  N = points.size();
+
+  std::vector<uint32_t> indexes;
+  for (uint32_t i = 0; i < N; i += 3) indexes.push_back(i);
+
+  for (uint32_t run = 0; run < 8; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = (run & 2) ? 4 : 32;
+    params.minExtent = (run & 4) ? 0.05f : 0.0f;
+    params.reorderPoints = true;
+    unibn::Octree<Point3f> serial;
+    if (run & 1)
+      serial.initialize(points, indexes, params);
+    else
+      serial.initialize(points, params);
+
+    params.mortonBuild = true;
+    params.parallelBuild = (run & 2);
+    unibn::Octree<Point3f> morton;
+    if (run & 1)
+      morton.initialize(points, indexes, params);
+    else
+      morton.initialize(points, params);
+
+    // the construction from the sorted keys must result in exactly the same octree.
+    const std::vector<Octant>& expected = getOctants(serial);
+    const std::vector<Octant>& octants = getOctants(morton);
+    ASSERT_EQ(expected.size(), octants.size());
+    for (uint32_t i = 0; i < expected.size(); ++i)
+    {
+      ASSERT_EQ(expected[i].x, octants[i].x);
+      ASSERT_EQ(expected[i].y, octants[i].y);
+      ASSERT_EQ(expected[i].z, octants[i].z);
+      ASSERT_EQ(expected[i].extent, octants[i].extent);
+      ASSERT_EQ(expected[i].start, octants[i].start);
+      ASSERT_EQ(expected[i].end, octants[i].end);
+      ASSERT_EQ(expected[i].size, octants[i].size);
+      ASSERT_EQ(expected[i].offset, octants[i].offset);
+      ASSERT_EQ(expected[i].isLeaf, octants[i].isLeaf);
+      ASSERT_EQ(expected[i].childMask, octants[i].childMask);
+      if (!expected[i].isLeaf) ASSERT_EQ(expected[i].firstChild, octants[i].firstChild);
+    }
+
+    // the successors only differ in the unused successor of the last point.
+    std::vector<uint32_t> expectedSuccessors = getSuccessors(serial);
+    std::vector<uint32_t> successors = getSuccessors(morton);
+    expectedSuccessors[expected[0].end] = successors[expected[0].end] = 0;
+    ASSERT_EQ(expectedSuccessors, successors);
+    for (uint32_t k = 0; k < expected[0].size; ++k) ASSERT_EQ(getPermutation(serial)[k], getPermutation(morton)[k]);
+  }
+}
+
+TEST_F(OctreeTest, Reinitialize)
+{
+  std::vector<Point3f> points, other;
+  randomPoints(points, 20000, 1337);
+  randomPoints(other, 20000, 4321);
+
+  unibn::OctreeParams params;
+  params.bucketSize = 16;
+  params.reorderPoints = true;
+  unibn::Octree<Point3f> octree, expected;
+  octree.initialize(points, params);
+  const Octant* octants = &getOctants(octree)[0];
+  const uint32_t* permutation = getPermutation(octree);
+
+  // successive frames reuse the memory of the previous frame.
+  for (uint32_t run = 0; run < 3; ++run)
+  {
+    const std::vector<Point3f>& pts = (run == 1) ? other : points;
+    octree.initialize(pts, params);
+    expected.clear();
+    expected.initialize(pts, params);
+    if (run != 1)
+    {
+      ASSERT_EQ(octants, &getOctants(octree)[0]);
+      ASSERT_EQ(permutation, getPermutation(octree));
+    }
+
+    ASSERT_EQ(getOctants(expected).size(), getOctants(octree).size());
+    for (uint32_t i = 0; i < getOctants(expected).size(); ++i)
+    {
+      ASSERT_EQ(getOctants(expected)[i].size, getOctants(octree)[i].size);
+      ASSERT_EQ(getOctants(expected)[i].start, getOctants(octree)[i].start);
+      ASSERT_EQ(getOctants(expected)[i].childMask, getOctants(octree)[i].childMask);
+    }
+    for (uint32_t k = 0; k < pts.size(); ++k) ASSERT_EQ(getPermutation(expected)[k], getPermutation(octree)[k]);
+  }
+
+  octree.clear();
+  ASSERT_EQ(0, getOctants(octree).capacity());
+  ASSERT_EQ(0, octree.shape().bytes);
+}
+
+TEST_F(OctreeTest, SharedOctree)
+{
+  std::vector<Point3f> points[2];
+  randomPoints(points[0], 5000, 1337);
+  randomPoints(points[1], 3000, 4321);
+  const Point3f query(0.1f, 0.2f, -0.3f);
+
+  unibn::OctreeParams params;
+  params.bucketSize = 16;
+  std::vector<uint32_t> expected[2];
+  for (uint32_t i = 0; i < 2; ++i)
+  {
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points[i], params);
+    octree.radiusNeighbors(query, 0.5f, expected[i]);
+    std::sort(expected[i].begin(), expected[i].end());
+  }
+
+  unibn::SharedOctree<Point3f> shared;
+  std::vector<uint32_t> resultIndices;
+  shared.snapshot()->radiusNeighbors(query, 0.5f, resultIndices);
+  ASSERT_EQ(0, resultIndices.size());
+
+  // without snapshots, the two octrees are used alternately.
+  shared.rebuild(points[0], params);
+  const unibn::Octree<Point3f>* first = shared.snapshot().get();
+  shared.rebuild(points[1], params);
+  const unibn::Octree<Point3f>* second = shared.snapshot().get();
+  ASSERT_NE(first, second);
+  shared.rebuild(points[0], params);
+  ASSERT_EQ(first, shared.snapshot().get());
+
+  // a held snapshot stays valid and unchanged during rebuilds.
+  unibn::SharedOctree<Point3f>::Snapshot snapshot = shared.snapshot();
+  shared.rebuild(points[1], params);
+  shared.rebuild(points[0], params);
+  ASSERT_NE(snapshot.get(), shared.snapshot().get());
+  snapshot->radiusNeighbors(query, 0.5f, resultIndices);
+  std::sort(resultIndices.begin(), resultIndices.end());
+  ASSERT_EQ(expected[0], resultIndices);
+  snapshot.reset();
+
+  // readers see complete octrees only, while the octree is rebuilt concurrently.
+  std::atomic<bool> failed(false);
+  std::vector<std::thread> readers;
+  for (uint32_t t = 0; t < 2; ++t)
+  {
+    readers.push_back(std::thread([&shared, &expected, &query, &failed]() {
+      std::vector<uint32_t> neighbors;
+      for (uint32_t i = 0; i < 200; ++i)
+      {
+        unibn::SharedOctree<Point3f>::Snapshot current = shared.snapshot();
+        current->radiusNeighbors(query, 0.5f, neighbors);
+        std::sort(neighbors.begin(), neighbors.end());
+        if (neighbors != expected[0] && neighbors != expected[1]) failed = true;
+      }
+    }));
+  }
+  for (uint32_t i = 0; i < 50; ++i) shared.rebuild(points[i % 2], params);
+  for (uint32_t t = 0; t < readers.size(); ++t) readers[t].join();
+  ASSERT_FALSE(failed);
+
+  // snapshots may outlive the shared octree.
+  unibn::SharedOctree<Point3f>::Snapshot remaining;
+  {
+    unibn::SharedOctree<Point3f> local;
+    local.rebuild(points[1], params);
+    remaining = local.snapshot();
+    local.rebuild(points[0], params);
+  }
+  remaining->radiusNeighbors(query, 0.5f, resultIndices);
+  std::sort(resultIndices.begin(), resultIndices.end());
+  ASSERT_EQ(expected[1], resultIndices);
+}
+
+TEST_F(OctreeTest, StridedPoints)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 3000, 1337);
+  randomPoints(queries, 100, 4321);
+  const uint32_t N = points.size();
+
+  // unaligned records of 18 bytes: intensity, x, y, z and a 2 byte ring number.
+  const uint32_t stride = 18;
+  std::vector<char> buffer(N * stride + 1);
+  char* data = &buffer[1];
+  for (uint32_t i = 0; i < N; ++i)
+  {
+    const float record[4] = { float(i), points[i].x, points[i].y, points[i].z };
+    std::memcpy(data + i * stride, record, sizeof(record));
+  }
+  unibn::StridedPoints view(data, N, stride, 4, 8, 12);
+  ASSERT_EQ(N, view.size());
+  ASSERT_EQ(points[7].y, view[7].y);
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> expected;
+    expected.initialize(points, params);
+    unibn::Octree<unibn::StridedPoint, unibn::StridedPoints> octree;
+    octree.initialize(view, params);
+
+    std::vector<uint32_t> resultIndices, expectedIndices;
+    std::vector<float> distances, expectedDistances;
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      const unibn::StridedPoint query(queries[q].x, queries[q].y, queries[q].z);
+      octree.radiusNeighbors(query, 0.3f, resultIndices, distances);
+      expected.radiusNeighbors(queries[q], 0.3f, expectedIndices, expectedDistances);
+      ASSERT_EQ(expectedIndices, resultIndices);
+      ASSERT_EQ(expectedDistances, distances);
+
+      octree.knnNeighbors(query, 5, resultIndices, distances);
+      expected.knnNeighbors(queries[q], 5, expectedIndices, expectedDistances);
+      ASSERT_EQ(expectedIndices, resultIndices);
+
+      ASSERT_EQ(expected.findNeighbor<unibn::L2Distance<Point3f> >(queries[q]),
+                octree.findNeighbor<unibn::L2Distance<unibn::StridedPoint> >(query));
+    }
+  }
+}
+
 TEST_F(OctreeTest, FindNeighbor)
 {
   // compare with bruteforce search.
@@ -401,15 +827,276 @@ TEST_F(OctreeTest, FindNeighbor)
     // allow self-match
     ASSERT_EQ(index, bruteforce.findNeighbor<unibn::L2Distance<Point3f> >(query));
     ASSERT_EQ(bruteforce.findNeighbor<unibn::L2Distance<Point3f> >(query),
-              octree.findNeighbor<unibn::L2Distance<Point3f> >(query));
+              octree.findNeighbor(query));
 
     // disallow self-match
     uint32_t bfneighbor = bruteforce.findNeighbor<unibn::L2Distance<Point3f> >(query, 0.0f);
-    uint32_t octneighbor = octree.findNeighbor<unibn::L2Distance<Point3f> >(query, 0.0f);
+    uint32_t octneighbor = octree.findNeighbor(query, 0.0f);
+    ASSERT_NE(index, bfneighbor);
+    ASSERT_EQ(bfneighbor, octneighbor);
 
     ASSERT_EQ(bruteforce.findNeighbor<unibn::L2Distance<Point3f> >(query, 0.3f),
-              octree.findNeighbor<unibn::L2Distance<Point3f> >(query, 0.3f));
+              octree.findNeighbor(query, 0.3f));
+  }
+}
+
+TEST_F(OctreeTest, FindNeighbors)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 5000, 1337);
+  randomPoints(queries, 1500, 4321);
+  // duplicates of points and queries far away from all points.
+  for (uint32_t i = 0; i < 50; ++i) queries.push_back(points[13 * i]);
+  queries.push_back(Point3f(50.0f, -50.0f, 20.0f));
+  const uint32_t M = queries.size();
+
+  for (uint32_t run = 0; run < 4; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run & 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+    const float minDistance = (run & 2) ? 0.01f : -1.0f;
+
+    std::vector<int32_t> resultIndices(M);
+    std::vector<float> sqrDistances(M);
+    octree.findNeighbors(queries, &resultIndices[0], &sqrDistances[0], minDistance);
+    for (uint32_t q = 0; q < M; ++q)
+    {
+      // ties may be resolved differently, but the distances are equal.
+      const int32_t expected = octree.findNeighbor<unibn::L2Distance<Point3f> >(queries[q], minDistance);
+      ASSERT_GE(resultIndices[q], 0);
+      ASSERT_EQ(unibn::L2Distance<Point3f>::compute(queries[q], points[expected]), sqrDistances[q]);
+      ASSERT_EQ(unibn::L2Distance<Point3f>::compute(queries[q], points[resultIndices[q]]), sqrDistances[q]);
+    }
+
+    octree.findNeighbors<unibn::L1Distance<Point3f> >(queries, &resultIndices[0], 0, minDistance);
+    for (uint32_t q = 0; q < M; ++q)
+    {
+      const int32_t expected = octree.findNeighbor<unibn::L1Distance<Point3f> >(queries[q], minDistance);
+      ASSERT_EQ(unibn::L1Distance<Point3f>::compute(queries[q], points[expected]),
+                unibn::L1Distance<Point3f>::compute(queries[q], points[resultIndices[q]]));
+    }
+  }
+
+  unibn::Octree<Point3f> empty;
+  std::vector<int32_t> resultIndices(M);
+  std::vector<float> sqrDistances(M);
+  empty.findNeighbors(queries, &resultIndices[0], &sqrDistances[0]);
+  ASSERT_EQ(-1, resultIndices[0]);
+  ASSERT_EQ(std::numeric_limits<float>::infinity(), sqrDistances[0]);
+}
+
+TEST_F(OctreeTest, KnnNeighbors)
+{
+  // compare with bruteforce search.
+  uint32_t N = 1000;
+
+  boost::mt11213b mtwister(1234);
+  boost::uniform_int<> uni_dist(0, N - 1);
+
+  std::vector<Point3f> points;
+  randomPoints(points, N, 1234);
+
+  NaiveNeighborSearch<Point3f> bruteforce;
+  bruteforce.initialize(points);
+  unibn::OctreeParams params;
+  params.bucketSize = 16;
+  unibn::Octree<Point3f> octree;
+  octree.initialize(points, params);
+
+  uint32_t ks[4] = {1, 5, 32, 100};
+
+  for (uint32_t j = 0; j < 4; ++j)
+  {
+    for (uint32_t i = 0; i < 10; ++i)
+    {
+      const Point3f& query = points[uni_dist(mtwister)];
+      std::vector<uint32_t> indicesBruteforce, indicesOctree;
+      std::vector<float> distancesBruteforce, distancesOctree;
+
+      // allow self-match
+      bruteforce.knnNeighbors<unibn::L2Distance<Point3f> >(query, ks[j], indicesBruteforce, distancesBruteforce);
+      octree.knnNeighbors(query, ks[j], indicesOctree, distancesOctree);
+      ASSERT_EQ(indicesBruteforce, indicesOctree);
+      ASSERT_EQ(distancesBruteforce, distancesOctree);
+
+      // disallow self-match
+      bruteforce.knnNeighbors<unibn::L2Distance<Point3f> >(query, ks[j], indicesBruteforce, distancesBruteforce, 0.0f);
+      octree.knnNeighbors(query, ks[j], indicesOctree, distancesOctree, 0.0f);
+      ASSERT_EQ(indicesBruteforce, indicesOctree);
+      ASSERT_EQ(distancesBruteforce, distancesOctree);
+    }
+  }
+
+  // the nearest neighbor must be consistent with findNeighbor.
+  std::vector<uint32_t> indices;
+  std::vector<float> distances;
+  octree.knnNeighbors(points[17], 1, indices, distances, 0.3f);
+  ASSERT_EQ(1, indices.size());
+  ASSERT_EQ(octree.findNeighbor(points[17], 0.3f), int32_t(indices[0]));
+
+  // less points than k.
+  octree.knnNeighbors(points[0], N + 10, indices, distances);
+  ASSERT_EQ(N, indices.size());
+  ASSERT_TRUE(std::is_sorted(distances.begin(), distances.end()));
+}
+
+TEST_F(OctreeTest, RadiusKnn)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 5000, 1234);
+  randomPoints(queries, 100, 4321);
+  queries.push_back(Point3f(100.0f, 100.0f, 100.0f));
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    std::vector<uint32_t> indices, expected;
+    std::vector<float> distances, expectedDistances;
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      for (float radius : {0.05f, 0.2f, 1.0f})
+      {
+        for (uint32_t k : {1u, 10u, 100u})
+        {
+          // the k nearest of all radius neighbors.
+          octree.radiusNeighbors<unibn::L2Distance<Point3f> >(queries[q], radius, expected, expectedDistances);
+          std::vector<float> sorted = expectedDistances;
+          std::sort(sorted.begin(), sorted.end());
+          sorted.resize(std::min<size_t>(k, sorted.size()));
+
+          octree.radiusKnn(queries[q], radius, k, indices, distances);
+          ASSERT_EQ(sorted.size(), indices.size());
+          ASSERT_EQ(sorted, distances);
+          for (uint32_t i = 0; i < indices.size(); ++i)
+          {
+            ASSERT_FLOAT_EQ(distances[i], unibn::L2Distance<Point3f>::compute(queries[q], points[indices[i]]));
+          }
+
+          // same as knnNeighbors, if more than k radius neighbors exist.
+          if (expected.size() > k)
+          {
+            std::vector<uint32_t> knnIndices;
+            std::vector<float> knnDistances;
+            octree.knnNeighbors(queries[q], k, knnIndices, knnDistances);
+            ASSERT_EQ(knnDistances, distances);
+          }
+        }
+      }
+    }
+
+    // disallow self-match.
+    octree.radiusKnn(points[17], 0.3f, 5, indices, distances, 0.0f);
+    for (uint32_t i = 0; i < indices.size(); ++i) ASSERT_NE(17, indices[i]);
+    octree.radiusKnn(points[17], 0.0f, 5, indices, distances);
+    ASSERT_EQ(0, indices.size());
+  }
+}
+
+TEST_F(OctreeTest, ApproximateNeighbors)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 5000, 1234);
+  randomPoints(queries, 200, 4321);
+
+  NaiveNeighborSearch<Point3f> bruteforce;
+  bruteforce.initialize(points);
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    uint32_t numInexact = 0;
+    std::vector<uint32_t> indices, indicesExact;
+    std::vector<float> distances, distancesExact;
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      const Point3f& query = queries[q];
+      bool exact = false;
+
+      // without relaxation and budget, the results are exact.
+      ASSERT_EQ(octree.findNeighbor(query), octree.findNeighbor(query, unibn::ApproximateParams(), exact));
+      ASSERT_TRUE(exact);
+      bruteforce.knnNeighbors<unibn::L2Distance<Point3f> >(query, 10, indicesExact, distancesExact);
+      octree.knnNeighbors(query, 10, indices, distances, unibn::ApproximateParams(), exact);
+      ASSERT_TRUE(exact);
+      ASSERT_EQ(indicesExact, indices);
+
+      // the relaxed neighbors are at most (1 + epsilon) farther away.
+      const float epsilon = 0.5f;
+      int32_t nearest = octree.findNeighbor(query, unibn::ApproximateParams(epsilon), exact);
+      ASSERT_LE(0, nearest);
+      const float exactDistance = std::sqrt(distancesExact[0]);
+      const float distance = std::sqrt(unibn::L2Distance<Point3f>::compute(query, points[nearest]));
+      ASSERT_LE(distance, (1.0f + epsilon) * exactDistance + 1e-5f);
+      if (exact) ASSERT_EQ(exactDistance, distance);
+
+      octree.knnNeighbors(query, 10, indices, distances, unibn::ApproximateParams(epsilon), exact);
+      ASSERT_EQ(10, indices.size());
+      for (uint32_t i = 0; i < 10; ++i)
+        ASSERT_LE(std::sqrt(distances[i]), (1.0f + epsilon) * std::sqrt(distancesExact[i]) + 1e-5f);
+      if (exact) ASSERT_EQ(distancesExact, distances);
+      if (!exact) numInexact += 1;
+
+      // a budget of a single leaf reports the neighbors inside the leaf of the query.
+      octree.knnNeighbors(query, 10, indices, distances, unibn::ApproximateParams(0.0f, 1), exact);
+      ASSERT_GE(16u, indices.size());
+      if (exact) ASSERT_EQ(indicesExact, indices);
+
+      // no budget at all.
+      ASSERT_EQ(-1, octree.findNeighbor(query, unibn::ApproximateParams(0.0f, 100, 0), exact));
+      ASSERT_FALSE(exact);
+    }
+    ASSERT_LT(0u, numInexact);
+  }
+}
+
+TEST_F(OctreeTest, KnnNeighborsBatch)
+{
+  uint32_t N = 1000;
+  const uint32_t k = 10;
+
+  std::vector<Point3f> points, queries;
+  randomPoints(points, N, 1234);
+  randomPoints(queries, 100, 4321);
+  // a query far away from all points.
+  queries.push_back(Point3f(100.0f, 100.0f, 100.0f));
+
+  unibn::Octree<Point3f> octree;
+  octree.initialize(points);
+
+  std::vector<uint32_t> batchIndices(queries.size() * k);
+  std::vector<float> batchDistances(queries.size() * k);
+  octree.knnNeighbors(queries, k, &batchIndices[0], &batchDistances[0]);
+
+  std::vector<uint32_t> indices;
+  std::vector<float> distances;
+  for (uint32_t q = 0; q < queries.size(); ++q)
+  {
+    octree.knnNeighbors(queries[q], k, indices, distances);
+    ASSERT_EQ(k, indices.size());
+    for (uint32_t i = 0; i < k; ++i)
+    {
+      ASSERT_EQ(indices[i], batchIndices[q * k + i]);
+      ASSERT_EQ(distances[i], batchDistances[q * k + i]);
+    }
   }
+
+  // distances are optional and unused slots are marked as invalid.
+  std::vector<uint32_t> largeIndices(2 * N);
+  octree.knnNeighbors(std::vector<Point3f>(1, points[0]), 2 * N, &largeIndices[0], 0);
+  for (uint32_t i = N; i < 2 * N; ++i) ASSERT_EQ(std::numeric_limits<uint32_t>::max(), largeIndices[i]);
 }
 
 template <typename T>
@@ -485,6 +1172,1621 @@ TEST_F(OctreeTest, RadiusNeighbors)
   }
 }
 
+// user-supplied distance policy, i.e., the cubed L3 norm.
+struct L3Distance
+{
+  static float compute(const Point3f& p, const Point3f& q)
+  {
+    return norm(p.x - q.x, p.y - q.y, p.z - q.z);
+  }
+
+  static float norm(float x, float y, float z)
+  {
+    return std::abs(x * x * x) + std::abs(y * y * y) + std::abs(z * z * z);
+  }
+
+  static float sqr(float r)
+  {
+    return r * r * r;
+  }
+
+  static float sqrt(float r)
+  {
+    return std::pow(r, 1.0f / 3.0f);
+  }
+};
+
+template <typename Distance>
+void checkDistance(const unibn::Octree<Point3f>& octree, const std::vector<Point3f>& points, const Point3f& query)
+{
+  NaiveNeighborSearch<Point3f> bruteforce;
+  bruteforce.initialize(points);
+
+  std::vector<uint32_t> expected, neighbors;
+  std::vector<float> expectedDistances, distances;
+  bruteforce.radiusNeighbors<Distance>(query, 0.9f, expected);
+  octree.radiusNeighbors<Distance>(query, 0.9f, neighbors, distances);
+  ASSERT_TRUE(similarVectors(expected, neighbors));
+  for (uint32_t i = 0; i < neighbors.size(); ++i)
+    ASSERT_NEAR(Distance::compute(query, points[neighbors[i]]), distances[i], 1e-4);
+
+  uint32_t count = 0;
+  octree.radiusNeighbors<Distance>(query, 0.9f, [&count](uint32_t, float) { return ++count > 0; });
+  ASSERT_EQ(expected.size(), count);
+
+  ASSERT_EQ(bruteforce.findNeighbor<Distance>(query), octree.findNeighbor<Distance>(query));
+  ASSERT_EQ(bruteforce.findNeighbor<Distance>(query, 0.3f), octree.findNeighbor<Distance>(query, 0.3f));
+
+  bruteforce.knnNeighbors<Distance>(query, 10, expected, expectedDistances, 0.0f);
+  octree.knnNeighbors<Distance>(query, 10, neighbors, distances, 0.0f);
+  ASSERT_EQ(expected, neighbors);
+}
+
+TEST_F(OctreeTest, DistancePolicies)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 2000, 1234);
+  randomPoints(queries, 20, 4321);
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      checkDistance<unibn::L1Distance<Point3f> >(octree, points, queries[q]);
+      checkDistance<unibn::L2Distance<Point3f> >(octree, points, queries[q]);
+      checkDistance<unibn::MaxDistance<Point3f> >(octree, points, queries[q]);
+      checkDistance<L3Distance>(octree, points, queries[q]);
+    }
+
+    // the partition and the batched queries use the same policies.
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> neighbors, expected;
+    octree.radiusNeighborsBatch<unibn::MaxDistance<Point3f> >(queries, 0.9f, offsets, neighbors);
+    unibn::OctreePartition<Point3f> partition = octree.partition(1);
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      octree.radiusNeighbors<unibn::MaxDistance<Point3f> >(queries[q], 0.9f, expected);
+      std::vector<uint32_t> batch(neighbors.begin() + offsets[q], neighbors.begin() + offsets[q + 1]);
+      ASSERT_TRUE(similarVectors(expected, batch));
+
+      for (uint32_t p = 0; p < partition.size(); ++p)
+      {
+        if (!partition.radiusNeighbors<unibn::MaxDistance<Point3f> >(p, queries[q], 0.9f, batch)) continue;
+        ASSERT_TRUE(similarVectors(expected, batch));
+      }
+    }
+  }
+}
+
+TEST_F(OctreeTest, RadiusNeighborsVisitor)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 5000, 1234);
+  randomPoints(queries, 100, 4321);
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    std::vector<uint32_t> expected, neighbors;
+    std::vector<float> expectedDistances;
+    std::vector<uint32_t> buffer(20);
+    std::vector<float> sqrDistances(20);
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      octree.radiusNeighbors(queries[q], 1.0f, expected, expectedDistances);
+
+      // the visitor sees all neighbors with their squared distances.
+      neighbors.clear();
+      float sum = 0.0f;
+      ASSERT_TRUE(octree.radiusNeighbors(queries[q], 1.0f, [&](uint32_t idx, float sqrDistance) {
+        neighbors.push_back(idx);
+        sum += sqrDistance - unibn::L2Distance<Point3f>::compute(queries[q], points[idx]);
+        return true;
+      }));
+      ASSERT_TRUE(similarVectors(expected, neighbors));
+      ASSERT_NEAR(0.0f, sum, 1e-3);
+
+      // early exit after the first three neighbors.
+      uint32_t count = 0;
+      bool finished = octree.radiusNeighbors(queries[q], 1.0f, [&count](uint32_t, float) { return ++count < 3; });
+      ASSERT_EQ(expected.size() < 3, finished);
+      ASSERT_EQ(std::min<uint32_t>(3, expected.size()), count);
+
+      // fixed capacity, which reports truncation.
+      bool truncated = true;
+      uint32_t n = octree.radiusNeighbors(queries[q], 1.0f, &buffer[0], &sqrDistances[0], buffer.size(), truncated);
+      ASSERT_EQ(expected.size() > buffer.size(), truncated);
+      ASSERT_EQ(std::min<uint32_t>(buffer.size(), expected.size()), n);
+      for (uint32_t i = 0; i < n; ++i)
+      {
+        ASSERT_NE(expected.end(), std::find(expected.begin(), expected.end(), buffer[i]));
+        ASSERT_NEAR(unibn::L2Distance<Point3f>::compute(queries[q], points[buffer[i]]), sqrDistances[i], 1e-4);
+      }
+      n = octree.radiusNeighbors(queries[q], 1.0f, &buffer[0], 0, 0, truncated);
+      ASSERT_EQ(0, n);
+      ASSERT_EQ(!expected.empty(), truncated);
+    }
+  }
+
+  unibn::Octree<Point3f> empty;
+  bool truncated = true;
+  ASSERT_TRUE(empty.radiusNeighbors(queries[0], 1.0f, [](uint32_t, float) { return false; }));
+  ASSERT_EQ(0, empty.radiusNeighbors(queries[0], 1.0f, 0, 0, 0, truncated));
+  ASSERT_FALSE(truncated);
+}
+
+struct JoinCounter
+{
+  JoinCounter(uint64_t maxPairs = std::numeric_limits<uint64_t>::max()) : numPairs(0), numRanges(0), maxPairs(maxPairs)
+  {
+  }
+
+  bool operator()(uint32_t, uint32_t, float)
+  {
+    numPairs += 1;
+    return numPairs < maxPairs;
+  }
+
+  bool operator()(const uint32_t*, uint32_t size, const uint32_t*, uint32_t otherSize)
+  {
+    numPairs += uint64_t(size) * otherSize;
+    numRanges += 1;
+    return numPairs < maxPairs;
+  }
+
+  uint64_t numPairs, numRanges, maxPairs;
+};
+
+TEST_F(OctreeTest, RadiusJoin)
+{
+  std::vector<Point3f> points, others;
+  randomPoints(points, 3000, 1234);
+  randomPoints(others, 2000, 4321);
+
+  unibn::OctreeParams params;
+  params.bucketSize = 16;
+  unibn::Octree<Point3f> octree, otherOctree;
+  octree.initialize(points, params);
+  params.reorderPoints = true;
+  otherOctree.initialize(others, params);
+
+  const float radii[3] = {0.2f, 0.5f, 4.0f};
+  for (uint32_t r = 0; r < 3; ++r)
+  {
+    const float radius = radii[r];
+
+    // bruteforce: radius query of every other point.
+    NaiveNeighborSearch<Point3f> bruteforce;
+    bruteforce.initialize(points);
+    std::vector<std::pair<uint32_t, uint32_t> > expected, pairs;
+    std::vector<uint32_t> neighbors;
+    for (uint32_t j = 0; j < others.size(); ++j)
+    {
+      bruteforce.radiusNeighbors<unibn::L2Distance<Point3f> >(others[j], radius, neighbors);
+      for (uint32_t i = 0; i < neighbors.size(); ++i) expected.push_back(std::make_pair(neighbors[i], j));
+    }
+    std::sort(expected.begin(), expected.end());
+
+    octree.radiusJoin(otherOctree, radius, pairs);
+    std::sort(pairs.begin(), pairs.end());
+    ASSERT_EQ(expected, pairs);
+
+    JoinCounter counter;
+    ASSERT_TRUE(octree.radiusJoin(otherOctree, radius, counter));
+    ASSERT_EQ(expected.size(), counter.numPairs);
+    if (r == 2) ASSERT_LT(0u, counter.numRanges);
+
+    // swapped roles.
+    otherOctree.radiusJoin(octree, radius, pairs);
+    ASSERT_EQ(expected.size(), pairs.size());
+
+    // self-join reports all pairs in both orders and all points with themselves.
+    octree.radiusJoin(octree, radius, pairs);
+    uint64_t numSelfPairs = 0;
+    for (uint32_t i = 0; i < points.size(); ++i)
+    {
+      bruteforce.radiusNeighbors<unibn::L2Distance<Point3f> >(points[i], radius, neighbors);
+      numSelfPairs += neighbors.size();
+    }
+    ASSERT_EQ(numSelfPairs, pairs.size());
+
+    // other norms.
+    octree.radiusJoin<unibn::MaxDistance<Point3f> >(otherOctree, radius, pairs);
+    uint64_t numMaxPairs = 0;
+    for (uint32_t j = 0; j < others.size(); ++j)
+    {
+      bruteforce.radiusNeighbors<unibn::MaxDistance<Point3f> >(others[j], radius, neighbors);
+      numMaxPairs += neighbors.size();
+    }
+    ASSERT_EQ(numMaxPairs, pairs.size());
+  }
+
+  // stopping visitor.
+  JoinCounter counter(10);
+  ASSERT_FALSE(octree.radiusJoin(otherOctree, 0.5f, counter));
+  ASSERT_LE(10u, counter.numPairs);
+
+  // empty octree.
+  unibn::Octree<Point3f> empty;
+  std::vector<std::pair<uint32_t, uint32_t> > pairs(1);
+  octree.radiusJoin(empty, 1.0f, pairs);
+  ASSERT_EQ(0u, pairs.size());
+}
+
+TEST_F(OctreeTest, RadiusNeighborsBatch)
+{
+  uint32_t N = 2000;
+
+  std::vector<Point3f> points, queries;
+  randomPoints(points, N, 1234);
+  randomPoints(queries, 500, 4321);
+  // a query far away from all points.
+  queries.push_back(Point3f(100.0f, 100.0f, 100.0f));
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> resultIndices;
+    std::vector<float> distances;
+    octree.radiusNeighborsBatch(queries, 1.0f, offsets, resultIndices);
+    ASSERT_EQ(queries.size() + 1, offsets.size());
+    ASSERT_EQ(resultIndices.size(), offsets.back());
+
+    std::vector<uint32_t> expected;
+    std::vector<float> expectedDistances;
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      octree.radiusNeighbors(queries[q], 1.0f, expected);
+      std::vector<uint32_t> neighbors(resultIndices.begin() + offsets[q], resultIndices.begin() + offsets[q + 1]);
+      ASSERT_EQ(expected, neighbors);
+    }
+
+    octree.radiusNeighborsBatch(queries, 1.0f, offsets, resultIndices, distances);
+    ASSERT_EQ(resultIndices.size(), distances.size());
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      octree.radiusNeighbors(queries[q], 1.0f, expected, expectedDistances);
+      ASSERT_EQ(expected.size(), offsets[q + 1] - offsets[q]);
+      for (uint32_t i = 0; i < expected.size(); ++i)
+      {
+        ASSERT_EQ(expected[i], resultIndices[offsets[q] + i]);
+        ASSERT_EQ(expectedDistances[i], distances[offsets[q] + i]);
+      }
+    }
+    ASSERT_EQ(offsets[queries.size() - 1], offsets[queries.size()]);
+
+    octree.radiusNeighborsBatch(std::vector<Point3f>(), 1.0f, offsets, resultIndices);
+    ASSERT_EQ(1, offsets.size());
+    ASSERT_EQ(0, resultIndices.size());
+  }
+}
+
+TEST_F(OctreeTest, Partition)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 2000, 1234);
+  // a few isolated points, which end up in leafs above the partition depth.
+  points.push_back(Point3f(20.0f, 20.0f, 20.0f));
+  points.push_back(Point3f(-20.0f, 20.0f, -20.0f));
+  points.push_back(Point3f(20.0f, -20.0f, 20.0f));
+  randomPoints(queries, 200, 4321);
+  uint32_t N = points.size();
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    unibn::OctreePartition<Point3f> partition = octree.partition(4);
+    ASSERT_EQ(4, partition.depth());
+    ASSERT_GT(partition.size(), 8);
+
+    // every point belongs to exactly one part.
+    std::vector<uint32_t> count(N, 0), part(N, 0), indices;
+    for (uint32_t p = 0; p < partition.size(); ++p)
+    {
+      partition.indices(p, indices);
+      ASSERT_EQ(partition.pointCount(p), indices.size());
+      for (uint32_t i = 0; i < indices.size(); ++i)
+      {
+        count[indices[i]] += 1;
+        part[indices[i]] = p;
+      }
+    }
+    for (uint32_t i = 0; i < N; ++i) ASSERT_EQ(1, count[i]);
+
+    // the legacy interface uses the same partition.
+    std::vector<std::vector<uint32_t>> indicesList;
+    ASSERT_TRUE(octree.getOctantIndicesAtSpecifiedDepth(4, indicesList));
+    ASSERT_EQ(partition.size(), indicesList.size());
+    for (uint32_t p = 0; p < partition.size(); ++p)
+    {
+      partition.indices(p, indices);
+      ASSERT_EQ(indices, indicesList[p]);
+    }
+    // flat indices with offsets and the visitor report the same parts.
+    std::vector<uint32_t> flatIndices, offsets;
+    ASSERT_TRUE(octree.getOctantIndicesAtSpecifiedDepth(4, flatIndices, offsets));
+    ASSERT_EQ(partition.size() + 1, offsets.size());
+    ASSERT_EQ(N, flatIndices.size());
+    for (uint32_t p = 0; p < partition.size(); ++p)
+    {
+      std::vector<uint32_t> slice(flatIndices.begin() + offsets[p], flatIndices.begin() + offsets[p + 1]);
+      ASSERT_EQ(indicesList[p], slice);
+    }
+
+    std::vector<std::vector<uint32_t>> visited(partition.size());
+    std::vector<uint32_t> visits(partition.size(), 0);
+    uint32_t numVisited = octree.visitOctantsAtSpecifiedDepth(4, [&](uint32_t p, const uint32_t* idx, uint32_t count) {
+      // parts are disjoint; thus, every task writes different elements.
+      visited[p].assign(idx, idx + count);
+      visits[p] += 1;
+    });
+    ASSERT_EQ(partition.size(), numVisited);
+    for (uint32_t p = 0; p < partition.size(); ++p)
+    {
+      ASSERT_EQ(1, visits[p]);
+      ASSERT_EQ(indicesList[p], visited[p]);
+    }
+
+    ASSERT_FALSE(octree.getOctantIndicesAtSpecifiedDepth(0, indicesList));
+    ASSERT_FALSE(octree.getOctantIndicesAtSpecifiedDepth(0, flatIndices, offsets));
+    ASSERT_EQ(0, flatIndices.size());
+    ASSERT_EQ(0, octree.visitOctantsAtSpecifiedDepth(0, [&](uint32_t, const uint32_t*, uint32_t) { FAIL(); }));
+
+    uint32_t limited = 0;
+    std::vector<uint32_t> expected, neighbors;
+    std::vector<float> distances;
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      const float radius = 0.1f + 0.01f * (q % 50);
+      octree.radiusNeighbors(queries[q], radius, expected);
+      std::sort(expected.begin(), expected.end());
+      for (uint32_t p = 0; p < partition.size(); ++p)
+      {
+        if (!partition.radiusNeighbors(p, queries[q], radius, neighbors, distances))
+        {
+          ASSERT_EQ(0, neighbors.size());
+          continue;
+        }
+        ++limited;
+        ASSERT_EQ(neighbors.size(), distances.size());
+        std::sort(neighbors.begin(), neighbors.end());
+        ASSERT_EQ(expected, neighbors);
+        for (uint32_t i = 0; i < expected.size(); ++i) ASSERT_EQ(p, part[expected[i]]);
+      }
+    }
+    ASSERT_GT(limited, 0);
+    ASSERT_FALSE(partition.radiusNeighbors(partition.size(), queries[0], 0.1f, neighbors));
+  }
+}
+
+TEST_F(OctreeTest, InsertRemove)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 4000, 1234);
+  randomPoints(queries, 100, 4321);
+  // points far outside of the initial octree, which must grow the root.
+  for (uint32_t i = 0; i < 200; ++i)
+    points.push_back(Point3f(3.0f * points[i].x + 20.0f, 2.0f * points[i].y - 30.0f, points[i].z));
+
+  boost::mt11213b mtwister(1234);
+  boost::uniform_01<> gen;
+
+  for (uint32_t run = 0; run < 3; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    params.quantizePoints = (run == 2);
+    unibn::Octree<Point3f> octree;
+
+    // points are appended in chunks to a container, which reallocates.
+    std::vector<Point3f> current(points.begin(), points.begin() + 1000);
+    std::vector<bool> inserted(current.size(), true);
+    octree.initialize(current, params);
+
+    for (uint32_t iteration = 0; iteration < 8; ++iteration)
+    {
+      const uint32_t first = current.size();
+      const uint32_t last = std::min<uint32_t>(first + 400, points.size());
+      current.insert(current.end(), points.begin() + first, points.begin() + last);
+      inserted.resize(last, true);
+      octree.insert(current, first, last);
+      checkConsistency(octree, current, inserted, params.bucketSize);
+
+      std::vector<uint32_t> removals;
+      for (uint32_t i = 0; i < current.size(); ++i)
+      {
+        if (inserted[i] && gen(mtwister) < 0.2) removals.push_back(i);
+      }
+      // indexes, which are not in the octree, are ignored.
+      removals.push_back(removals.front());
+      ASSERT_EQ(removals.size() - 1, octree.remove(removals));
+      for (uint32_t i = 0; i < removals.size(); ++i) inserted[removals[i]] = false;
+      checkConsistency(octree, current, inserted, params.bucketSize);
+    }
+
+    // compare with bruteforce search on the remaining points.
+    std::vector<Point3f> remaining;
+    std::vector<uint32_t> remainingIndexes;
+    for (uint32_t i = 0; i < current.size(); ++i)
+    {
+      if (!inserted[i]) continue;
+      remaining.push_back(current[i]);
+      remainingIndexes.push_back(i);
+    }
+    NaiveNeighborSearch<Point3f> bruteforce;
+    bruteforce.initialize(remaining);
+
+    std::vector<uint32_t> expected, neighbors;
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      bruteforce.radiusNeighbors<unibn::L2Distance<Point3f> >(queries[q], 0.8f, expected);
+      for (uint32_t i = 0; i < expected.size(); ++i) expected[i] = remainingIndexes[expected[i]];
+      octree.radiusNeighbors(queries[q], 0.8f, neighbors);
+      std::sort(expected.begin(), expected.end());
+      std::sort(neighbors.begin(), neighbors.end());
+      ASSERT_EQ(expected, neighbors);
+
+      ASSERT_EQ(remainingIndexes[bruteforce.findNeighbor<unibn::L2Distance<Point3f> >(queries[q])], octree.findNeighbor(queries[q]));
+    }
+
+    // removing all points gives an empty octree, which can be filled again.
+    ASSERT_EQ(remainingIndexes.size(), octree.remove(remainingIndexes));
+    ASSERT_EQ(0, getRoot(octree));
+    ASSERT_EQ(-1, octree.findNeighbor(queries[0]));
+    std::fill(inserted.begin(), inserted.end(), false);
+    inserted.resize(current.size() + 10, true);
+    current.insert(current.end(), points.begin(), points.begin() + 10);
+    octree.insert(current, current.size() - 10, current.size());
+    checkConsistency(octree, current, inserted, params.bucketSize);
+
+    // non-finite points of the first batch of an empty octree are ignored like in later batches.
+    unibn::Octree<Point3f> fresh;
+    std::vector<Point3f> batch(points.begin(), points.begin() + 100);
+    std::vector<bool> valid(batch.size(), true);
+    batch[0].x = std::numeric_limits<float>::quiet_NaN();
+    batch[50].z = std::numeric_limits<float>::infinity();
+    valid[0] = valid[50] = false;
+    fresh.insert(batch, 0, batch.size());
+    ASSERT_TRUE(getRoot(fresh) != 0);
+    ASSERT_TRUE(std::isfinite(getRoot(fresh)->x) && std::isfinite(getRoot(fresh)->extent));
+    ASSERT_EQ(batch.size() - 2, getRoot(fresh)->size);
+    checkConsistency(fresh, batch, valid, unibn::OctreeParams().bucketSize);
+  }
+}
+
+TEST_F(OctreeTest, InsertRemoveBruteforce)
+{
+  // points on a grid lie on the splitting planes of the octants.
+  std::vector<Point3f> points, queries;
+  boost::mt11213b mtwister(4711);
+  boost::uniform_int<> cell(-16, 16);
+  boost::uniform_01<> gen;
+  for (uint32_t i = 0; i < 3000; ++i)
+  {
+    const float scale = (i < 1000) ? 0.0625f : 0.25f;  // later points grow the root in all directions.
+    points.push_back(Point3f(scale * cell(mtwister), scale * cell(mtwister), scale * cell(mtwister)));
+  }
+  randomPoints(queries, 50, 4321);
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 8;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+
+    std::vector<Point3f> current(points.begin(), points.begin() + 200);
+    std::vector<bool> inserted(current.size(), true);
+    octree.initialize(current, params);
+
+    for (uint32_t iteration = 0; iteration < 40; ++iteration)
+    {
+      if (gen(mtwister) < 0.6 && current.size() < points.size())
+      {
+        const uint32_t first = current.size();
+        const uint32_t last = std::min<uint32_t>(first + 1 + 100 * gen(mtwister), points.size());
+        current.insert(current.end(), points.begin() + first, points.begin() + last);
+        inserted.resize(last, true);
+        octree.insert(current, first, last);
+      }
+      else
+      {
+        std::vector<uint32_t> removals;
+        for (uint32_t i = 0; i < current.size(); ++i)
+        {
+          if (inserted[i] && gen(mtwister) < 0.3) removals.push_back(i);
+        }
+        ASSERT_EQ(removals.size(), octree.remove(removals));
+        for (uint32_t i = 0; i < removals.size(); ++i) inserted[removals[i]] = false;
+      }
+      if (getRoot(octree) == 0) continue;
+      checkConsistency(octree, current, inserted, params.bucketSize);
+
+      std::vector<Point3f> remaining;
+      std::vector<uint32_t> remainingIndexes;
+      for (uint32_t i = 0; i < current.size(); ++i)
+      {
+        if (!inserted[i]) continue;
+        remaining.push_back(current[i]);
+        remainingIndexes.push_back(i);
+      }
+      NaiveNeighborSearch<Point3f> bruteforce;
+      bruteforce.initialize(remaining);
+
+      std::vector<uint32_t> expected, neighbors;
+      for (uint32_t q = 0; q < queries.size(); ++q)
+      {
+        const Point3f& query = (q % 2 == 0) ? queries[q] : remaining[q % remaining.size()];
+        bruteforce.radiusNeighbors<unibn::L2Distance<Point3f> >(query, 0.3f, expected);
+        for (uint32_t i = 0; i < expected.size(); ++i) expected[i] = remainingIndexes[expected[i]];
+        octree.radiusNeighbors(query, 0.3f, neighbors);
+        std::sort(expected.begin(), expected.end());
+        std::sort(neighbors.begin(), neighbors.end());
+        ASSERT_EQ(expected, neighbors);
+      }
+    }
+  }
+}
+
+TEST_F(OctreeTest, Aggregate)
+{
+  std::vector<Point3f> points, sparse;
+  randomPoints(points, 3000, 1234);
+  // a sparse region, which ends up in leafs above the aggregated depth.
+  randomPoints(sparse, 40, 4321);
+  for (uint32_t i = 0; i < sparse.size(); ++i)
+    points.push_back(Point3f(4.0f * sparse[i].x + 30.0f, 4.0f * sparse[i].y + 30.0f, 4.0f * sparse[i].z + 30.0f));
+
+  // points on the splitting planes of the cells, which do not change the bounding box and therefore the root.
+  {
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points);
+    const Octant* root = getRoot(octree);
+    for (uint32_t i = 0; i < 64; ++i)
+    {
+      const float offset = root->extent * ((i % 2 == 0) ? 0.0f : 1.0f / (1 << (i % 7)));
+      points.push_back(Point3f(root->x + offset, root->y - offset, points[i].z));
+      points.push_back(Point3f(points[i].x, root->y + offset, root->z));
+    }
+  }
+  const uint32_t N = points.size();
+  const float factor[] = {-0.5f, 0.5f};
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 64;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+    const Octant* root = getRoot(octree);
+
+    for (int depth = 0; depth < 7; ++depth)
+    {
+      // bruteforce: group points by the cells of the octants at depth, where points on a splitting plane belong to the
+      // lower cell like in the construction.
+      std::map<uint64_t, std::vector<uint32_t> > cells;
+      std::vector<uint64_t> keys(N);
+      for (uint32_t i = 0; i < N; ++i)
+      {
+        const float coords[3] = {points[i].x, points[i].y, points[i].z};
+        float center[3] = {root->x, root->y, root->z};
+        float extent = root->extent;
+        uint64_t key = 0;
+        for (int l = 0; l < depth; ++l)
+        {
+          for (uint32_t d = 0; d < 3; ++d)
+          {
+            const uint32_t upper = (coords[d] > center[d]) ? 1 : 0;
+            key = (key << 1) | upper;
+            center[d] += factor[upper] * extent;
+          }
+          extent *= 0.5f;
+        }
+        keys[i] = key;
+        cells[keys[i]].push_back(i);
+      }
+
+      std::vector<unibn::OctantAggregate> aggregates;
+      octree.aggregate(depth, aggregates);
+      ASSERT_EQ(cells.size(), aggregates.size());
+
+      std::map<uint64_t, uint32_t> visited;
+      for (uint32_t a = 0; a < aggregates.size(); ++a)
+      {
+        const unibn::OctantAggregate& agg = aggregates[a];
+        const uint64_t key = keys[agg.first];
+        visited[key] += 1;
+        ASSERT_EQ(key, keys[agg.nearest]);
+
+        const std::vector<uint32_t>& members = cells[key];
+        ASSERT_EQ(members.size(), agg.size);
+        double sum[3] = {0.0, 0.0, 0.0};
+        for (uint32_t i = 0; i < members.size(); ++i)
+        {
+          sum[0] += points[members[i]].x;
+          sum[1] += points[members[i]].y;
+          sum[2] += points[members[i]].z;
+        }
+        ASSERT_NEAR(sum[0] / members.size(), agg.x, 1e-4);
+        ASSERT_NEAR(sum[1] / members.size(), agg.y, 1e-4);
+        ASSERT_NEAR(sum[2] / members.size(), agg.z, 1e-4);
+
+        Point3f centroid(agg.x, agg.y, agg.z);
+        float minDistance = std::numeric_limits<float>::infinity();
+        for (uint32_t i = 0; i < members.size(); ++i)
+          minDistance = std::min(minDistance, unibn::L2Distance<Point3f>::compute(centroid, points[members[i]]));
+        ASSERT_NEAR(minDistance, unibn::L2Distance<Point3f>::compute(centroid, points[agg.nearest]), 1e-5);
+      }
+      ASSERT_EQ(cells.size(), visited.size());
+    }
+
+    const float extent = 0.3f;
+    const int depth = octree.depthForExtent(extent);
+    ASSERT_LE(root->extent / (1 << depth), extent);
+    ASSERT_GT(root->extent / (1 << (depth - 1)), extent);
+
+    std::vector<unibn::OctantAggregate> aggregates;
+    std::vector<uint32_t> indices;
+    octree.aggregate(depth, aggregates);
+    octree.downsample(extent, indices);
+    ASSERT_EQ(aggregates.size(), indices.size());
+    for (uint32_t i = 0; i < indices.size(); ++i) ASSERT_EQ(aggregates[i].nearest, indices[i]);
+  }
+}
+
+TEST_F(OctreeTest, LevelOfDetail)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 5000, 1234);
+  const uint32_t N = points.size();
+  const Point3f viewpoint(0.9f, 0.9f, 0.9f);
+
+  std::vector<unibn::LodSample> samples;
+  unibn::Octree<Point3f> plain;
+  plain.initialize(points);
+  ASSERT_FALSE(plain.levelOfDetail(viewpoint, 0.1f, samples));
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.levelOfDetail = true;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    // without an error, all points are reported.
+    ASSERT_TRUE(octree.levelOfDetail(viewpoint, 0.0f, samples));
+    ASSERT_EQ(N, samples.size());
+    std::vector<uint32_t> count(N, 0);
+    for (uint32_t i = 0; i < samples.size(); ++i)
+    {
+      ASSERT_EQ(1, samples[i].size);
+      count[samples[i].index] += 1;
+      ASSERT_EQ(points[samples[i].index].x, samples[i].x);
+      ASSERT_EQ(points[samples[i].index].y, samples[i].y);
+      ASSERT_EQ(points[samples[i].index].z, samples[i].z);
+    }
+    for (uint32_t i = 0; i < N; ++i) ASSERT_EQ(1, count[i]);
+
+    // a large error is satisfied by the root, which is represented by the centroid of all points.
+    ASSERT_TRUE(octree.levelOfDetail(Point3f(100.0f, 0.0f, 0.0f), 1.0f, samples));
+    ASSERT_EQ(1, samples.size());
+    ASSERT_EQ(N, samples[0].size);
+    double sx = 0.0;
+    for (uint32_t i = 0; i < N; ++i) sx += points[i].x;
+    ASSERT_NEAR(sx / N, samples[0].x, 1e-4);
+
+    // every point is represented exactly once with decreasing number of samples for larger errors.
+    uint32_t previous = N;
+    for (float error : {0.1f, 0.2f, 0.5f})
+    {
+      ASSERT_TRUE(octree.levelOfDetail(viewpoint, error, samples));
+      uint32_t represented = 0, singles = 0;
+      float nearest = std::numeric_limits<float>::infinity(), farthest = 0.0f;
+      for (uint32_t i = 0; i < samples.size(); ++i)
+      {
+        represented += samples[i].size;
+        float dist = unibn::L2Distance<Point3f>::compute(viewpoint, Point3f(samples[i].x, samples[i].y, samples[i].z));
+        if (samples[i].size == 1)
+        {
+          singles += 1;
+          nearest = std::min(nearest, dist);
+        }
+        else
+        {
+          farthest = std::max(farthest, dist);
+        }
+      }
+      ASSERT_EQ(N, represented);
+      ASSERT_LE(samples.size(), previous);
+      // near leafs are refined, far octants are represented by their centroids.
+      ASSERT_GT(singles, 0);
+      ASSERT_LT(singles, samples.size());
+      ASSERT_LT(nearest, farthest);
+      previous = samples.size();
+    }
+
+    // the budget is never exceeded.
+    for (uint32_t budget : {1u, 7u, 100u, 1000u})
+    {
+      ASSERT_TRUE(octree.levelOfDetail(viewpoint, 0.0f, samples, budget));
+      ASSERT_GE(budget, samples.size());
+      uint32_t represented = 0;
+      for (uint32_t i = 0; i < samples.size(); ++i) represented += samples[i].size;
+      ASSERT_EQ(N, represented);
+    }
+    ASSERT_TRUE(octree.levelOfDetail(viewpoint, 0.0f, samples, 0));
+    ASSERT_EQ(0, samples.size());
+
+    // the centroids are saved and mapped with the octree.
+    const std::string filename = ::testing::TempDir() + "octree-lod.bin";
+    ASSERT_TRUE(octree.save(filename));
+    unibn::Octree<Point3f> mapped;
+    ASSERT_TRUE(mapped.openMapped(filename));
+    std::vector<unibn::LodSample> mappedSamples;
+    for (float error : {0.0f, 0.1f, 0.5f})
+    {
+      ASSERT_TRUE(octree.levelOfDetail(viewpoint, error, samples, 1000));
+      ASSERT_TRUE(mapped.levelOfDetail(viewpoint, error, mappedSamples, 1000));
+      ASSERT_EQ(samples.size(), mappedSamples.size());
+      for (uint32_t i = 0; i < samples.size(); ++i)
+      {
+        ASSERT_EQ(samples[i].x, mappedSamples[i].x);
+        ASSERT_EQ(samples[i].y, mappedSamples[i].y);
+        ASSERT_EQ(samples[i].z, mappedSamples[i].z);
+        ASSERT_EQ(samples[i].size, mappedSamples[i].size);
+        ASSERT_EQ(samples[i].index, mappedSamples[i].index);
+      }
+    }
+    {
+      // files of version 1 are still mapped, but have no centroids.
+      std::vector<char> contents;
+      {
+        std::ifstream in(filename.c_str(), std::ios::binary);
+        contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+      }
+      const uint32_t version = 1;
+      std::memcpy(&contents[8], &version, sizeof(uint32_t));
+      std::ofstream out(filename.c_str(), std::ios::binary);
+      out.write(&contents[0], contents.size());
+    }
+    ASSERT_TRUE(mapped.openMapped(filename));
+    ASSERT_EQ(N, getRoot(mapped)->size);
+    ASSERT_FALSE(mapped.levelOfDetail(viewpoint, 0.1f, samples));
+    ASSERT_TRUE(plain.save(filename));
+    ASSERT_TRUE(mapped.openMapped(filename));
+    ASSERT_FALSE(mapped.levelOfDetail(viewpoint, 0.1f, samples));
+    std::remove(filename.c_str());
+
+    // centroids are updated by insertion and removal.
+    std::vector<uint32_t> removals;
+    for (uint32_t i = 0; i < N; i += 2) removals.push_back(i);
+    ASSERT_EQ(removals.size(), octree.remove(removals));
+    ASSERT_TRUE(octree.levelOfDetail(Point3f(100.0f, 0.0f, 0.0f), 1.0f, samples));
+    ASSERT_EQ(1, samples.size());
+    ASSERT_EQ(N - removals.size(), samples[0].size);
+  }
+}
+
+TEST_F(OctreeTest, BoxConvexSearch)
+{
+  std::vector<Point3f> points, boxes;
+  randomPoints(points, 5000, 1234);
+  randomPoints(boxes, 40, 4321);
+  const uint32_t N = points.size();
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    std::vector<uint32_t> result, expected;
+    for (uint32_t b = 0; b + 1 < boxes.size(); b += 2)
+    {
+      Point3f min(std::min(boxes[b].x, boxes[b + 1].x), std::min(boxes[b].y, boxes[b + 1].y),
+                  std::min(boxes[b].z, boxes[b + 1].z));
+      Point3f max(std::max(boxes[b].x, boxes[b + 1].x), std::max(boxes[b].y, boxes[b + 1].y),
+                  std::max(boxes[b].z, boxes[b + 1].z));
+
+      expected.clear();
+      for (uint32_t i = 0; i < N; ++i)
+      {
+        const Point3f& p = points[i];
+        if (p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z && p.z <= max.z)
+          expected.push_back(i);
+      }
+
+      octree.boxSearch(min, max, result);
+      std::sort(result.begin(), result.end());
+      ASSERT_EQ(expected, result);
+
+      // the same box as six half-spaces.
+      std::vector<unibn::Halfspace> halfspaces;
+      unibn::Halfspace faces[6] = {{1, 0, 0, max.x},  {-1, 0, 0, -min.x}, {0, 1, 0, max.y},
+                                   {0, -1, 0, -min.y}, {0, 0, 1, max.z},  {0, 0, -1, -min.z}};
+      halfspaces.assign(faces, faces + 6);
+      ASSERT_TRUE(octree.convexSearch(halfspaces, result));
+      std::sort(result.begin(), result.end());
+      ASSERT_EQ(expected, result);
+
+      // a rotated box of the same size around the same center.
+      const float angle = 0.1f * b;
+      const float c = std::cos(angle), s = std::sin(angle);
+      const float axes[3][3] = {{c, s, 0}, {-s * c, c * c, s}, {s * s, -c * s, c}};
+      const float center[3] = {0.5f * (min.x + max.x), 0.5f * (min.y + max.y), 0.5f * (min.z + max.z)};
+      const float extents[3] = {0.5f * (max.x - min.x), 0.5f * (max.y - min.y), 0.5f * (max.z - min.z)};
+      halfspaces.clear();
+      for (uint32_t a = 0; a < 3; ++a)
+      {
+        const float d = axes[a][0] * center[0] + axes[a][1] * center[1] + axes[a][2] * center[2];
+        unibn::Halfspace upper = {axes[a][0], axes[a][1], axes[a][2], d + extents[a]};
+        unibn::Halfspace lower = {-axes[a][0], -axes[a][1], -axes[a][2], -d + extents[a]};
+        halfspaces.push_back(upper);
+        halfspaces.push_back(lower);
+      }
+
+      expected.clear();
+      for (uint32_t i = 0; i < N; ++i)
+      {
+        bool inside = true;
+        for (uint32_t h = 0; h < halfspaces.size(); ++h)
+        {
+          const unibn::Halfspace& hs = halfspaces[h];
+          if (hs.nx * points[i].x + hs.ny * points[i].y + hs.nz * points[i].z > hs.d) inside = false;
+        }
+        if (inside) expected.push_back(i);
+      }
+
+      ASSERT_TRUE(octree.convexSearch(halfspaces, result));
+      std::sort(result.begin(), result.end());
+      ASSERT_EQ(expected, result);
+    }
+
+    // empty box.
+    octree.boxSearch(Point3f(1, 1, 1), Point3f(-1, -1, -1), result);
+    ASSERT_EQ(0u, result.size());
+
+    // no half-spaces: all points.
+    ASSERT_TRUE(octree.convexSearch(std::vector<unibn::Halfspace>(), result));
+    ASSERT_EQ(N, result.size());
+
+    std::vector<unibn::Halfspace> tooMany(33, unibn::Halfspace());
+    result.push_back(0);
+    ASSERT_FALSE(octree.convexSearch(tooMany, result));
+    ASSERT_EQ(0u, result.size());
+  }
+}
+
+TEST_F(OctreeTest, RayCast)
+{
+  std::vector<Point3f> points, directions;
+  randomPoints(points, 5000, 1234);
+  randomPoints(directions, 200, 4321);
+  // axis-parallel rays.
+  directions.push_back(Point3f(1, 0, 0));
+  directions.push_back(Point3f(0, -1, 0));
+  directions.push_back(Point3f(0, 0, 1));
+  const uint32_t N = points.size();
+  const Point3f origin(-6.0f, 0.5f, -0.25f);
+  const float radius = 0.3f;
+  const float maxDistance = 12.0f;
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    std::vector<uint32_t> hitIndices(directions.size());
+    std::vector<float> hitDistances(directions.size());
+    octree.rayCast(origin, directions, radius, &hitIndices[0], &hitDistances[0], maxDistance);
+
+    uint32_t numHits = 0;
+    std::vector<uint32_t> indices;
+    std::vector<float> distances;
+    for (uint32_t r = 0; r < directions.size(); ++r)
+    {
+      const Point3f& d = directions[r];
+      const float length = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+      const float dir[3] = {d.x / length, d.y / length, d.z / length};
+
+      // bruteforce: all points within the cylinder, sorted by their distance along the ray.
+      std::vector<std::pair<float, uint32_t> > expected;
+      for (uint32_t i = 0; i < N; ++i)
+      {
+        const float v[3] = {points[i].x - origin.x, points[i].y - origin.y, points[i].z - origin.z};
+        const float t = v[0] * dir[0] + v[1] * dir[1] + v[2] * dir[2];
+        const float sqrNorm = v[0] * v[0] + v[1] * v[1] + v[2] * v[2];
+        if (t >= 0.0f && t <= maxDistance && sqrNorm - t * t <= radius * radius - 1e-4f) expected.push_back(std::make_pair(t, i));
+      }
+      std::sort(expected.begin(), expected.end());
+
+      uint32_t hitIndex;
+      float hitDistance;
+      bool hit = octree.rayCast(origin, d, radius, hitIndex, hitDistance, maxDistance);
+      ASSERT_EQ(hitIndex, hitIndices[r]);
+      ASSERT_EQ(hitDistance, hitDistances[r]);
+      if (!expected.empty())
+      {
+        numHits += 1;
+        ASSERT_TRUE(hit);
+        ASSERT_LE(hitDistance, expected[0].first + 1e-4f);
+      }
+      if (!hit)
+      {
+        ASSERT_EQ(std::numeric_limits<uint32_t>::max(), hitIndex);
+        continue;
+      }
+
+      octree.rayPoints(origin, d, radius, indices, distances, maxDistance);
+      ASSERT_EQ(indices.size(), distances.size());
+      ASSERT_LE(expected.size(), indices.size());
+      ASSERT_EQ(hitDistance, distances[0]);
+      for (uint32_t i = 1; i < distances.size(); ++i) ASSERT_LE(distances[i - 1], distances[i]);
+
+      // every point strictly inside the cylinder must be reported.
+      std::vector<uint32_t> sorted(indices);
+      std::sort(sorted.begin(), sorted.end());
+      for (uint32_t i = 0; i < expected.size(); ++i)
+        ASSERT_TRUE(std::binary_search(sorted.begin(), sorted.end(), expected[i].second));
+
+      // and every reported point is near the ray.
+      for (uint32_t i = 0; i < indices.size(); ++i)
+      {
+        const Point3f& p = points[indices[i]];
+        const float v[3] = {p.x - origin.x, p.y - origin.y, p.z - origin.z};
+        const float t = v[0] * dir[0] + v[1] * dir[1] + v[2] * dir[2];
+        ASSERT_NEAR(t, distances[i], 1e-4);
+        ASSERT_LE(v[0] * v[0] + v[1] * v[1] + v[2] * v[2] - t * t, radius * radius + 1e-4f);
+      }
+    }
+    ASSERT_LT(0u, numHits);
+
+    // rays leaving the octree and invalid directions.
+    uint32_t hitIndex;
+    float hitDistance;
+    ASSERT_FALSE(octree.rayCast(origin, Point3f(-1, 0, 0), radius, hitIndex, hitDistance));
+    ASSERT_FALSE(octree.rayCast(origin, Point3f(0, 0, 0), radius, hitIndex, hitDistance));
+    octree.rayPoints(origin, Point3f(0, 0, 0), radius, indices, distances);
+    ASSERT_EQ(0u, indices.size());
+
+    // a ray through a point hits exactly this point with radius 0.
+    const Point3f& target = points[42];
+    ASSERT_TRUE(octree.rayCast(Point3f(target.x - 20.0f, target.y, target.z), Point3f(1, 0, 0), 0.0f, hitIndex, hitDistance));
+    ASSERT_EQ(42u, hitIndex);
+    ASSERT_NEAR(20.0f, hitDistance, 1e-4);
+  }
+}
+
+TEST_F(OctreeTest, QueryStats)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 5000, 1234);
+  randomPoints(queries, 100, 4321);
+  const uint32_t N = points.size();
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+
+    unibn::QueryStats stats = octree.queryStats();
+    ASSERT_EQ(0, stats.queries);
+    ASSERT_EQ(0, stats.octantsVisited);
+
+    std::vector<uint32_t> resultIndices, all;
+    uint64_t results = 0;
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      octree.radiusNeighbors(queries[q], 0.3f, resultIndices);
+      results += resultIndices.size();
+    }
+    stats = octree.queryStats();
+    ASSERT_EQ(queries.size(), stats.queries);
+    ASSERT_EQ(results, stats.results);
+    ASSERT_GE(stats.octantsVisited, queries.size());
+    ASSERT_GE(stats.overlapTests + queries.size(), stats.octantsVisited);
+
+    // the search ball contains the root and no distance is computed.
+    octree.resetQueryStats();
+    octree.radiusNeighbors(Point3f(0, 0, 0), 10.0f, all);
+    stats = octree.queryStats();
+    ASSERT_EQ(1, stats.queries);
+    ASSERT_EQ(1, stats.octantsVisited);
+    ASSERT_EQ(1, stats.containedOctants);
+    ASSERT_EQ(0, stats.pointsTested);
+    ASSERT_EQ(N, stats.results);
+
+    octree.resetQueryStats();
+    for (uint32_t q = 0; q < queries.size(); ++q) octree.findNeighbor<unibn::L2Distance<Point3f> >(queries[q]);
+    stats = octree.queryStats();
+    ASSERT_EQ(queries.size(), stats.queries);
+    ASSERT_EQ(queries.size(), stats.results);
+    ASSERT_GT(stats.pointsTested, 0);
+    ASSERT_LT(stats.pointsTested, queries.size() * N);
+
+    // limited searches, which count the overlap tests against other parts and the search inside the part.
+    std::vector<std::vector<uint32_t> > indicesList;
+    ASSERT_TRUE(octree.getOctantIndicesAtSpecifiedDepth(1, indicesList));
+    octree.resetQueryStats();
+    octree.radiusSearchLimitInOneOctant(0, queries[0], 0.01f, resultIndices);
+    stats = octree.queryStats();
+    ASSERT_EQ(1, stats.queries);
+    ASSERT_EQ(resultIndices.size(), stats.results);
+
+    std::vector<uint64_t> offsets;
+    octree.resetQueryStats();
+    octree.radiusNeighborsBatch(queries, 0.3f, offsets, resultIndices);
+    stats = octree.queryStats();
+    ASSERT_EQ(queries.size(), stats.queries);
+    ASSERT_EQ(results, stats.results);
+
+    // threads outside of OpenMP share the counters of a thread number without losing counts.
+    octree.resetQueryStats();
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < 4; ++t)
+    {
+      threads.push_back(std::thread([&octree, &queries]() {
+        std::vector<uint32_t> neighbors;
+        for (uint32_t q = 0; q < queries.size(); ++q) octree.radiusNeighbors(queries[q], 0.3f, neighbors);
+      }));
+    }
+    for (uint32_t t = 0; t < threads.size(); ++t) threads[t].join();
+    stats = octree.queryStats();
+    ASSERT_EQ(4 * queries.size(), stats.queries);
+    ASSERT_EQ(4 * results, stats.results);
+  }
+}
+
+TEST_F(OctreeTest, Shape)
+{
+  std::vector<Point3f> points;
+  randomPoints(points, 5000, 1234);
+  const uint32_t N = points.size();
+
+  unibn::Octree<Point3f> empty;
+  unibn::OctreeShape shape = empty.shape();
+  ASSERT_EQ(0, shape.numLeafs);
+  ASSERT_EQ(0, shape.octantsPerDepth.size());
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.minExtent = (run == 1) ? 0.4f : 0.0f;
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+    shape = octree.shape();
+
+    const std::vector<Octant>& octants = getOctants(octree);
+    uint32_t numOctants = 0, numLeafs = 0, occupancy = 0;
+    for (uint32_t d = 0; d < shape.octantsPerDepth.size(); ++d)
+    {
+      numOctants += shape.octantsPerDepth[d];
+      numLeafs += shape.leafsPerDepth[d];
+    }
+    for (uint32_t i = 0; i < shape.leafOccupancy.size(); ++i) occupancy += shape.leafOccupancy[i];
+    ASSERT_EQ(1, shape.octantsPerDepth[0]);
+    ASSERT_EQ(octants.size(), numOctants);
+    ASSERT_EQ(shape.numLeafs, numLeafs);
+    ASSERT_EQ(shape.numLeafs, occupancy);
+    ASSERT_FLOAT_EQ(float(N) / numLeafs, shape.meanLeafSize);
+    ASSERT_GE(shape.bytes, octants.size() * sizeof(Octant) + N * sizeof(uint32_t));
+    ASSERT_EQ(0, shape.mappedBytes);
+
+    // leafs with more than bucketSize points only exist due to the minimal extent.
+    if (run == 0)
+    {
+      ASSERT_EQ(0, shape.leafOccupancy[8]);
+      ASSERT_LE(shape.maxLeafSize, params.bucketSize);
+    }
+    else
+    {
+      ASSERT_GT(shape.leafOccupancy[8], 0);
+      ASSERT_GT(shape.maxLeafSize, params.bucketSize);
+    }
+  }
+}
+
+TEST_F(OctreeTest, AutoTune)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 5000, 1234);
+  randomPoints(queries, 2000, 4321);
+  const float radius = 0.2f;
+
+  unibn::OctreeParams base;
+  base.reorderPoints = true;
+  base.copyPoints = true;
+  unibn::OctreeParams params = unibn::OctreeParams::autoTune(points, queries, radius, base);
+  ASSERT_TRUE(params.reorderPoints);
+  ASSERT_TRUE(params.copyPoints);
+  ASSERT_TRUE(params.bucketSize >= 4 && params.bucketSize <= 128);
+  ASSERT_TRUE(params.minExtent == 0.0f || params.minExtent == 0.125f * radius || params.minExtent == 0.25f * radius ||
+              params.minExtent == 0.5f * radius);
+
+  // the tuned parameters give the same neighbors.
+  unibn::Octree<Point3f> octree, expected;
+  octree.initialize(points, params);
+  expected.initialize(points);
+  std::vector<uint32_t> resultIndices, expectedIndices;
+  for (uint32_t q = 0; q < 100; ++q)
+  {
+    octree.radiusNeighbors(queries[q], radius, resultIndices);
+    expected.radiusNeighbors(queries[q], radius, expectedIndices);
+    std::sort(resultIndices.begin(), resultIndices.end());
+    std::sort(expectedIndices.begin(), expectedIndices.end());
+    ASSERT_EQ(expectedIndices, resultIndices);
+  }
+
+  // the cost model does not depend on the timing, i.e., the same input gives the same parameters.
+  unibn::OctreeParams again = unibn::OctreeParams::autoTune(points, queries, radius, base);
+  ASSERT_EQ(params.bucketSize, again.bucketSize);
+  ASSERT_EQ(params.minExtent, again.minExtent);
+  unibn::OctreeParams timed = unibn::OctreeParams::autoTune(points, queries, radius, base, true);
+  ASSERT_TRUE(timed.bucketSize >= 4 && timed.bucketSize <= 128);
+
+  // the predicted counters are the counters of the queries.
+  std::vector<Point3f> sample(queries.begin(), queries.begin() + 200);
+  octree.resetQueryStats();
+  for (uint32_t q = 0; q < sample.size(); ++q) octree.radiusNeighbors(sample[q], radius, resultIndices);
+  unibn::QueryStats stats = octree.queryStats(), predicted = octree.radiusQueryCost(sample, radius);
+  ASSERT_EQ(stats.queries, predicted.queries);
+  ASSERT_EQ(stats.octantsVisited, predicted.octantsVisited);
+  ASSERT_EQ(stats.overlapTests, predicted.overlapTests);
+  ASSERT_EQ(stats.containedOctants, predicted.containedOctants);
+  ASSERT_EQ(stats.pointsTested, predicted.pointsTested);
+  ASSERT_GE(stats.results, predicted.results);
+
+  params = unibn::OctreeParams::autoTune(points, std::vector<Point3f>(), radius, base);
+  ASSERT_EQ(base.bucketSize, params.bucketSize);
+  ASSERT_EQ(base.minExtent, params.minExtent);
+}
+
+TEST_F(OctreeTest, QuantizePoints)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 5000, 1337);
+  randomPoints(queries, 200, 4321);
+  // a far away copy, where the rounding errors of the coordinates are much larger.
+  for (uint32_t i = 0; i < 2000; ++i)
+    points.push_back(Point3f(1000.0f + points[i].x, 1000.0f + points[i].y, 1000.0f + points[i].z));
+  for (uint32_t i = 0; i < 50; ++i)
+    queries.push_back(Point3f(1000.0f + queries[i].x, 1000.0f + queries[i].y, 1000.0f + queries[i].z));
+  // queries exactly on points.
+  for (uint32_t i = 0; i < 50; ++i) queries.push_back(points[7 * i]);
+  const uint64_t N = points.size();
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = (run == 0) ? 16 : 64;
+    unibn::Octree<Point3f> expected, reordered, octree;
+    expected.initialize(points, params);
+    params.reorderPoints = true;
+    reordered.initialize(points, params);
+    // the quantized offsets replace the float copy of reorderPoints.
+    params.quantizePoints = true;
+    octree.initialize(points, params);
+    ASSERT_EQ(3 * N * (sizeof(float) - sizeof(int16_t)), reordered.shape().bytes - octree.shape().bytes);
+    ASSERT_EQ(3 * N * sizeof(int16_t) + N * sizeof(uint32_t), octree.shape().bytes - expected.shape().bytes);
+
+    std::vector<uint32_t> resultIndices, expectedIndices;
+    std::vector<float> distances, expectedDistances;
+    const float radii[] = { 0.001f, 0.05f, 0.2f, 1.0f, 3.0f };
+    for (uint32_t r = 0; r < 5; ++r)
+    {
+      for (uint32_t q = 0; q < queries.size(); ++q)
+      {
+        octree.radiusNeighbors(queries[q], radii[r], resultIndices);
+        expected.radiusNeighbors(queries[q], radii[r], expectedIndices);
+        ASSERT_EQ(expectedIndices, resultIndices);
+
+        octree.radiusNeighbors(queries[q], radii[r], resultIndices, distances);
+        expected.radiusNeighbors(queries[q], radii[r], expectedIndices, expectedDistances);
+        ASSERT_EQ(expectedIndices, resultIndices);
+        ASSERT_EQ(expectedDistances, distances);
+
+        octree.radiusNeighbors<unibn::L1Distance<Point3f> >(queries[q], radii[r], resultIndices);
+        expected.radiusNeighbors<unibn::L1Distance<Point3f> >(queries[q], radii[r], expectedIndices);
+        ASSERT_EQ(expectedIndices, resultIndices);
+
+        octree.radiusNeighbors<unibn::MaxDistance<Point3f> >(queries[q], radii[r], resultIndices);
+        expected.radiusNeighbors<unibn::MaxDistance<Point3f> >(queries[q], radii[r], expectedIndices);
+        ASSERT_EQ(expectedIndices, resultIndices);
+      }
+    }
+
+    // other queries use the original points.
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      octree.knnNeighbors(queries[q], 5, resultIndices, distances);
+      expected.knnNeighbors(queries[q], 5, expectedIndices, expectedDistances);
+      ASSERT_EQ(expectedIndices, resultIndices);
+    }
+  }
+}
+
+TEST_F(OctreeTest, SaveOpenMapped)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 5000, 1234);
+  randomPoints(queries, 200, 4321);
+  const std::string filename = ::testing::TempDir() + "octree-test.bin";
+
+  for (uint32_t run = 0; run < 2; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    params.reorderPoints = (run == 1);
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, params);
+    ASSERT_TRUE(octree.save(filename));
+
+    unibn::Octree<Point3f> mapped;
+    ASSERT_TRUE(mapped.openMapped(filename));
+    // the octants are used directly from the mapped file.
+    ASSERT_EQ(0, getOctants(mapped).size());
+    ASSERT_EQ(getRoot(octree)->size, getRoot(mapped)->size);
+    // a mapped octree can not be saved again or changed.
+    ASSERT_FALSE(mapped.save(filename + ".copy"));
+    ASSERT_EQ(0, mapped.remove(std::vector<uint32_t>(1, 0)));
+    // without point container, no aggregates are available.
+    std::vector<unibn::OctantAggregate> aggregates;
+    mapped.aggregate(2, aggregates);
+    ASSERT_EQ(0, aggregates.size());
+
+    std::vector<uint32_t> expected, neighbors, expectedKnn, knn;
+    std::vector<float> distances, expectedDistances, sqrDistances;
+    for (uint32_t q = 0; q < queries.size(); ++q)
+    {
+      octree.radiusNeighbors(queries[q], 0.8f, expected);
+      mapped.radiusNeighbors(queries[q], 0.8f, neighbors, distances);
+      ASSERT_EQ(neighbors.size(), distances.size());
+      std::sort(expected.begin(), expected.end());
+      std::sort(neighbors.begin(), neighbors.end());
+      ASSERT_EQ(expected, neighbors);
+
+      ASSERT_EQ(octree.findNeighbor(queries[q]), mapped.findNeighbor(queries[q]));
+      octree.knnNeighbors(queries[q], 10, expectedKnn, expectedDistances);
+      mapped.knnNeighbors(queries[q], 10, knn, sqrDistances);
+      ASSERT_EQ(expectedKnn, knn);
+    }
+
+    std::vector<uint64_t> offsets;
+    mapped.radiusNeighborsBatch(queries, 0.8f, offsets, neighbors);
+    ASSERT_EQ(queries.size() + 1, offsets.size());
+
+    // partitions only need the octants and the reordered points.
+    unibn::OctreePartition<Point3f> partition = mapped.partition(3);
+    unibn::OctreePartition<Point3f> expectedPartition = octree.partition(3);
+    ASSERT_EQ(expectedPartition.size(), partition.size());
+    for (uint32_t p = 0; p < partition.size(); ++p)
+    {
+      expectedPartition.indices(p, expected);
+      partition.indices(p, neighbors);
+      std::sort(expected.begin(), expected.end());
+      std::sort(neighbors.begin(), neighbors.end());
+      ASSERT_EQ(expected, neighbors);
+    }
+
+    // the mapped octree can be rebuilt as usual.
+    mapped.initialize(points, params);
+    ASSERT_EQ(octree.findNeighbor(queries[0]), mapped.findNeighbor(queries[0]));
+  }
+
+  // empty octrees, missing and invalid files.
+  unibn::Octree<Point3f> empty, mapped;
+  ASSERT_TRUE(empty.save(filename));
+  ASSERT_TRUE(mapped.openMapped(filename));
+  ASSERT_EQ(0, getRoot(mapped));
+  ASSERT_EQ(-1, mapped.findNeighbor(queries[0]));
+  ASSERT_FALSE(mapped.openMapped(filename + ".missing"));
+
+  unibn::Octree<Point3f> octree;
+  octree.initialize(points);
+  ASSERT_TRUE(octree.save(filename));
+  std::vector<char> contents;
+  {
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    contents.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+  {
+    // fixed layout: 80 byte header, 40 byte octants with zero padding, i.e., files are reproducible.
+    uint32_t octantSize = 0, numOctants = 0;
+    uint64_t octantsOffset = 0;
+    std::memcpy(&octantSize, &contents[16], sizeof(uint32_t));
+    std::memcpy(&numOctants, &contents[28], sizeof(uint32_t));
+    std::memcpy(&octantsOffset, &contents[40], sizeof(uint64_t));
+    ASSERT_EQ(40, octantSize);
+    ASSERT_EQ(getOctants(octree).size(), numOctants);
+    for (uint32_t i = 0; i < numOctants; ++i)
+    {
+      ASSERT_EQ(0, contents[octantsOffset + 40 * i + 38]);
+      ASSERT_EQ(0, contents[octantsOffset + 40 * i + 39]);
+    }
+  }
+  {
+    // truncated file.
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    out.write(&contents[0], contents.size() / 2);
+  }
+  ASSERT_FALSE(mapped.openMapped(filename));
+  ASSERT_EQ(0, getRoot(mapped));
+  {
+    // wrong magic.
+    contents[0] = 'X';
+    std::ofstream out(filename.c_str(), std::ios::binary);
+    out.write(&contents[0], contents.size());
+  }
+  ASSERT_FALSE(mapped.openMapped(filename));
+  std::remove(filename.c_str());
+}
+
+TEST_F(OctreeTest, OctreeBuilder)
+{
+  std::vector<Point3f> points, queries;
+  randomPoints(points, 20000, 1234);
+  randomPoints(queries, 100, 4321);
+  // ignored points keep their index.
+  points[17].x = std::numeric_limits<float>::quiet_NaN();
+  std::vector<uint32_t> valid;
+  for (uint32_t i = 0; i < points.size(); ++i)
+    if (i != 17) valid.push_back(i);
+
+  const std::string filename = ::testing::TempDir() + "octree-builder.bin";
+  const std::string expectedFilename = ::testing::TempDir() + "octree-builder-expected.bin";
+
+  for (uint32_t run = 0; run < 3; ++run)
+  {
+    unibn::OctreeParams params;
+    params.bucketSize = 16;
+    // leafs with more points than fit into memory.
+    if (run == 1) params.minExtent = 2.0f;
+    params.parallelBuild = (run == 2);
+    params.parallelThreshold = 256;
+
+    unibn::Octree<Point3f> octree;
+    octree.initialize(points, valid, params);
+    ASSERT_TRUE(octree.save(expectedFilename));
+    // the builder writes no centroids.
+    params.levelOfDetail = true;
+
+    unibn::OctreeBuilder<Point3f> builder(filename, params, 1000);
+    for (uint32_t i = 0; i < points.size(); i += 3000)
+    {
+      std::vector<Point3f> chunk(points.begin() + i, points.begin() + std::min<uint32_t>(i + 3000, points.size()));
+      ASSERT_TRUE(builder.add(chunk));
+    }
+    ASSERT_EQ(points.size(), builder.size());
+    ASSERT_TRUE(builder.build());
+    ASSERT_EQ(0, builder.size());
+
+    // the builder writes the same octants and points as save.
+    unibn::Octree<Point3f> mapped, expected;
+    ASSERT_TRUE(mapped.openMapped(filename));
+    ASSERT_TRUE(expected.openMapped(expectedFilename));
+    ASSERT_EQ(getNumMappedOctants(expected), getNumMappedOctants(mapped));
+    std::vector<unibn::LodSample> samples;
+    ASSERT_FALSE(mapped.levelOfDetail(queries[0], 0.1f, samples));
+    const Octant* octants = getRoot(mapped);
+    const Octant* expectedOctants = getRoot(expected);
+    for (uint32_t i = 0; i < getNumMappedOctants(mapped); ++i)
+    {
+      ASSERT_EQ(expectedOctants[i].x, octants[i].x);
+      ASSERT_EQ(expectedOctants[i].y, octants[i].y);
+      ASSERT_EQ(expectedOctants[i].z, octants[i].z);
+      ASSERT_EQ(expectedOctants[i].extent, octants[i].extent);
+      ASSERT_EQ(expectedOctants[i].start, octants[i].start);
+      ASSERT_EQ(expectedOctants[i].end, octants[i].end);
+      ASSERT_EQ(expectedOctants[i].size, octants[i].size);
+      ASSERT_EQ(expectedOctants[i].offset, octants[i].offset);
+      ASSERT_EQ(expectedOctants[i].isLeaf, octants[i].isLeaf);
+      if (octants[i].isLeaf) continue;
+      ASSERT_EQ(expectedOctants[i].firstChild, octants[i].firstChild);
+      ASSERT_EQ(expectedOctants[i].childMask, octants[i].childMask);
+    }
+    for (uint32_t k = 0; k < valid.size(); ++k)
+    {
+      ASSERT_EQ(getPermutation(expected)[k], getPermutation(mapped)[k]);
+      Point3f p = getReorderedPoint(mapped, k), q = getReorderedPoint(expected, k);
+      ASSERT_TRUE(p.x == q.x && p.y == q.y && p.z == q.z);
+    }
+  }
+
+  // user-supplied bounds, where points outside are ignored.
+  points[5].x = 20.0f;
+  const float min[3] = {-6.0f, -6.0f, -6.0f}, max[3] = {6.0f, 6.0f, 6.0f};
+  unibn::OctreeBuilder<Point3f> builder(filename);
+  builder.setBounds(min, max);
+  ASSERT_TRUE(builder.add(points));
+  ASSERT_TRUE(builder.build());
+
+  unibn::Octree<Point3f> mapped;
+  ASSERT_TRUE(mapped.openMapped(filename));
+  ASSERT_EQ(points.size() - 2, getRoot(mapped)->size);
+  ASSERT_EQ(6.0f, getRoot(mapped)->extent);
+  NaiveNeighborSearch<Point3f> bruteforce;
+  bruteforce.initialize(points);
+  for (uint32_t q = 0; q < queries.size(); ++q)
+  {
+    std::vector<uint32_t> expected, neighbors;
+    bruteforce.radiusNeighbors<unibn::L2Distance<Point3f> >(queries[q], 0.8f, expected);
+    mapped.radiusNeighbors(queries[q], 0.8f, neighbors);
+    ASSERT_TRUE(similarVectors(expected, neighbors));
+  }
+
+  // empty octree.
+  ASSERT_TRUE(builder.build());
+  ASSERT_TRUE(mapped.openMapped(filename));
+  ASSERT_EQ(0, getRoot(mapped));
+
+  std::remove(filename.c_str());
+  std::remove(expectedFilename.c_str());
+}
+
+TEST_F(OctreeTest, ReorderPoints)
+{
+  uint32_t N = 1000;
+
+  boost::mt11213b mtwister(1234);
+  boost::uniform_int<> uni_dist(0, N - 1);
+
+  std::vector<Point3f> points;
+  randomPoints(points, N, 1234);
+
+  unibn::OctreeParams params;
+  params.bucketSize = 16;
+  unibn::Octree<Point3f> octree;
+  octree.initialize(points, params);
+
+  params.reorderPoints = true;
+  unibn::Octree<Point3f> reordered;
+  reordered.initialize(points, params);
+
+  // the points of each octant are a continuous range of the reordered points.
+  const std::vector<uint32_t>& successors = getSuccessors(reordered);
+  const std::vector<Octant>& octants = getOctants(reordered);
+  for (uint32_t i = 0; i < octants.size(); ++i)
+  {
+    uint32_t idx = octants[i].start;
+    for (uint32_t k = octants[i].offset; k < octants[i].offset + octants[i].size; ++k)
+    {
+      ASSERT_EQ(idx, getPermutation(reordered)[k]);
+      ASSERT_EQ(points[idx].x, getReorderedPoint(reordered, k).x);
+      ASSERT_EQ(points[idx].y, getReorderedPoint(reordered, k).y);
+      ASSERT_EQ(points[idx].z, getReorderedPoint(reordered, k).z);
+      idx = successors[idx];
+    }
+  }
+
+  float radii[4] = {0.5, 1.0, 2.0, 5.0};
+  for (uint32_t r = 0; r < 4; ++r)
+  {
+    for (uint32_t i = 0; i < 10; ++i)
+    {
+      const Point3f& query = points[uni_dist(mtwister)];
+
+      std::vector<uint32_t> expected, neighbors;
+      std::vector<float> expectedDistances, distances;
+      octree.radiusNeighbors(query, radii[r], expected);
+      reordered.radiusNeighbors(query, radii[r], neighbors);
+      ASSERT_EQ(true, similarVectors(expected, neighbors));
+
+      // vectorized distance computations might differ in the last bits.
+      octree.radiusNeighbors(query, radii[r], expected, expectedDistances);
+      reordered.radiusNeighbors(query, radii[r], neighbors, distances);
+      ASSERT_EQ(expected, neighbors);
+      ASSERT_EQ(expectedDistances.size(), distances.size());
+      for (uint32_t j = 0; j < distances.size(); ++j) ASSERT_NEAR(expectedDistances[j], distances[j], 1e-5);
+
+      ASSERT_EQ(octree.findNeighbor(query, 0.0f), reordered.findNeighbor(query, 0.0f));
+
+      octree.knnNeighbors(query, 10, expected, expectedDistances);
+      reordered.knnNeighbors(query, 10, neighbors, distances);
+      ASSERT_EQ(expected, neighbors);
+      for (uint32_t j = 0; j < distances.size(); ++j) ASSERT_NEAR(expectedDistances[j], distances[j], 1e-5);
+    }
+  }
+
+  std::vector<std::vector<uint32_t> > expectedLists, lists;
+  octree.getOctantIndicesAtSpecifiedDepth(2, expectedLists);
+  reordered.getOctantIndicesAtSpecifiedDepth(2, lists);
+  ASSERT_EQ(expectedLists, lists);
+}
+
+TEST_F(OctreeTest, SimdKernels)
+{
+  boost::mt11213b mtwister(1234);
+  boost::uniform_01<> gen;
+
+  // sizes cover full vectors and remaining points of all available instruction sets.
+  for (uint32_t size = 0; size < 70; ++size)
+  {
+    std::vector<float> xs(size), ys(size), zs(size);
+    std::vector<uint32_t> indexes(size);
+    for (uint32_t i = 0; i < size; ++i)
+    {
+      xs[i] = 2.0f * gen(mtwister) - 1.0f;
+      ys[i] = 2.0f * gen(mtwister) - 1.0f;
+      zs[i] = 2.0f * gen(mtwister) - 1.0f;
+      indexes[i] = 1000 + 3 * i;
+    }
+    const float qx = 0.1f, qy = -0.2f, qz = 0.3f, sqrRadius = 0.5f;
+
+    std::vector<uint32_t> expected;
+    std::vector<float> expectedDistances;
+    uint32_t expectedNearest = size;
+    float sqrMinDistance = 0.05f, expectedSqrMaxDistance = 2.0f;
+    for (uint32_t i = 0; i < size; ++i)
+    {
+      float dist = (qx - xs[i]) * (qx - xs[i]) + (qy - ys[i]) * (qy - ys[i]) + (qz - zs[i]) * (qz - zs[i]);
+      if (dist < sqrRadius)
+      {
+        expected.push_back(indexes[i]);
+        expectedDistances.push_back(dist);
+      }
+      if (dist > sqrMinDistance && dist < expectedSqrMaxDistance)
+      {
+        expectedNearest = i;
+        expectedSqrMaxDistance = dist;
+      }
+    }
+
+    std::vector<uint32_t> resultIndices(size + 1);
+    std::vector<float> distances(size + 1);
+    uint32_t n = unibn::simd::radiusScan(xs.data(), ys.data(), zs.data(), indexes.data(), size, qx, qy, qz, sqrRadius,
+                                         &resultIndices[0], &distances[0]);
+    ASSERT_EQ(expected.size(), n);
+    for (uint32_t i = 0; i < n; ++i)
+    {
+      ASSERT_EQ(expected[i], resultIndices[i]);
+      ASSERT_NEAR(expectedDistances[i], distances[i], 1e-6);
+    }
+
+    n = unibn::simd::radiusScan(xs.data(), ys.data(), zs.data(), indexes.data(), size, qx, qy, qz, sqrRadius, &resultIndices[0], 0);
+    ASSERT_EQ(expected.size(), n);
+
+    float sqrMaxDistance = 2.0f;
+    ASSERT_EQ(expectedNearest,
+              unibn::simd::nearestScan(xs.data(), ys.data(), zs.data(), size, qx, qy, qz, sqrMinDistance, sqrMaxDistance));
+    ASSERT_NEAR(expectedSqrMaxDistance, sqrMaxDistance, 1e-6);
+  }
+}
+
 TEST_F(OctreeTest, OverlapTest)
 {
   Octant octant;